@@ -42,6 +42,17 @@ typedef struct gr_font          gr_font;
 typedef struct gr_feature_ref   gr_feature_ref;
 typedef struct gr_feature_val   gr_feature_val;
 
+/**
+* Thread safety: once created, a gr_face and any gr_font made from it may be
+* shared by any number of threads shaping concurrently with gr_make_seg(),
+* without external locking. Glyph data and advances loaded lazily on first
+* use are published lock-free. Each gr_segment and gr_feature_val belongs to
+* the thread that made it, and the application's gr_face_ops and gr_font_ops
+* callbacks must themselves be safe to call from several threads.
+* Creating or destroying a face or font, and logging with gr_start_logging(),
+* must not overlap with other use of the same face.
+*/
+
 /**
 * Returns version information on this engine
 */
@@ -63,7 +74,22 @@ enum gr_face_options {
     /** Cache the lookup from code point to glyph ID at construction time */
     gr_face_cacheCmap = 4,
     /** Preload everything */
-    gr_face_preloadAll = gr_face_preloadGlyphs | gr_face_cacheCmap
+    gr_face_preloadAll = gr_face_preloadGlyphs | gr_face_cacheCmap,
+    /** Decode the Graphite passes, and any glyphs being preloaded, on a few
+      * worker threads. The face is fully loaded, and identical to one loaded
+      * without this option, by the time gr_make_face returns. */
+    gr_face_parallelLoad = 8,
+    /** Only check where each Graphite pass lies at construction time and
+      * decode a pass the first time a segment needs it. The Silf table is
+      * kept until the face is destroyed. A pass that turns out to be invalid
+      * makes gr_make_seg fail and sets the face's error. Ignored when loading
+      * from a snapshot. */
+    gr_face_lazyPasses = 16,
+    /** Compile the rules of each pass to native code as the pass is decoded.
+      * Rules that cannot be compiled, and faces made by a library built
+      * without GRAPHITE2_JIT or for a processor other than x86-64, run on
+      * the interpreter as usual. */
+    gr_face_jit = 32
 };
 
 /** Holds information about a particular Graphite silf table that has been loaded */
@@ -142,24 +168,29 @@ GR2_API gr_face* gr_make_face_with_ops(const void* appFaceHandle/*non-NULL*/, co
   */
 GR2_DEPRECATED_API gr_face* gr_make_face(const void* appFaceHandle/*non-NULL*/, gr_get_table_fn getTable, unsigned int faceOptions);
 
-/** @deprecated   Since 1.3.7 this function is now an alias for gr_make_face_with_ops().
+/** Create a gr_face object given application information, with subsegmental caching support.
   *
-  * Create a gr_face object given application information, with subsegmental caching support
+  * Segments are split into runs of whitespace and non-whitespace characters
+  * and each run's shaped glyphs are kept in a least recently used cache,
+  * keyed by its characters, features, script and direction. Later segments
+  * containing the same run splice in the cached glyphs rather than running
+  * the Graphite rules again. The cache is only used for fonts that declare
+  * their rules never match spaces (gr_space_none) and need neither bidi nor
+  * collision passes; other fonts shape as if there were no cache.
   *
   * @return gr_face or NULL if the font fails to load.
   * @param appFaceHandle is a pointer to application specific information that is passed to getTable.
   *                      This may not be NULL and must stay alive as long as the gr_face is alive.
   * @param face_ops      Pointer to face specific callback structure for table management. Must stay
   *                      alive for the duration of the call only.
-  * @param segCacheMaxSize Unused.
+  * @param segCacheMaxSize Maximum number of sub-segments to cache. Zero disables the cache.
   * @param faceOptions   Bitfield of values from enum gr_face_options
   */
-GR2_DEPRECATED_API gr_face* gr_make_face_with_seg_cache_and_ops(const void* appFaceHandle, const gr_face_ops *face_ops, unsigned int segCacheMaxSize, unsigned int faceOptions);
+GR2_API gr_face* gr_make_face_with_seg_cache_and_ops(const void* appFaceHandle, const gr_face_ops *face_ops, unsigned int segCacheMaxSize, unsigned int faceOptions);
 
-/** @deprecated   Since 1.3.7 this function is now an alias for gr_make_face().
+/** @deprecated Since v1.2.0 in favour of gr_make_face_with_seg_cache_and_ops.
   *
   * Create a gr_face object given application information, with subsegmental caching support.
-  * This function is deprecated as of v1.2.0 in favour of gr_make_face_with_seg_cache_and_ops.
   *
   * @return gr_face or NULL if the font fails to load.
   * @param appFaceHandle is a pointer to application specific information that is passed to getTable.
@@ -170,6 +201,55 @@ GR2_DEPRECATED_API gr_face* gr_make_face_with_seg_cache_and_ops(const void* appF
   */
 GR2_DEPRECATED_API gr_face* gr_make_face_with_seg_cache(const void* appFaceHandle, gr_get_table_fn getTable, unsigned int segCacheMaxSize, unsigned int faceOptions);
 
+/** Get the usage counters of a face's segment cache.
+  *
+  * @return 1 if the face has a segment cache, else 0 and the counters are zeroed.
+  * @param pFace    face to query
+  * @param hits     if not NULL, set to the number of sub-segments found in the cache
+  * @param misses   if not NULL, set to the number of cacheable sub-segments that had to be shaped
+  * @param entries  if not NULL, set to the number of sub-segments currently cached
+  */
+GR2_API int gr_face_seg_cache_stats(const gr_face *pFace, size_t *hits, size_t *misses, size_t *entries);
+
+/** Write a snapshot image of the decoded rules of a face.
+  *
+  * The image holds the face's passes, state machines, rules, glyph classes and
+  * compiled code with no pointers in it, so it can be saved to disk and mapped
+  * back in by any process using the same graphite2 build on the same font.
+  * Glyph, cmap and feature data are still read lazily from the font as usual.
+  * Call once with a NULL buffer to find the size needed.
+  *
+  * @return the size of the image in bytes, or 0 if the face cannot be
+  *         snapshotted. Nothing is written unless len is at least this size.
+  * @param pFace    face to snapshot
+  * @param buf      buffer to write the image into, may be NULL
+  * @param len      size of buf in bytes
+  */
+GR2_API size_t gr_face_snapshot(const gr_face *pFace, void *buf, size_t len);
+
+/** Create a gr_face, taking its decoded rules from a snapshot image made by
+  * gr_face_snapshot() rather than parsing and checking the Silf table.
+  *
+  * The image is only read during the call, so it may be unmapped or freed
+  * straight afterwards. It is keyed on checksums of the font and on the
+  * library's snapshot format, so a stale image is rejected, and its tables
+  * are bounds checked as the font's would be. The operands of its rule
+  * programs are not checked again, though, and the checksums only catch
+  * accidents, not tampering. Treat an image as trusted input: only load
+  * images the application wrote itself and kept where others cannot change
+  * them.
+  *
+  * @return gr_face or NULL if the font fails to load or the image does not
+  *         match the font, in which case load the face normally and write a
+  *         fresh snapshot.
+  * @param appFaceHandle as for gr_make_face_with_ops()
+  * @param face_ops      as for gr_make_face_with_ops()
+  * @param image         snapshot image
+  * @param len           size of the image in bytes
+  * @param faceOptions   Bitfield of values from enum gr_face_options
+  */
+GR2_API gr_face* gr_make_face_with_snapshot(const void* appFaceHandle, const gr_face_ops *face_ops, const void *image, size_t len, unsigned int faceOptions);
+
 /** Convert a tag in a string into a gr_uint32
   *
   * @return gr_uint32 tag, zero padded
@@ -236,25 +316,49 @@ GR2_API const gr_faceinfo *gr_face_info(const gr_face *pFace, gr_uint32 script);
   */
 GR2_API int gr_face_is_char_supported(const gr_face *pFace, gr_uint32 usv, gr_uint32 script);
 
+/** Create gr_face from a whole font file already held in memory, such as a web
+  * font or a font embedded in a document.
+  *
+  * Tables are read in place rather than copied, so the data must stay valid and
+  * unchanged until the face is destroyed.
+  * @return gr_face that reads tables straight from data. Returns NULL on failure.
+  * @param data Start of the font data
+  * @param len Length of the font data in bytes
+  * @param faceOptions Bitfile from enum gr_face_options to control face options.
+  */
+GR2_API gr_face* gr_make_memory_face(const void *data, size_t len, unsigned int faceOptions);
+
 #ifndef GRAPHITE2_NFILEFACE
 /** Create gr_face from a font file
   *
+  * Where the platform supports it the file is mapped into memory and tables are
+  * read in place, otherwise they are read from the file as needed.
   * @return gr_face that accesses a font file directly. Returns NULL on failure.
   * @param filename Full path and filename to font file
   * @param faceOptions Bitfile from enum gr_face_options to control face options.
   */
 GR2_API gr_face* gr_make_file_face(const char *filename, unsigned int faceOptions);
 
-/** @deprecated   Since 1.3.7. This function is now an alias for gr_make_file_face().
-  *
-  * Create gr_face from a font file, with subsegment caching support.
+/** Create gr_face from a font file, with subsegment caching support.
+  * See gr_make_face_with_seg_cache_and_ops() for how the cache is used.
   *
   * @return gr_face that accesses a font file directly. Returns NULL on failure.
   * @param filename Full path and filename to font file
   * @param segCacheMaxSize Specifies how big to make the cache in segments.
   * @param faceOptions   Bitfield from enum gr_face_options to control face options.
   */
-GR2_DEPRECATED_API gr_face* gr_make_file_face_with_seg_cache(const char *filename, unsigned int segCacheMaxSize, unsigned int faceOptions);
+GR2_API gr_face* gr_make_file_face_with_seg_cache(const char *filename, unsigned int segCacheMaxSize, unsigned int faceOptions);
+
+/** Create gr_face from a font file and a snapshot image of it.
+  * See gr_make_face_with_snapshot() for how the image is used.
+  *
+  * @return gr_face or NULL if the font fails to load or the image does not match it.
+  * @param filename      Full path and filename to font file
+  * @param image         snapshot image made by gr_face_snapshot()
+  * @param len           size of the image in bytes
+  * @param faceOptions   Bitfield from enum gr_face_options to control face options.
+  */
+GR2_API gr_face* gr_make_file_face_with_snapshot(const char *filename, const void *image, size_t len, unsigned int faceOptions);
 #endif      // !GRAPHITE2_NFILEFACE
 
 /** Create a font from a face
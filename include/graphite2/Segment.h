@@ -180,6 +180,7 @@ enum gr_bidirtl {
 typedef struct gr_char_info     gr_char_info;
 typedef struct gr_segment       gr_segment;
 typedef struct gr_slot          gr_slot;
+typedef struct gr_shape_context gr_shape_context;
 
 /** Returns Unicode character for a charinfo.
   *
@@ -274,6 +275,44 @@ GR2_API gr_segment* gr_make_seg(const gr_font* font, const gr_face* face, gr_uin
   */
 GR2_API void gr_seg_destroy(gr_segment* p);
 
+/** Creates a shaping context, which keeps the buffers of finished segments for
+  * reuse so that shaping many runs does not keep going back to the heap.
+  *
+  * A context is not thread safe, give each thread its own.
+  * @return a context that needs gr_shape_context_destroy called on it, or NULL
+  *         if memory could not be allocated.
+  */
+GR2_API gr_shape_context* gr_make_shape_context(void);
+
+/** Destroys a shaping context and any segments it is holding for reuse.
+  *
+  * Segments still in use by the caller are not affected and must be passed to
+  * gr_seg_destroy instead.
+  * @param ctx The context to destroy
+  */
+GR2_API void gr_shape_context_destroy(gr_shape_context* ctx);
+
+/** Creates a segment as gr_make_seg does, but shapes it in storage recycled
+  * through the given context.
+  *
+  * Once warmed up on text of a similar length, with the same face, this makes
+  * no heap allocations for fonts that do not use collision avoidance.
+  * @return a segment that needs gr_seg_reset or gr_seg_destroy called on it.
+  *         May return NULL if bad problems in segment processing.
+  * @param ctx The context to take storage from. If NULL this is gr_make_seg.
+  *
+  * The other parameters are as for gr_make_seg.
+  */
+GR2_API gr_segment* gr_make_seg_ctx(gr_shape_context* ctx, const gr_font* font, const gr_face* face, gr_uint32 script, const gr_feature_val* pFeats, enum gr_encform enc, const void* pStart, size_t nChars, int dir);
+
+/** Hands a finished segment back to a context for its storage to be reused by
+  * the next gr_make_seg_ctx call. The segment must not be used afterwards.
+  *
+  * @param ctx The context to give the segment to. If NULL the segment is destroyed.
+  * @param pSeg The segment, which may come from either gr_make_seg_ctx or gr_make_seg.
+  */
+GR2_API void gr_seg_reset(gr_shape_context* ctx, gr_segment* pSeg);
+
 /** Returns the advance for the whole segment.
   *
   * Returns the width of the segment up to the next glyph origin after the segment
@@ -305,6 +344,42 @@ GR2_API const gr_slot* gr_seg_first_slot(gr_segment* pSeg/*not NULL*/);    //may
   */
 GR2_API const gr_slot* gr_seg_last_slot(gr_segment* pSeg/*not NULL*/);    //may give a base slot or a slot which is attached to another
 
+/** Copies out the glyphs of a segment, in the order gr_seg_first_slot() and
+  * gr_slot_next_in_segment() would give them, into caller supplied arrays.
+  *
+  * Any of the arrays may be NULL if that information is not wanted.
+  * @return The number of glyphs in the segment. If this is more than maxGlyphs only
+  *         the first maxGlyphs entries were written.
+  * @param pSeg         Pointer to the segment
+  * @param font         Font used to scale the advances as gr_slot_advance_X() does.
+  *                     If NULL advances are in design units.
+  * @param maxGlyphs    Number of entries each array can hold.
+  * @param gids         Glyph ids, as gr_slot_gid().
+  * @param originsX     Glyph x positions, as gr_slot_origin_X().
+  * @param originsY     Glyph y positions, as gr_slot_origin_Y().
+  * @param advances     Glyph advances, as gr_slot_advance_X().
+  * @param charIndices  First character of the cluster each glyph belongs to, as gr_slot_before().
+  * @param parents      Position in these arrays of the glyph each glyph is attached to, or -1 for a base.
+  */
+GR2_API size_t gr_seg_export_glyphs(const gr_segment* pSeg/*not NULL*/, const gr_font* font, size_t maxGlyphs,
+                                    gr_uint16* gids, float* originsX, float* originsY, float* advances,
+                                    int* charIndices, int* parents);
+
+/** Copies out the range of glyphs associated with each character of a segment,
+  * as positions in the arrays filled in by gr_seg_export_glyphs().
+  *
+  * This is gr_cinfo_before() and gr_cinfo_after() mapped from slot indices to
+  * glyph positions, so it stays ordered for segments that were reversed.
+  * Either array may be NULL if not wanted.
+  * @return The number of characters in the segment, as gr_seg_n_cinfo(). If this is
+  *         more than maxChars only the first maxChars entries were written.
+  * @param pSeg         Pointer to the segment
+  * @param maxChars     Number of entries each array can hold.
+  * @param firstGlyphs  First glyph of the cluster containing each character, or -1.
+  * @param lastGlyphs   Last glyph of the cluster containing each character, or -1.
+  */
+GR2_API size_t gr_seg_export_clusters(const gr_segment* pSeg/*not NULL*/, size_t maxChars, int* firstGlyphs, int* lastGlyphs);
+
 /** Justifies a linked list of slots for a line to a given width
   *
   * Passed a pointer to the start of a linked list of slots corresponding to a line, as
@@ -0,0 +1,272 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2015, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#include <cstring>
+
+#include "inc/AxisBounds.h"
+
+// The vector paths only match the scalar one where scalar floats are done in
+// SSE registers too, x87 keeps more precision between operations.
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2_MATH__) \
+    && (defined(__x86_64__) || defined(__i386__))
+  #include <cpuid.h>
+  #include <immintrin.h>
+  #define HAVE_SSE
+  #define HAVE_AVX
+#elif defined(_MSC_VER) && defined(_M_X64)
+  #include <emmintrin.h>
+  #define HAVE_SSE
+#endif
+
+using namespace graphite2;
+
+namespace
+{
+    // Every bound on every axis is the max, or min, of three terms.  The
+    // first is always p - q + r, the other two k*(p - q + r) + s, with each
+    // sum taken in the order ShiftCollider has always taken it.  The vector
+    // paths lay each term out a lane per axis and give k = 1 where there is
+    // nothing to scale, which leaves the term as it was.
+
+    void bounds_scalar(const AxisTarget & t, const BBox & bb, const SlantBox & sb,
+                       float sx, float sy, bool sub, AxisBounds & r) throw()
+    {
+        const BBox & tbb = t.bb;
+        const SlantBox & tsb = t.sb;
+        const float tx = t.tx, ty = t.ty,
+                    td = tx - ty, ts = tx + ty,
+                    sd = sx - sy, ss = sx + sy;
+
+        if (sub)
+        {
+            r.vmin[0] = max(max(bb.xi-tbb.xa+sx, sb.di-tsb.da+sd+ty), sb.si-tsb.sa+ss-ty);
+            r.vmax[0] = min(min(bb.xa-tbb.xi+sx, sb.da-tsb.di+sd+ty), sb.sa-tsb.si+ss-ty);
+            r.vmin[1] = max(max(bb.yi-tbb.ya+sy, tsb.di-sb.da-sd+tx), sb.si-tsb.sa+ss-tx);
+            r.vmax[1] = min(min(bb.ya-tbb.yi+sy, tsb.da-sb.di-sd+tx), sb.sa-tsb.si+ss-tx);
+        }
+        else
+        {
+            r.vmin[0] = max(max(bb.xi - tbb.xa + sx, sb.di - tsb.da + ty + sd), sb.si - tsb.sa - ty + ss);
+            r.vmax[0] = min(min(bb.xa - tbb.xi + sx, sb.da - tsb.di + ty + sd), sb.sa - tsb.si - ty + ss);
+            r.vmin[1] = max(max(bb.yi - tbb.ya + sy, tsb.di - sb.da + tx - sd), sb.si - tsb.sa - tx + ss);
+            r.vmax[1] = min(min(bb.ya - tbb.yi + sy, tsb.da - sb.di + tx - sd), sb.sa - tsb.si - tx + ss);
+        }
+        r.vmin[2] = max(max(sb.si - tsb.sa + ss, 2 * (bb.yi - tbb.ya + sy) + td), 2 * (bb.xi - tbb.xa + sx) - td);
+        r.vmax[2] = min(min(sb.sa - tsb.si + ss, 2 * (bb.ya - tbb.yi + sy) + td), 2 * (bb.xa - tbb.xi + sx) - td);
+        r.vmin[3] = max(max(sb.di - tsb.da + sd, 2 * (bb.xi - tbb.xa + sx) - ts), -2 * (bb.ya - tbb.yi + sy) + ts);
+        r.vmax[3] = min(min(sb.da - tsb.di + sd, 2 * (bb.xa - tbb.xi + sx) - ts), -2 * (bb.yi - tbb.ya + sy) + ts);
+
+        r.omin[0] = bb.yi + sy; r.omax[0] = bb.ya + sy;
+        r.omin[1] = bb.xi + sx; r.omax[1] = bb.xa + sx;
+        r.omin[2] = sb.di + sd; r.omax[2] = sb.da + sd;
+        r.omin[3] = sb.si + ss; r.omax[3] = sb.sa + ss;
+    }
+
+#if defined HAVE_SSE
+    inline __m128 term(__m128 p, __m128 q, __m128 r, __m128 k, __m128 s)
+    {
+        return _mm_add_ps(_mm_mul_ps(k, _mm_add_ps(_mm_sub_ps(p, q), r)), s);
+    }
+
+    inline __m128 select(__m128 m, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+    }
+
+    // The neighbour's boxes are loaded whole and shuffled into each term's
+    // lanes.  _mm_max_ps(a, b) and _mm_min_ps(a, b) pick just as max(a, b)
+    // and min(a, b) do, on zeros and NaNs as well.
+    void bounds_sse(const AxisTarget & t, const BBox & bb, const SlantBox & sb,
+                    float sx, float sy, bool sub, AxisBounds & res) throw()
+    {
+        const float sd = sx - sy, ss = sx + sy;
+        const __m128 b = _mm_loadu_ps(&bb.xi),
+                     s = _mm_loadu_ps(&sb.si),
+                     lane1 = _mm_castsi128_ps(_mm_setr_epi32(0, -1, 0, 0));
+
+        // The main box adds the target's shift before the neighbour's on x
+        // and y, a sub-box after, which swaps r and s in those lanes.
+        const __m128 u2 = _mm_loadu_ps(t.u2), v2 = _mm_setr_ps(sd, -sd, sy, sx),
+                     u3 = _mm_loadu_ps(t.u3), v3 = _mm_setr_ps(ss, ss, sx, sy);
+        const __m128 r1 = _mm_setr_ps(sx, sy, ss, sd),
+                     r2 = sub ? v2 : _mm_shuffle_ps(u2, v2, _MM_SHUFFLE(3, 2, 1, 0)),
+                     s2 = sub ? u2 : _mm_shuffle_ps(v2, u2, _MM_SHUFFLE(3, 2, 1, 0)),
+                     r3 = sub ? v3 : _mm_shuffle_ps(u3, v3, _MM_SHUFFLE(3, 2, 1, 0)),
+                     s3 = sub ? u3 : _mm_shuffle_ps(v3, u3, _MM_SHUFFLE(3, 2, 1, 0)),
+                     k2 = _mm_setr_ps(1.f, 1.f, 2.f, 2.f),
+                     k3 = _mm_setr_ps(1.f, 1.f, 2.f, -2.f);
+
+        const __m128 n2i = _mm_shuffle_ps(s, b, _MM_SHUFFLE(0, 1, 3, 1)),
+                     q2i = _mm_loadu_ps(t.q2);
+        const __m128 vmin = _mm_max_ps(_mm_max_ps(
+            _mm_add_ps(_mm_sub_ps(_mm_movelh_ps(b, s), _mm_loadu_ps(t.q1)), r1),
+            term(select(lane1, q2i, n2i), select(lane1, n2i, q2i), r2, k2, s2)),
+            term(_mm_shuffle_ps(s, b, _MM_SHUFFLE(3, 0, 0, 0)), _mm_loadu_ps(t.q3), r3, k3, s3));
+
+        const __m128 n2a = _mm_shuffle_ps(s, b, _MM_SHUFFLE(2, 3, 1, 3)),
+                     q2a = _mm_loadu_ps(t.q2 + 4);
+        const __m128 vmax = _mm_min_ps(_mm_min_ps(
+            _mm_add_ps(_mm_sub_ps(_mm_movehl_ps(s, b), _mm_loadu_ps(t.q1 + 4)), r1),
+            term(select(lane1, q2a, n2a), select(lane1, n2a, q2a), r2, k2, s2)),
+            term(_mm_shuffle_ps(s, b, _MM_SHUFFLE(1, 2, 2, 2)), _mm_loadu_ps(t.q3 + 4), r3, k3, s3));
+
+        const __m128 o = _mm_setr_ps(sy, sx, sd, ss);
+        _mm_storeu_ps(res.vmin, vmin);
+        _mm_storeu_ps(res.vmax, vmax);
+        _mm_storeu_ps(res.omin, _mm_add_ps(_mm_shuffle_ps(b, s, _MM_SHUFFLE(0, 1, 0, 1)), o));
+        _mm_storeu_ps(res.omax, _mm_add_ps(_mm_shuffle_ps(b, s, _MM_SHUFFLE(2, 3, 2, 3)), o));
+    }
+#endif
+
+#if defined HAVE_AVX
+    __attribute__((target("avx")))
+    inline __m256 both(__m128 x)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(x), x, 1);
+    }
+
+    // The same as bounds_sse with the vmin terms in the low lanes and the vmax
+    // terms in the high ones, so each step is done for both at once.  The high
+    // lanes get the boxes with their min and max sides swapped, so that one
+    // shuffle picks out both halves of a term.
+    __attribute__((target("avx")))
+    void bounds_avx(const AxisTarget & t, const BBox & bb, const SlantBox & sb,
+                    float sx, float sy, bool sub, AxisBounds & res) throw()
+    {
+        const float sd = sx - sy, ss = sx + sy;
+        const __m256i swap = _mm256_setr_epi32(0, 1, 2, 3, 2, 3, 0, 1);
+        const __m256 b = _mm256_permutevar_ps(_mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&bb.xi)), swap),
+                     s = _mm256_permutevar_ps(_mm256_broadcast_ps(reinterpret_cast<const __m128 *>(&sb.si)), swap);
+
+        const __m256 u2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(t.u2)),
+                     v2 = both(_mm_setr_ps(sd, -sd, sy, sx)),
+                     u3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(t.u3)),
+                     v3 = both(_mm_setr_ps(ss, ss, sx, sy));
+        const __m256 r1 = both(_mm_setr_ps(sx, sy, ss, sd)),
+                     r2 = sub ? v2 : _mm256_blend_ps(u2, v2, 0xCC),
+                     s2 = sub ? u2 : _mm256_blend_ps(v2, u2, 0xCC),
+                     r3 = sub ? v3 : _mm256_blend_ps(u3, v3, 0xCC),
+                     s3 = sub ? u3 : _mm256_blend_ps(v3, u3, 0xCC),
+                     k2 = _mm256_setr_ps(1.f, 1.f, 2.f, 2.f, 1.f, 1.f, 2.f, 2.f),
+                     k3 = _mm256_setr_ps(1.f, 1.f, 2.f, -2.f, 1.f, 1.f, 2.f, -2.f);
+
+        const __m256 n2 = _mm256_shuffle_ps(s, b, _MM_SHUFFLE(0, 1, 3, 1)),
+                     q2 = _mm256_loadu_ps(t.q2);
+        const __m256 t1 = _mm256_add_ps(_mm256_sub_ps(_mm256_shuffle_ps(b, s, _MM_SHUFFLE(1, 0, 1, 0)),
+                                                      _mm256_loadu_ps(t.q1)), r1),
+                     t2 = _mm256_add_ps(_mm256_mul_ps(k2, _mm256_add_ps(_mm256_sub_ps(
+                                _mm256_blend_ps(n2, q2, 0x22), _mm256_blend_ps(q2, n2, 0x22)), r2)), s2),
+                     t3 = _mm256_add_ps(_mm256_mul_ps(k3, _mm256_add_ps(_mm256_sub_ps(
+                                _mm256_shuffle_ps(s, b, _MM_SHUFFLE(3, 0, 0, 0)), _mm256_loadu_ps(t.q3)), r3)), s3);
+        const __m256 v = _mm256_blend_ps(_mm256_max_ps(_mm256_max_ps(t1, t2), t3),
+                                         _mm256_min_ps(_mm256_min_ps(t1, t2), t3), 0xF0),
+                     o = _mm256_add_ps(_mm256_shuffle_ps(b, s, _MM_SHUFFLE(0, 1, 0, 1)),
+                                       both(_mm_setr_ps(sy, sx, sd, ss)));
+
+        _mm_storeu_ps(res.vmin, _mm256_castps256_ps128(v));
+        _mm_storeu_ps(res.vmax, _mm256_extractf128_ps(v, 1));
+        _mm_storeu_ps(res.omin, _mm256_castps256_ps128(o));
+        _mm_storeu_ps(res.omax, _mm256_extractf128_ps(o, 1));
+    }
+
+    // AVX needs the OS to save the upper halves of the registers as well as
+    // the CPU to have them.
+    bool has_avx() throw()
+    {
+        unsigned int a, b, c, d;
+        if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_OSXSAVE) || !(c & bit_AVX))
+            return false;
+        unsigned int lo, hi;
+        __asm__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+        return (lo & 6) == 6;
+    }
+#endif
+
+    axis_bounds_fn best() throw()
+    {
+#if defined HAVE_AVX
+        if (has_avx())
+            return bounds_avx;
+#endif
+#if defined HAVE_SSE
+        return bounds_sse;
+#else
+        return bounds_scalar;
+#endif
+    }
+}
+
+
+void AxisTarget::set(const BBox & b, const SlantBox & s, float x, float y)
+{
+    bb = b;
+    sb = s;
+    tx = x;
+    ty = y;
+
+    const float lanes[3][8] = {
+        { b.xa, b.ya, s.sa, s.da,    b.xi, b.yi, s.si, s.di },
+        { s.da, s.di, b.ya, b.xa,    s.di, s.da, b.yi, b.xi },
+        { s.sa, s.sa, b.xa, b.yi,    s.si, s.si, b.xi, b.ya } };
+    const float td = x - y, ts = x + y;
+    const float u[2][4] = {
+        {  y,  x,  td, -ts },
+        { -y, -x, -td,  ts } };
+    memcpy(q1, lanes[0], sizeof q1);
+    memcpy(q2, lanes[1], sizeof q2);
+    memcpy(q3, lanes[2], sizeof q3);
+    memcpy(u2, u[0], sizeof u2);
+    memcpy(u3, u[1], sizeof u3);
+}
+
+
+axis_bounds_fn graphite2::axis_bounds(axis_bounds_kind kind) throw()
+{
+    static axis_bounds_fn chosen = 0;
+    axis_bounds_fn f;
+
+    switch (kind)
+    {
+    case AXIS_BOUNDS_SCALAR:
+        return bounds_scalar;
+#if defined HAVE_SSE
+    case AXIS_BOUNDS_SSE:
+        return bounds_sse;
+#endif
+#if defined HAVE_AVX
+    case AXIS_BOUNDS_AVX:
+        return has_avx() ? bounds_avx : 0;
+#endif
+    case AXIS_BOUNDS_BEST:
+        // Asking the CPU is slow, so only the first caller does.  Any racing
+        // caller gets the same answer.
+        if (!(f = atomic_relaxed_load(chosen)))
+            atomic_relaxed_store(chosen, f = best());
+        return f;
+    default:
+        return 0;
+    }
+}
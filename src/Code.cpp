@@ -29,6 +29,7 @@ of the License or (at your option) any later version.
 // from crashing graphite.
 // Author: Tim Eves
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdlib>
@@ -36,11 +37,13 @@ of the License or (at your option) any later version.
 #include "graphite2/Segment.h"
 #include "inc/Code.h"
 #include "inc/Face.h"
+#include "inc/FeatureMap.h"
 #include "inc/GlyphFace.h"
 #include "inc/GlyphCache.h"
 #include "inc/Machine.h"
 #include "inc/Rule.h"
 #include "inc/Silf.h"
+#include "inc/Snapshot.h"
 
 #include <cstdio>
 
@@ -56,12 +59,240 @@ using namespace vm;
 
 namespace {
 
+// While decoding, the code holds opcode numbers in place of the addresses
+// of their implementations, so it is easy to rewrite.  It is threaded once
+// the rewriting is done.
+inline instr as_instr(const opcode opc) { return reinterpret_cast<instr>(size_t(opc)); }
+inline opcode as_opcode(const instr i) { return opcode(reinterpret_cast<size_t>(i)); }
+
 inline bool is_return(const instr i) {
-    const opcode_t * opmap = Machine::getOpcodeTable();
-    const instr pop_ret  = *opmap[POP_RET].impl,
-                ret_zero = *opmap[RET_ZERO].impl,
-                ret_true = *opmap[RET_TRUE].impl;
-    return i == pop_ret || i == ret_zero || i == ret_true;
+    const opcode opc = as_opcode(i);
+    return opc == POP_RET || opc == RET_ZERO || opc == RET_TRUE;
+}
+
+// Pairs of opcodes common enough in compiled GDL to be worth a single
+// dispatch, found with tests/opcodepairs.  COPY_NEXT is taken as NEXT.
+const struct superinstruction
+{
+    opcode  first, second, fused;
+} superinstructions[] =
+{
+    {NEXT,          NEXT,       NEXT2},
+    {PUSH_BYTE,     POP_RET,    RET_BYTE},
+    {PUT_GLYPH,     NEXT,       PUT_GLYPH_NEXT},
+    {PUT_SUBS,      NEXT,       PUT_SUBS_NEXT},
+    {PUSH_BYTE,     ATTR_SET,   ATTR_SET_BYTE},
+    {PUSH_BYTE,     EQUAL,      EQUAL_BYTE},
+    {PUSH_BYTE,     NOT_EQ,     NOT_EQ_BYTE},
+    {PUSH_BYTE,     LESS_EQ,    LESS_EQ_BYTE}
+};
+
+opcode fused(opcode first, opcode second)
+{
+    if (first == COPY_NEXT)     first = NEXT;
+    if (second == COPY_NEXT)    second = NEXT;
+    for (const superinstruction * s = superinstructions,
+            * const se = s + sizeof superinstructions/sizeof *superinstructions; s != se; ++s)
+        if (s->first == first && s->second == second)
+            return s->fused;
+    return MAX_OPCODE;
+}
+
+size_t param_size(const opcode opc, const byte * param)
+{
+    if (opc == CNTXT_ITEM)  return 3;   // plus the data skip
+    const uint8 sz = Machine::getOpcodeTable()[opc].param_sz;
+    return sz == VARARGS ? param[0] + 1 : sz;
+}
+
+// How many values an opcode takes off the stack before pushing its result.
+// The slot pushes push nothing if their slot is missing, but Code::run
+// checks every slot a program refers to is there first.
+void stack_effect(const opcode opc, int & pops, int & pushes)
+{
+    pops = pushes = 0;
+    switch (opc)
+    {
+    case PUSH_BYTE :
+    case PUSH_BYTEU :
+    case PUSH_SHORT :
+    case PUSH_SHORTU :
+    case PUSH_LONG :
+    case PUSH_SLOT_ATTR :
+    case PUSH_GLYPH_ATTR_OBS :
+    case PUSH_GLYPH_METRIC :
+    case PUSH_FEAT :
+    case PUSH_ATT_TO_GATTR_OBS :
+    case PUSH_ATT_TO_GLYPH_METRIC :
+    case PUSH_ISLOT_ATTR :
+    case PUSH_PROC_STATE :
+    case PUSH_VERSION :
+    case PUSH_GLYPH_ATTR :
+    case PUSH_ATT_TO_GLYPH_ATTR :
+        pushes = 1;
+        break;
+    case ADD :
+    case SUB :
+    case MUL :
+    case DIV :
+    case MIN_ :
+    case MAX_ :
+    case AND :
+    case OR :
+    case EQUAL :
+    case NOT_EQ :
+    case LESS :
+    case GTR :
+    case LESS_EQ :
+    case GTR_EQ :
+    case BITOR :
+    case BITAND :
+        pops = 2; pushes = 1;
+        break;
+    case NEG :
+    case TRUNC8 :
+    case TRUNC16 :
+    case NOT :
+    case BITNOT :
+    case BITSET :
+    case EQUAL_BYTE :
+    case NOT_EQ_BYTE :
+    case LESS_EQ_BYTE :
+        pops = 1; pushes = 1;
+        break;
+    case COND :
+        pops = 3; pushes = 1;
+        break;
+    case ATTR_SET :
+    case ATTR_ADD :
+    case ATTR_SUB :
+    case ATTR_SET_SLOT :
+    case IATTR_SET_SLOT :
+    case IATTR_SET :
+    case IATTR_ADD :
+    case IATTR_SUB :
+    case SET_FEAT :
+    case POP_RET :
+        pops = 1;
+        break;
+    default :
+        break;
+    }
+}
+
+enum stack_proof
+{
+    stack_proven,
+    stack_unproven,
+    stack_underflows,
+    stack_overflows
+};
+
+// Follows the stack depth through a program to prove it stays in bounds, so
+// it can run without checking after every instruction.
+stack_proof prove_stack(const instr * const code, const size_t n, const byte * dp)
+{
+    // The depth lies in [lo, hi], which only differ after a context item
+    // whose two ways through leave different depths.
+    int lo = 0, hi = 0, max_depth = 0,
+        ctxt_lo = 0, ctxt_hi = 0;
+    size_t ctxt_end = 0;
+    bool proven = true;
+
+    for (size_t i = 0; i != n; ++i)
+    {
+        if (ctxt_end && i == ctxt_end)
+        {
+            // Merge in the way round the item, which pushes true.
+            lo = std::min(lo, ctxt_lo + 1);
+            hi = std::max(hi, ctxt_hi + 1);
+            ctxt_end = 0;
+        }
+
+        const opcode opc = as_opcode(code[i]);
+        if (opc == CNTXT_ITEM)
+        {
+            ctxt_end = i + 1 + dp[1];
+            ctxt_lo = lo;
+            ctxt_hi = hi;
+        }
+        dp += param_size(opc, dp);
+
+        int pops, pushes;
+        stack_effect(opc, pops, pushes);
+        if (hi < pops)  return stack_underflows;
+        if (lo < pops)  proven = false;
+        lo += pushes - pops;
+        hi += pushes - pops;
+        max_depth = std::max(max_depth, hi + (opc == CNTXT_ITEM));
+    }
+
+    // Leave room for the value pushed on the way out.
+    if (max_depth >= int(Machine::STACK_MAX))   return stack_overflows;
+    return proven ? stack_proven : stack_unproven;
+}
+
+// Whether a program reads nothing but the glyph attributes, level 0 glyph
+// metrics and features of the slot it is run on. Such a constraint gives
+// the same answer for a glyph and feature set at the same place in a rule.
+bool reads_own_glyph_only(const instr * const code, const size_t n, const byte * dp)
+{
+    for (size_t i = 0; i != n; ++i)
+    {
+        const opcode opc = as_opcode(code[i]);
+        const byte * const param = dp;
+        dp += param_size(opc, dp);
+        switch (opc)
+        {
+        case PUSH_GLYPH_ATTR_OBS :
+        case PUSH_FEAT :
+            if (param[1] != 0)  return false;
+            break;
+        case PUSH_GLYPH_METRIC :
+            if (param[1] != 0 || param[2] != 0)  return false;
+            break;
+        case PUSH_GLYPH_ATTR :
+            if (param[2] != 0)  return false;
+            break;
+        case NOP :
+        case PUSH_BYTE :    case PUSH_BYTEU :   case PUSH_SHORT :
+        case PUSH_SHORTU :  case PUSH_LONG :
+        case ADD :  case SUB :  case MUL :  case DIV :
+        case MIN_ : case MAX_ : case NEG :
+        case TRUNC8 :       case TRUNC16 :      case COND :
+        case AND :  case OR :   case NOT :
+        case EQUAL :        case NOT_EQ :
+        case LESS : case GTR :  case LESS_EQ :  case GTR_EQ :
+        case BITOR :        case BITAND :       case BITNOT :   case BITSET :
+        case EQUAL_BYTE :   case NOT_EQ_BYTE :  case LESS_EQ_BYTE :
+        case PUSH_PROC_STATE :  case PUSH_VERSION :
+        case CNTXT_ITEM :
+        case POP_RET :      case RET_ZERO :     case RET_TRUE :     case RET_BYTE :
+            break;
+        default :
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sets_features(const instr * const code, const size_t n)
+{
+    for (size_t i = 0; i != n; ++i)
+        if (as_opcode(code[i]) == SET_FEAT)
+            return true;
+    return false;
+}
+
+// The shortest push that gives value, and how many data bytes it takes.
+opcode shortest_push(const int32 value, int & sz)
+{
+    if (value == int8(value))   { sz = 1; return PUSH_BYTE; }
+    if (value == uint8(value))  { sz = 1; return PUSH_BYTEU; }
+    if (value == int16(value))  { sz = 2; return PUSH_SHORT; }
+    if (value == uint16(value)) { sz = 2; return PUSH_SHORTU; }
+    sz = 4;
+    return PUSH_LONG;
 }
 
 struct context
@@ -87,6 +318,7 @@ public:
 
     bool        load(const byte * bc_begin, const byte * bc_end);
     void        apply_analysis(instr * const code, instr * code_end);
+    void        apply_fusion(instr * const code, instr * code_end);
     byte        max_ref() { return _max_ref; }
     int         out_index() const { return _out_index; }
 
@@ -97,6 +329,8 @@ private:
     opcode      fetch_opcode(const byte * bc);
     void        analyse_opcode(const opcode, const int8 * const dp) throw();
     bool        emit_opcode(opcode opc, const byte * & bc);
+    bool        fold_opcode(opcode opc, const byte * bc, size_t param_sz);
+    void        emit_constant(int32 value, const byte * bc);
     bool        validate_opcode(const byte opc, const byte * const bc);
     bool        valid_upto(const uint16 limit, const uint16 x) const throw();
     bool        test_context() const throw();
@@ -110,11 +344,26 @@ private:
     byte              * _data;
     limits            & _max;
     enum passtype       _passtype;
-    int                 _stack_depth;
     bool                _in_ctxt_item;
     int16               _slotref;
     context             _contexts[NUMCONTEXTS];
     byte                _max_ref;
+    // The least the stack can hold after the instructions emitted so far.
+    int                 _depth;
+
+    // The constants pushed by the last instructions emitted, most recent
+    // last, where each one's push starts and the least the stack holds
+    // beneath it.
+    enum { MAX_CONSTANTS = 8 };
+    struct constant
+    {
+        int32        value;
+        instr      * code;
+        byte       * data;
+        const byte * bytecode;
+        int          depth;
+    }                   _constants[MAX_CONSTANTS];
+    int                 _num_constants;
 };
 
 
@@ -134,10 +383,11 @@ inline Machine::Code::decoder::decoder(limits & lims, Code &code, enum passtype
   _out_index(code._constraint ? 0 : lims.pre_context),
   _out_length(code._constraint ? 1 : lims.rule_length),
   _instr(code._code), _data(code._data), _max(lims), _passtype(pt),
-  _stack_depth(0),
   _in_ctxt_item(false),
   _slotref(0),
-  _max_ref(0)
+  _max_ref(0),
+  _depth(0),
+  _num_constants(0)
 { }
 
 
@@ -145,8 +395,9 @@ inline Machine::Code::decoder::decoder(limits & lims, Code &code, enum passtype
 Machine::Code::Code(bool is_constraint, const byte * bytecode_begin, const byte * const bytecode_end,
            uint8 pre_context, uint16 rule_length, const Silf & silf, const Face & face,
            enum passtype pt, byte * * const _out)
- :  _code(0), _data(0), _data_size(0), _instr_count(0), _max_ref(0), _status(loaded),
-    _constraint(is_constraint), _modify(false), _delete(false), _own(_out==0)
+ :  _code(0), _data(0), _native(0), _data_size(0), _instr_count(0), _max_ref(0), _status(loaded),
+    _constraint(is_constraint), _modify(false), _delete(false), _verified(false),
+    _own_glyph_only(false), _sets_feats(false), _own(_out==0)
 {
 #ifdef GRAPHITE2_TELEMETRY
     telemetry::category _code_cat(face.tele.code);
@@ -207,8 +458,22 @@ Machine::Code::Code(bool is_constraint, const byte * bytecode_begin, const byte
 
     assert((_constraint && immutable()) || !_constraint);
     dec.apply_analysis(_code, _code + _instr_count);
+    dec.apply_fusion(_code, _code + _instr_count);
     _max_ref = dec.max_ref();
 
+    switch (prove_stack(_code, _instr_count, _data))
+    {
+    case stack_underflows:  failure(underfull_stack); return;
+    case stack_overflows:   failure(overfull_stack); return;
+    case stack_proven:      _verified = true; break;
+    case stack_unproven:    break;
+    }
+    _own_glyph_only = _constraint && reads_own_glyph_only(_code, _instr_count, _data);
+    _sets_feats = sets_features(_code, _instr_count);
+    op_to_fn = Machine::getOpcodeTable(_verified);
+    for (instr * ip = _code, * const ie = _code + _instr_count; ip != ie; ++ip)
+        *ip = op_to_fn[as_opcode(*ip)].impl[_constraint];
+
     // Now we know exactly how much code and data the program really needs
     // realloc the buffers to exactly the right size so we don't waste any
     // memory.
@@ -278,15 +543,13 @@ opcode Machine::Code::decoder::fetch_opcode(const byte * bc)
     // And check its arguments as far as possible
     switch (opcode(opc))
     {
+        // Stack effects are checked once the whole program is decoded.
         case NOP :
-            break;
         case PUSH_BYTE :
         case PUSH_BYTEU :
         case PUSH_SHORT :
         case PUSH_SHORTU :
         case PUSH_LONG :
-            ++_stack_depth;
-            break;
         case ADD :
         case SUB :
         case MUL :
@@ -303,22 +566,13 @@ opcode Machine::Code::decoder::fetch_opcode(const byte * bc)
         case GTR_EQ :
         case BITOR :
         case BITAND :
-            if (--_stack_depth <= 0)
-                failure(underfull_stack);
-            break;
         case NEG :
         case TRUNC8 :
         case TRUNC16 :
         case NOT :
         case BITNOT :
         case BITSET :
-            if (_stack_depth <= 0)
-                failure(underfull_stack);
-            break;
         case COND :
-            _stack_depth -= 2;
-            if (_stack_depth <= 0)
-                failure(underfull_stack);
             break;
         case NEXT_N :           // runtime checked
             break;
@@ -376,22 +630,17 @@ opcode Machine::Code::decoder::fetch_opcode(const byte * bc)
         case ATTR_ADD :
         case ATTR_SUB :
         case ATTR_SET_SLOT :
-            if (--_stack_depth < 0)
-                failure(underfull_stack);
             valid_upto(gr_slatMax, bc[0]);
             if (attrCode(bc[0]) == gr_slatUserDefn)     // use IATTR for user attributes
                 failure(out_of_range_data);
             test_context();
             break;
         case IATTR_SET_SLOT :
-            if (--_stack_depth < 0)
-                failure(underfull_stack);
             if (valid_upto(gr_slatMax, bc[0]))
                 valid_upto(_max.attrid[bc[0]], bc[1]);
             test_context();
             break;
         case PUSH_SLOT_ATTR :
-            ++_stack_depth;
             valid_upto(gr_slatMax, bc[0]);
             test_ref(int8(bc[1]));
             if (attrCode(bc[0]) == gr_slatUserDefn)     // use IATTR for user attributes
@@ -399,24 +648,20 @@ opcode Machine::Code::decoder::fetch_opcode(const byte * bc)
             break;
         case PUSH_GLYPH_ATTR_OBS :
         case PUSH_ATT_TO_GATTR_OBS :
-            ++_stack_depth;
             valid_upto(_max.glyf_attrs, bc[0]);
             test_ref(int8(bc[1]));
             break;
         case PUSH_ATT_TO_GLYPH_METRIC :
         case PUSH_GLYPH_METRIC :
-            ++_stack_depth;
             valid_upto(kgmetDescent, bc[0]);
             test_ref(int8(bc[1]));
             // level: dp[2] no check necessary
             break;
         case PUSH_FEAT :
-            ++_stack_depth;
             valid_upto(_max.features, bc[0]);
             test_ref(int8(bc[1]));
             break;
         case PUSH_ISLOT_ATTR :
-            ++_stack_depth;
             if (valid_upto(gr_slatMax, bc[0]))
             {
                 test_ref(int8(bc[1]));
@@ -424,28 +669,20 @@ opcode Machine::Code::decoder::fetch_opcode(const byte * bc)
             }
             break;
         case PUSH_IGLYPH_ATTR :// not implemented
-            ++_stack_depth;
             break;
         case POP_RET :
-            if (--_stack_depth < 0)
-                failure(underfull_stack);
-            GR_FALLTHROUGH;
-            // no break
         case RET_ZERO :
         case RET_TRUE :
             break;
         case IATTR_SET :
         case IATTR_ADD :
         case IATTR_SUB :
-            if (--_stack_depth < 0)
-                failure(underfull_stack);
             if (valid_upto(gr_slatMax, bc[0]))
                 valid_upto(_max.attrid[bc[0]], bc[1]);
             test_context();
             break;
         case PUSH_PROC_STATE :  // dummy: dp[0] no check necessary
         case PUSH_VERSION :
-            ++_stack_depth;
             break;
         case PUT_SUBS :
             test_ref(int8(bc[0]));
@@ -462,7 +699,6 @@ opcode Machine::Code::decoder::fetch_opcode(const byte * bc)
             break;
         case PUSH_GLYPH_ATTR :
         case PUSH_ATT_TO_GLYPH_ATTR :
-            ++_stack_depth;
             valid_upto(_max.glyf_attrs, uint16(bc[0]<< 8) | bc[1]);
             test_ref(int8(bc[2]));
             break;
@@ -558,9 +794,19 @@ bool Machine::Code::decoder::emit_opcode(opcode opc, const byte * & bc)
 
     const size_t     param_sz = op.param_sz == VARARGS ? bc[0] + 1 : op.param_sz;
 
+    // Work out constant expressions here rather than at every run.
+    if (fold_opcode(opc, bc, param_sz))
+    {
+        bc += param_sz;
+        return bool(_code);
+    }
+
     // Add this instruction
-    *_instr++ = op.impl[_code._constraint];
+    *_instr++ = as_instr(opc);
     ++_code._instr_count;
+    int pops, pushes;
+    stack_effect(opc, pops, pushes);
+    _depth = std::max(_depth - pops, 0) + pushes;
 
     // Grab the parameters
     if (param_sz) {
@@ -584,14 +830,20 @@ bool Machine::Code::decoder::emit_opcode(opcode opc, const byte * & bc)
         byte & instr_skip = _data[-1];
         byte & data_skip  = *_data++;
         ++_code._data_size;
+        const byte * const data_start = _data;
         const byte *curr_end = _max.bytecode;
+        const int depth = _depth;
 
+        _num_constants = 0;
         if (load(bc, bc + instr_skip))
         {
             bc += instr_skip;
-            data_skip  = instr_skip - byte(_code._instr_count - ctxt_start);
+            data_skip  = byte(_data - data_start);
             instr_skip =  byte(_code._instr_count - ctxt_start);
             _max.bytecode = curr_end;
+            _num_constants = 0;
+            // Skipping the item pushes true instead.
+            _depth = std::min(_depth, depth + 1);
 
             _out_length = 1;
             _out_index = 0;
@@ -610,13 +862,213 @@ bool Machine::Code::decoder::emit_opcode(opcode opc, const byte * & bc)
 }
 
 
+// Folds opc into the constants it works on, or drops it along with a
+// constant that leaves the value beneath unchanged.  Returns false, having
+// forgotten the constants, if opc must be emitted.  A result is never given
+// more data than the bytecode it replaces, which is all the room the data
+// buffer has for it.
+bool Machine::Code::decoder::fold_opcode(opcode opc, const byte * bc, size_t param_sz)
+{
+    const int n = _num_constants;
+    const int32 a = n > 1 ? _constants[n-2].value : 0,
+                b = n > 0 ? _constants[n-1].value : 0;
+    int32 r;
+    int used;
+    switch (opc)
+    {
+    case PUSH_BYTE :        r = int8(bc[0]); used = 0; break;
+    case PUSH_BYTEU :       r = uint8(bc[0]); used = 0; break;
+    case PUSH_SHORT :       r = int16(bc[0] << 8 | bc[1]); used = 0; break;
+    case PUSH_SHORTU :      r = uint16(bc[0] << 8 | bc[1]); used = 0; break;
+    case PUSH_LONG :
+        r = int32(uint32(bc[0]) << 24 | uint32(bc[1]) << 16 | uint32(bc[2]) << 8 | bc[3]);
+        used = 0;
+        break;
+    case PUSH_PROC_STATE :  r = 1; used = 0; break;
+    case PUSH_VERSION :     r = 0x00030000; used = 0; break;
+    case NEG :      if (n < 1) goto emit; r = int32(-uint32(b)); used = 1; break;
+    case TRUNC8 :   if (n < 1) goto emit; r = uint8(b); used = 1; break;
+    case TRUNC16 :  if (n < 1) goto emit; r = uint16(b); used = 1; break;
+    case NOT :      if (n < 1) goto emit; r = !b; used = 1; break;
+    case BITNOT :   if (n < 1) goto emit; r = ~b; used = 1; break;
+    case BITSET :
+        if (n < 1) goto emit;
+        r = (b & ~int32(uint16(bc[0] << 8 | bc[1]))) | int32(uint16(bc[2] << 8 | bc[3]));
+        used = 1;
+        break;
+    case ADD :
+    case SUB :
+    case MUL :
+    case DIV :
+    case BITOR :
+    case BITAND :
+        if (n == 1)
+        {
+            // Adding zero and the like only costs a dispatch, as long as
+            // there is something beneath for it to leave alone.  Otherwise
+            // the program is left to be refused.
+            const bool identity = opc == ADD || opc == SUB || opc == BITOR ? b == 0
+                                : opc == BITAND ? b == -1 : b == 1;
+            if (!identity || _constants[0].depth == 0)  goto emit;
+            _instr = _constants[0].code;
+            _data  = _constants[0].data;
+            _depth = _constants[0].depth;
+            _code._instr_count = _instr - _code._code;
+            _code._data_size   = _data - _code._data;
+            _num_constants = 0;
+            return true;
+        }
+        GR_FALLTHROUGH;
+        // no break
+    case MIN_ :
+    case MAX_ :
+    case AND :
+    case OR :
+    case EQUAL :
+    case NOT_EQ :
+    case LESS :
+    case GTR :
+    case LESS_EQ :
+    case GTR_EQ :
+        if (n < 2) goto emit;
+        switch (opc)
+        {
+        case ADD :      r = int32(uint32(a) + uint32(b)); break;
+        case SUB :      r = int32(uint32(a) - uint32(b)); break;
+        case MUL :      r = int32(uint32(a) * uint32(b)); break;
+        case DIV :
+            // Leave the machine to die on these.
+            if (b == 0 || (a == std::numeric_limits<int32>::min() && b == -1))
+                goto emit;
+            r = a / b;
+            break;
+        case MIN_ :     r = a < b ? a : b; break;
+        case MAX_ :     r = a > b ? a : b; break;
+        case AND :      r = a && b; break;
+        case OR :       r = a || b; break;
+        case EQUAL :    r = a == b; break;
+        case NOT_EQ :   r = a != b; break;
+        case LESS :     r = a < b; break;
+        case GTR :      r = a > b; break;
+        case LESS_EQ :  r = a <= b; break;
+        case GTR_EQ :   r = a >= b; break;
+        case BITOR :    r = a | b; break;
+        default :       r = a & b; break;
+        }
+        used = 2;
+        break;
+    case COND :
+        if (n < 3) goto emit;
+        r = _constants[n-3].value ? a : b;
+        used = 3;
+        break;
+    default :
+        goto emit;
+    }
+
+    {
+        // PUSH_VERSION, say, is a single byte of bytecode.
+        const byte * const start = used ? _constants[n-used].bytecode : bc - 1;
+        int sz;
+        shortest_push(r, sz);
+        if (ptrdiff_t(sz) > bc + param_sz - start)    goto emit;
+
+        // Replace the constants used with the result.
+        if (used)
+        {
+            _num_constants -= used;
+            _instr = _constants[_num_constants].code;
+            _data  = _constants[_num_constants].data;
+            _depth = _constants[_num_constants].depth;
+            _code._instr_count = _instr - _code._code;
+            _code._data_size   = _data - _code._data;
+        }
+        emit_constant(r, start);
+    }
+    return true;
+
+emit:
+    _num_constants = 0;
+    return false;
+}
+
+
+void Machine::Code::decoder::emit_constant(int32 value, const byte * bc)
+{
+    if (_num_constants == MAX_CONSTANTS)
+    {
+        memmove(_constants, _constants + 1, (MAX_CONSTANTS - 1) * sizeof(constant));
+        --_num_constants;
+    }
+    const constant c = { value, _instr, _data, bc, _depth };
+    _constants[_num_constants++] = c;
+    ++_depth;
+
+    const uint32 v = uint32(value);
+    int sz;
+    *_instr = as_instr(shortest_push(value, sz));
+    for (int i = sz; i; --i)
+        *_data++ = byte(v >> (8 * (i - 1)));
+    ++_instr;
+    ++_code._instr_count;
+    _code._data_size += sz;
+}
+
+
+void Machine::Code::decoder::apply_fusion(instr * const code, instr * code_end)
+{
+    // Fusing keeps every parameter where it was, only context item
+    // instruction skips need adjusting.
+    instr * out = code;
+    const byte * dp = _code._data;
+    instr * ctxt = 0;
+    byte * ctxt_skip = 0;
+    const instr * ctxt_end = 0;
+
+    for (const instr * ip = code; ip != code_end; ++ip)
+    {
+        if (ip == ctxt_end)
+        {
+            *ctxt_skip = byte(out - ctxt - 1);
+            ctxt_end = 0;
+        }
+
+        const opcode opc = as_opcode(*ip);
+        if (opc == CNTXT_ITEM)
+        {
+            ctxt = out;
+            ctxt_skip = const_cast<byte *>(dp) + 1;
+            ctxt_end = ip + 1 + dp[1];
+        }
+        dp += param_size(opc, dp);
+
+        if (ip + 1 != code_end && ip + 1 != ctxt_end)
+        {
+            const opcode second = as_opcode(ip[1]),
+                         fuse   = fused(opc, second);
+            if (fuse != MAX_OPCODE)
+            {
+                *out++ = as_instr(fuse);
+                dp += param_size(second, dp);
+                ++ip;
+                continue;
+            }
+        }
+        *out++ = *ip;
+    }
+    if (ctxt_end == code_end)
+        *ctxt_skip = byte(out - ctxt - 1);
+
+    _code._instr_count = out - code;
+}
+
 void Machine::Code::decoder::apply_analysis(instr * const code, instr * code_end)
 {
     // insert TEMP_COPY commands for slots that need them (that change and are referenced later)
     int tempcount = 0;
     if (_code._constraint) return;
 
-    const instr temp_copy = Machine::getOpcodeTable()[TEMP_COPY].impl[0];
+    const instr temp_copy = as_instr(TEMP_COPY);
     for (const context * c = _contexts, * const ce = c + _slotref; c < ce; ++c)
     {
         if (!c->flags.referenced || !c->flags.changed) continue;
@@ -738,10 +1190,109 @@ void Machine::Code::release_buffers() throw()
         free(_code);
     _code = 0;
     _data = 0;
+    _native = 0;
     _own  = false;
 }
 
 
+bool Machine::Code::writeImage(SnapshotWriter & w) const
+{
+    w.write(uint32(_instr_count));
+    w.write(uint32(_data_size));
+    w.write(_max_ref);
+    w.write(byte(_constraint | _modify << 1 | _delete << 2));
+
+    // The threaded code holds addresses, so map each back to its opcode.
+    for (size_t i = 0; i != _instr_count; ++i)
+    {
+        const int opc = opcodeOf(i);
+        if (opc < 0) return false;
+        w.write(uint8(opc));
+    }
+    w.write(_data, _data_size);
+    return true;
+}
+
+// The opcodes are checked and the stack proved again, but the operands are
+// taken as the decoder left them, which is why images are trusted input.
+bool Machine::Code::readImage(SnapshotReader & r, byte * * const _out, const byte * const out_end)
+{
+    const uint32 instr_count = r.read<uint32>(),
+                 data_size   = r.read<uint32>();
+    _max_ref = r.read<byte>();
+    const byte flags = r.read<byte>();
+    _constraint = flags & 1;
+    _modify     = (flags >> 1) & 1;
+    _delete     = (flags >> 2) & 1;
+    _own        = _out == 0;
+    if (!r.test(instr_count > r.remaining() || data_size > r.remaining() - instr_count))
+        return false;
+    if (instr_count == 0)
+        return r.test(data_size != 0);
+
+    _instr_count = instr_count;
+    _data_size   = data_size;
+    const size_t total_sz = imageProgramSize();
+    if (_out)
+    {
+        if (!r.test(size_t(out_end - *_out) < total_sz)) return false;
+        _code = reinterpret_cast<instr *>(*_out);
+        *_out += total_sz;
+    }
+    else
+        _code = static_cast<instr *>(malloc(total_sz));
+    if (!_code)
+    {
+        failure(alloc_failed);
+        return false;
+    }
+    _data = reinterpret_cast<byte *>(_code + (_instr_count+1));
+
+    const opcode_t * op_to_fn = Machine::getOpcodeTable();
+    for (instr * ip = _code, * const ie = _code + _instr_count; ip != ie; ++ip)
+    {
+        const uint8 opc = r.read<uint8>();
+        if (!r.test(opc >= NUM_OPCODES || !op_to_fn[opc].impl[_constraint]))
+        {
+            failure(invalid_opcode);
+            return false;
+        }
+        *ip = as_instr(opcode(opc));
+    }
+    if (!r.read(_data, _data_size))
+    {
+        failure(arguments_exhausted);
+        return false;
+    }
+
+    // The proof is not stored, an image could claim one it does not have.
+    const stack_proof proof = prove_stack(_code, _instr_count, _data);
+    if (!r.test(proof == stack_underflows || proof == stack_overflows))
+    {
+        failure(proof == stack_underflows ? underfull_stack : overfull_stack);
+        return false;
+    }
+    _verified = proof == stack_proven;
+    _own_glyph_only = _constraint && reads_own_glyph_only(_code, _instr_count, _data);
+    _sets_feats = sets_features(_code, _instr_count);
+    op_to_fn = Machine::getOpcodeTable(_verified);
+    for (instr * ip = _code, * const ie = _code + _instr_count; ip != ie; ++ip)
+        *ip = op_to_fn[as_opcode(*ip)].impl[_constraint];
+    _code[_instr_count] = op_to_fn[RET_ZERO].impl[_constraint];
+    return true;
+}
+
+
+int Machine::Code::opcodeOf(size_t i) const throw()
+{
+    const opcode_t * op_to_fn = Machine::getOpcodeTable(_verified);
+    for (int opc = 0; opc != NUM_OPCODES; ++opc)
+        if (op_to_fn[opc].impl[_constraint] == _code[i])
+            return opc;
+    return -1;
+}
+
+
 int32 Machine::Code::run(Machine & m, slotref * & map) const
 {
 //    assert(_own);
@@ -755,5 +1306,166 @@ int32 Machine::Code::run(Machine & m, slotref * & map) const
 //        return m.run(_code, _data, map);
     }
 
-    return  m.run(_code, _data, map);
+#ifdef GRAPHITE2_JIT
+    if (_native)
+        return m.run(_native, _data, map);
+#endif
+    return  m.run(_code, _data, map, _verified);
+}
+
+namespace
+{
+    // A stack value that is either known or depends on the glyphs.
+    struct known_value
+    {
+        int32   value;
+        bool    known;
+    };
+}
+
+bool Machine::Code::failsWith(const FeatureMap & fmap, const FeatureVal & feats) const throw()
+{
+    if (!_constraint || !*this)  return false;
+
+    enum { MAX_DEPTH = 32 };
+    known_value stack[MAX_DEPTH];
+    int         depth = 0;
+    // Where the context item being evaluated ends, and its stack depth
+    size_t      ctxt_end = 0;
+    int         ctxt_depth = -1;
+    const opcode_t * const op_to_fn = Machine::getOpcodeTable();
+    const byte * dp = _data, * const de = _data + _data_size;
+
+    for (size_t i = 0; i != _instr_count; ++i)
+    {
+        const int opc = opcodeOf(i);
+        if (opc < 0)    return false;
+        const size_t param_sz = opc == CNTXT_ITEM ? 3 : op_to_fn[opc].param_sz;
+        if (param_sz == VARARGS || size_t(de - dp) < param_sz) return false;
+        const byte * const param = dp;
+        dp += param_sz;
+        // A context item may not use what was pushed before it.
+        const int floor = ctxt_depth < 0 ? 0 : ctxt_depth;
+
+        known_value r = { 0, false };
+        bool pushes = true;
+        switch (opc)
+        {
+        case NOP :
+            pushes = false;
+            break;
+        case PUSH_BYTE :        r.value = int8(param[0]); r.known = true; break;
+        case PUSH_BYTEU :       r.value = uint8(param[0]); r.known = true; break;
+        case PUSH_SHORT :       r.value = int16(param[0] << 8 | param[1]); r.known = true; break;
+        case PUSH_SHORTU :      r.value = uint16(param[0] << 8 | param[1]); r.known = true; break;
+        case PUSH_LONG :
+            r.value = int32(uint32(param[0]) << 24 | uint32(param[1]) << 16 | uint32(param[2]) << 8 | param[3]);
+            r.known = true;
+            break;
+        case PUSH_FEAT :
+        {
+            // Other slots may fall outside the segment and push nothing.
+            if (param[1] != 0)  return false;
+            const FeatureRef * const f = fmap.featureRef(param[0]);
+            r.value = f ? int32(f->getFeatureVal(feats)) : 0;
+            r.known = true;
+            break;
+        }
+        case PUSH_SLOT_ATTR :
+        case PUSH_GLYPH_ATTR_OBS :
+        case PUSH_GLYPH_METRIC :
+        case PUSH_ATT_TO_GATTR_OBS :
+        case PUSH_ATT_TO_GLYPH_METRIC :
+        case PUSH_ISLOT_ATTR :
+            if (param[1] != 0)  return false;
+            break;
+        case PUSH_GLYPH_ATTR :
+        case PUSH_ATT_TO_GLYPH_ATTR :
+            if (param[2] != 0)  return false;
+            break;
+        case CNTXT_ITEM :
+            // Skipped for all but one slot, where it yields whatever the
+            // slot makes of it, so only its stack effect is of interest.
+            if (ctxt_depth >= 0 || param[1] == 0 || i + param[1] >= _instr_count)
+                return false;
+            ctxt_end = i + param[1];
+            ctxt_depth = depth;
+            pushes = false;
+            break;
+        case NOT :
+        case NEG :
+            if (depth < floor + 1)  return false;
+            r = stack[--depth];
+            r.value = opc == NOT ? !r.value : int32(-uint32(r.value));
+            break;
+        case AND :
+        case OR :
+        case ADD :
+        case SUB :
+        case EQUAL :
+        case NOT_EQ :
+        case LESS :
+        case GTR :
+        case LESS_EQ :
+        case GTR_EQ :
+        case EQUAL_BYTE :
+        case NOT_EQ_BYTE :
+        case LESS_EQ_BYTE :
+        {
+            const bool immediate = opc >= EQUAL_BYTE;
+            if (depth < floor + 2 - immediate)  return false;
+            known_value b = { int8(param[0]), true };
+            if (!immediate) b = stack[--depth];
+            const known_value a = stack[--depth];
+            r.known = a.known && b.known;
+            switch (opc)
+            {
+            case AND :
+                r.value = a.value && b.value;
+                // Either side being false is enough.
+                if ((a.known && !a.value) || (b.known && !b.value)) { r.value = 0; r.known = true; }
+                break;
+            case OR :
+                r.value = a.value || b.value;
+                if ((a.known && a.value) || (b.known && b.value)) { r.value = 1; r.known = true; }
+                break;
+            case ADD :      r.value = int32(uint32(a.value) + uint32(b.value)); break;
+            case SUB :      r.value = int32(uint32(a.value) - uint32(b.value)); break;
+            case EQUAL :
+            case EQUAL_BYTE :   r.value = a.value == b.value; break;
+            case NOT_EQ :
+            case NOT_EQ_BYTE :  r.value = a.value != b.value; break;
+            case LESS :     r.value = a.value < b.value; break;
+            case GTR :      r.value = a.value > b.value; break;
+            case LESS_EQ :
+            case LESS_EQ_BYTE : r.value = a.value <= b.value; break;
+            default :       r.value = a.value >= b.value; break;
+            }
+            break;
+        }
+        case POP_RET :
+            return depth && ctxt_depth < 0 && stack[depth-1].known && !stack[depth-1].value;
+        case RET_BYTE :
+            return ctxt_depth < 0 && param[0] == 0;
+        case RET_ZERO :
+            return ctxt_depth < 0;
+        default :
+            return false;
+        }
+
+        if (pushes)
+        {
+            if (depth == MAX_DEPTH) return false;
+            stack[depth++] = r;
+        }
+
+        if (ctxt_depth >= 0 && i == ctxt_end)
+        {
+            // The item leaves one value either way, which depends on the slot.
+            if (depth != ctxt_depth + 1)    return false;
+            stack[ctxt_depth].known = false;
+            ctxt_depth = -1;
+        }
+    }
+    return false;
 }
@@ -25,6 +25,7 @@ License, as published by the Free Software Foundation, either version 2
 of the License or (at your option) any later version.
 */
 #include <algorithm>
+#include <cassert>
 #include <limits>
 #include <cmath>
 #include <string>
@@ -115,6 +116,7 @@ bool ShiftCollider::initSlot(Segment *seg, Slot *aSlot, const Rect &limit, float
     _currOffset = currOffset;
     _currShift = currShift;
     _origin = aSlot->origin() - currOffset;     // the original anchor position of the glyph
+    _axisTarget.set(bb, sb, _currOffset.x + _currShift.x, _currOffset.y + _currShift.y);
 
 	_margin = margin;
 	_marginWt = marginWeight;
@@ -270,8 +272,6 @@ bool ShiftCollider::mergeSlot(Segment *seg, Slot *slot, const SlotCollision *csl
     bool isCol = false;
     const float sx = slot->origin().x - _origin.x + currShift.x;
     const float sy = slot->origin().y - _origin.y + currShift.y;
-    const float sd = sx - sy;
-    const float ss = sx + sy;
     float vmin, vmax;
     float omin, omax, otmin, otmax;
     float cmin, cmax;   // target limits
@@ -322,28 +322,28 @@ bool ShiftCollider::mergeSlot(Segment *seg, Slot *slot, const SlotCollision *csl
 #endif
 
         // Process main bounding octabox.
+        AxisBounds mb;
+        _bounds(_axisTarget, bb, sb, sx, sy, false, mb);
+        AxisBounds subs[16];    // sub-boxes come from a 16 bit map
+        bool subsDone = false;
         for (int i = 0; i < 4; ++i)
         {
+            vmin = mb.vmin[i];
+            vmax = mb.vmax[i];
+            omin = mb.omin[i];
+            omax = mb.omax[i];
             switch (i) {
                 case 0 :	// x direction
-                    vmin = max(max(bb.xi - tbb.xa + sx, sb.di - tsb.da + ty + sd), sb.si - tsb.sa - ty + ss);
-                    vmax = min(min(bb.xa - tbb.xi + sx, sb.da - tsb.di + ty + sd), sb.sa - tsb.si - ty + ss);
                     otmin = tbb.yi + ty;
                     otmax = tbb.ya + ty;
-                    omin = bb.yi + sy;
-                    omax = bb.ya + sy;
                     torg = _currOffset.x;
                     cmin = _limit.bl.x + torg;
                     cmax = _limit.tr.x - tbb.xi + tbb.xa + torg;
                     lmargin = _margin;
                     break;
                 case 1 :	// y direction
-                    vmin = max(max(bb.yi - tbb.ya + sy, tsb.di - sb.da + tx - sd), sb.si - tsb.sa - tx + ss);
-                    vmax = min(min(bb.ya - tbb.yi + sy, tsb.da - sb.di + tx - sd), sb.sa - tsb.si - tx + ss);
                     otmin = tbb.xi + tx;
                     otmax = tbb.xa + tx;
-                    omin = bb.xi + sx;
-                    omax = bb.xa + sx;
                     torg = _currOffset.y;
                     cmin = _limit.bl.y + torg;
                     cmax = _limit.tr.y - tbb.yi + tbb.ya + torg;
@@ -351,12 +351,8 @@ bool ShiftCollider::mergeSlot(Segment *seg, Slot *slot, const SlotCollision *csl
                     break;
                 case 2 :    // sum - moving along the positively-sloped vector, so the boundaries are the
                             // negatively-sloped boundaries.
-                    vmin = max(max(sb.si - tsb.sa + ss, 2 * (bb.yi - tbb.ya + sy) + td), 2 * (bb.xi - tbb.xa + sx) - td);
-                    vmax = min(min(sb.sa - tsb.si + ss, 2 * (bb.ya - tbb.yi + sy) + td), 2 * (bb.xa - tbb.xi + sx) - td);
                     otmin = tsb.di + td;
                     otmax = tsb.da + td;
-                    omin = sb.di + sd;
-                    omax = sb.da + sd;
                     torg = _currOffset.x + _currOffset.y;
                     cmin = _limit.bl.x + _limit.bl.y + torg;
                     cmax = _limit.tr.x + _limit.tr.y - tsb.si + tsb.sa + torg;
@@ -364,12 +360,8 @@ bool ShiftCollider::mergeSlot(Segment *seg, Slot *slot, const SlotCollision *csl
                     break;
                 case 3 :    // diff - moving along the negatively-sloped vector, so the boundaries are the
                             // positively-sloped boundaries.
-                    vmin = max(max(sb.di - tsb.da + sd, 2 * (bb.xi - tbb.xa + sx) - ts), -2 * (bb.ya - tbb.yi + sy) + ts);
-                    vmax = min(min(sb.da - tsb.di + sd, 2 * (bb.xa - tbb.xi + sx) - ts), -2 * (bb.yi - tbb.ya + sy) + ts);
                     otmin = tsb.si + ts;
                     otmax = tsb.sa + ts;
-                    omin = sb.si + ss;
-                    omax = sb.sa + ss;
                     torg = _currOffset.x - _currOffset.y;
                     cmin = _limit.bl.x - _limit.tr.y + torg;
                     cmax = _limit.tr.x - _limit.bl.y - tsb.di + tsb.da + torg;
@@ -484,36 +476,20 @@ bool ShiftCollider::mergeSlot(Segment *seg, Slot *slot, const SlotCollision *csl
             if (numsub > 0)
             {
                 bool anyhits = false;
+                if (!subsDone)
+                {
+                    assert(numsub <= 16);
+                    for (int j = 0; j < numsub; ++j)
+                        _bounds(_axisTarget, gc.getSubBoundingBBox(gid, j), gc.getSubBoundingSlantBox(gid, j),
+                                sx, sy, true, subs[j]);
+                    subsDone = true;
+                }
                 for (int j = 0; j < numsub; ++j)
                 {
-                    const BBox &sbb = gc.getSubBoundingBBox(gid, j);
-                    const SlantBox &ssb = gc.getSubBoundingSlantBox(gid, j);
-                    switch (i) {
-                        case 0 :    // x
-                            vmin = max(max(sbb.xi-tbb.xa+sx, ssb.di-tsb.da+sd+ty), ssb.si-tsb.sa+ss-ty);
-                            vmax = min(min(sbb.xa-tbb.xi+sx, ssb.da-tsb.di+sd+ty), ssb.sa-tsb.si+ss-ty);
-                            omin = sbb.yi + sy;
-                            omax = sbb.ya + sy;
-                            break;
-                        case 1 :    // y
-                            vmin = max(max(sbb.yi-tbb.ya+sy, tsb.di-ssb.da-sd+tx), ssb.si-tsb.sa+ss-tx);
-                            vmax = min(min(sbb.ya-tbb.yi+sy, tsb.da-ssb.di-sd+tx), ssb.sa-tsb.si+ss-tx);
-                            omin = sbb.xi + sx;
-                            omax = sbb.xa + sx;
-                            break;
-                        case 2 :    // sum
-                            vmin = max(max(ssb.si-tsb.sa+ss, 2*(sbb.yi-tbb.ya+sy)+td), 2*(sbb.xi-tbb.xa+sx)-td);
-                            vmax = min(min(ssb.sa-tsb.si+ss, 2*(sbb.ya-tbb.yi+sy)+td), 2*(sbb.xa-tbb.xi+sx)-td);
-                            omin = ssb.di + sd;
-                            omax = ssb.da + sd;
-                            break;
-                        case 3 :    // diff
-                            vmin = max(max(ssb.di-tsb.da+sd, 2*(sbb.xi-tbb.xa+sx)-ts), -2*(sbb.ya-tbb.yi+sy)+ts);
-                            vmax = min(min(ssb.da-tsb.di+sd, 2*(sbb.xa-tbb.xi+sx)-ts), -2*(sbb.yi-tbb.ya+sy)+ts);
-                            omin = ssb.si + ss;
-                            omax = ssb.sa + ss;
-                            break;
-                    }
+                    vmin = subs[j].vmin[i];
+                    vmax = subs[j].vmax[i];
+                    omin = subs[j].omin[i];
+                    omax = subs[j].omax[i];
                     if (vmax < cmin - lmargin || vmin > cmax + lmargin || omax < otmin - lmargin || omin > otmax + lmargin)
                         continue;
 
@@ -573,6 +549,37 @@ bool ShiftCollider::mergeSlot(Segment *seg, Slot *slot, const SlotCollision *csl
 }   // end of ShiftCollider::mergeSlot
 
 
+// The span of absolute x that a neighbour's bounding box must overlap to make
+// mergeSlot touch any of the ranges, unless the neighbour imposes a sequence
+// order or carries an exclusion glyph.  For each direction this bounds the
+// neighbour's extent by the limits the target can move within, or for the y
+// direction by where the target is now, and it is widened a little so that a
+// neighbour mergeSlot would only just reach is never left out.
+void ShiftCollider::reach(Segment *seg, float &xmin, float &xmax) const
+{
+    const GlyphCache &gc = seg->getFace()->glyphs();
+    const BBox &tbb = gc.getBoundingBBox(_target->gid());
+    const SlantBox &tsb = gc.getBoundingSlantBox(_target->gid());
+    const float tx = _currOffset.x + _currShift.x;
+    const float ty = _currOffset.y + _currShift.y;
+    const float td = tx - ty;
+    const float ts = tx + ty;
+    const float dmargin = _margin / ISQRT2;
+
+    const float smin = _limit.bl.x + _limit.bl.y + _currOffset.x + _currOffset.y;
+    const float smax = _limit.tr.x + _limit.tr.y - tsb.si + tsb.sa + _currOffset.x + _currOffset.y;
+    const float dmin = _limit.bl.x - _limit.tr.y + _currOffset.x - _currOffset.y;
+    const float dmax = _limit.tr.x - _limit.bl.y - tsb.di + tsb.da + _currOffset.x - _currOffset.y;
+    float lo = min(min(_limit.bl.x + _currOffset.x - _margin, tx - _margin),
+                   0.5f * min(smin - dmargin + td, dmin - dmargin + ts)) + tbb.xi;
+    float hi = max(max(_limit.tr.x - tbb.xi + tbb.xa + _currOffset.x + _margin, tx + _margin),
+                   0.5f * max(smax + dmargin + td, dmax + dmargin + ts)) + tbb.xa;
+    const float slack = (std::fabs(lo) + std::fabs(hi) + std::fabs(_origin.x)) * 1e-4f;
+    xmin = _origin.x + lo - slack;
+    xmax = _origin.x + hi + slack;
+}
+
+
 // Figure out where to move the target glyph to, and return the amount to shift by.
 Position ShiftCollider::resolve(GR_MAYBE_UNUSED Segment *seg, bool &isCol, GR_MAYBE_UNUSED json * const dbgout)
 {
@@ -665,10 +672,13 @@ void ShiftCollider::outputJsonDbg(json * const dbgout, Segment *seg, int axis)
     for (int iAxis = axis; iAxis <= axisMax; ++iAxis)
     {
         *dbgout << json::flat << json::array << _ranges[iAxis].position();
-        for (Zones::const_iterator s = _ranges[iAxis].begin(), e = _ranges[iAxis].end(); s != e; ++s)
+        for (size_t k = 0; k != _ranges[iAxis].size(); ++k)
+        {
+            const Zones::value_type s = _ranges[iAxis][k];
             *dbgout << json::flat << json::array
-                        << Position(s->x, s->xm) << s->sm << s->smx << s->c
+                        << Position(s.x, s.xm) << s.sm << s.smx << s.c
                     << json::close;
+        }
         *dbgout << json::close;
     }
     if (axis < axisMax) // looped through the _ranges array for all axes
@@ -739,84 +749,192 @@ void ShiftCollider::outputJsonDbgRemovals(json * const dbgout, int axis, Segment
 #endif // !defined GRAPHITE2_NTRACING
 
 
-////    KERN-COLLIDER    ////
+////    COLLISION-INDEX    ////
+
+struct CollisionIndex::by_xmin
+{
+    const Vector<entry> & entries;
+    bool operator () (uint32 a, uint32 b) const { return entries[a].xmin < entries[b].xmin; }
+};
+
+void CollisionIndex::build(Segment *seg, Slot *start)
+{
+    for (Vector<entry>::const_iterator e = _entries.begin(); e != _entries.end(); ++e)
+        if (e->slot->index() < _where.size())
+            _where[e->slot->index()] = NOT_HERE;
+    _entries.clear();
+    _always.clear();
+    _width = 0;
+
+    for (Slot *s = start; s; s = s->next())
+    {
+        const entry e = { 0, 0, s };
+        _entries.push_back(e);
+        if (s != start && (seg->collisionInfo(s)->flags() & SlotCollision::COLL_END))
+            break;
+    }
+    // Short ranges are quicker to walk than to index.
+    _usable = _entries.size() >= MIN_INDEXED;
+    if (!_usable)   return;
+
+    const GlyphCache &gc = seg->getFace()->glyphs();
+    _rank.clear();
+    for (uint32 i = 0; i != _entries.size(); ++i)
+    {
+        const Slot * const s = _entries[i].slot;
+        if (s->index() >= _where.size())
+            _where.resize(max(size_t(s->index()) + 1, seg->slotCount()), NOT_HERE);
+        else if (_where[s->index()] != NOT_HERE)
+            _usable = false;    // two slots share a collision record
+        _where[s->index()] = i;
+        place(seg, i);
+        if (seg->collisionInfo(s)->exclGlyph() > 0 || !gc.check(s->gid()))
+            _always.push_back(i);
+    }
+
+    // A backward walk from the end stops at the slot before it that starts a
+    // range, and runs on out of this one if there is none and it isn't first.
+    _revFirst = NOT_HERE;
+    for (uint32 i = uint32(_entries.size()) - 1; i-- != 0; )
+        if (seg->collisionInfo(_entries[i].slot)->flags() & SlotCollision::COLL_START)
+        {
+            _revFirst = i;
+            break;
+        }
+    if (_revFirst == NOT_HERE && !start->prev())
+        _revFirst = 0;
+
+    _byX.resize(_entries.size());
+    _rank.resize(_entries.size());
+    for (uint32 i = 0; i != _byX.size(); ++i)
+        _byX[i] = i;
+    const by_xmin order = { _entries };
+    std::sort(_byX.begin(), _byX.end(), order);
+    for (uint32 r = 0; r != _byX.size(); ++r)
+        _rank[_byX[r]] = r;
+}
+
+// Reads where the slot's bounding box is now.  Once the index is ordered this
+// moves the entry along to keep it so, which is a step or two for a shift.
+void CollisionIndex::place(Segment *seg, uint32 i)
+{
+    entry &e = _entries[i];
+    const GlyphCache &gc = seg->getFace()->glyphs();
+    const float x = e.slot->origin().x + seg->collisionInfo(e.slot)->shift().x;
+    if (gc.check(e.slot->gid()))
+    {
+        const BBox &bb = gc.getBoundingBBox(e.slot->gid());
+        e.xmin = x + bb.xi;
+        e.xmax = x + bb.xa;
+    }
+    else
+        e.xmin = e.xmax = x;
+    _width = max(_width, e.xmax - e.xmin);
+
+    if (_rank.size() != _entries.size())    return;
+    uint32 r = _rank[i];
+    for (; r > 0 && _entries[_byX[r-1]].xmin > e.xmin; --r)
+    {
+        _byX[r] = _byX[r-1];
+        _rank[_byX[r]] = r;
+    }
+    for (; r + 1 < _byX.size() && _entries[_byX[r+1]].xmin < e.xmin; ++r)
+    {
+        _byX[r] = _byX[r+1];
+        _rank[_byX[r]] = r;
+    }
+    _byX[r] = i;
+    _rank[i] = r;
+}
 
-inline
-static float localmax (float al, float au, float bl, float bu, float x)
+void CollisionIndex::moved(Segment *seg, const Slot *slot)
 {
-    if (al < bl)
-    { if (au < bu) return au < x ? au : x; }
-    else if (au > bu) return bl < x ? bl : x;
-    return x;
+    if (!_usable)   return;
+    if (slot->index() < _where.size() && _where[slot->index()] != NOT_HERE
+            && _entries[_where[slot->index()]].slot == slot)
+        place(seg, _where[slot->index()]);
+    for (const Slot *c = slot->firstChild(); c; c = c->nextSibling())
+        moved(seg, c);
 }
 
-inline
-static float localmin(float al, float au, float bl, float bu, float x)
+void CollisionIndex::found(const Slot *s)
 {
-    if (bl > al)
-    { if (bu > au) return bl > x ? bl : x; }
-    else if (au > bu) return al > x ? al : x;
-    return x;
+    if (s->index() < _where.size() && _where[s->index()] != NOT_HERE && _entries[_where[s->index()]].slot == s)
+        _found.push_back(_where[s->index()]);
 }
 
-// Return the given edge of the glyph at height y, taking any slant box into account.
-static float get_edge(Segment *seg, const Slot *s, const Position &shift, float y, float width, float margin, bool isRight)
+void CollisionIndex::foundCluster(const Slot *s)
+{
+    found(s);
+    for (const Slot *c = s->firstChild(); c; c = c->nextSibling())
+        foundCluster(c);
+}
+
+const Vector<Slot *> *CollisionIndex::neighbours(Segment *seg, const ShiftCollider &coll, Slot *start,
+        Slot *slotFix, Slot *base, bool isRev)
+{
+    if (!_usable || start != (isRev ? _entries.back().slot : _entries.front().slot)
+        || (isRev && _revFirst == NOT_HERE))
+        return 0;
+    float xmin, xmax;
+    coll.reach(seg, xmin, xmax);
+    if (!(xmin <= xmax))
+        return 0;
+
+    // Anything starting more than the widest entry before xmin ends before it.
+    _found.clear();
+    const float from = xmin - _width;
+    uint32 lo = 0, hi = uint32(_byX.size());
+    while (lo < hi)
+    {
+        const uint32 mid = (lo + hi) >> 1;
+        if (_entries[_byX[mid]].xmin < from)    lo = mid + 1;
+        else                                    hi = mid;
+    }
+    for (; lo != _byX.size() && _entries[_byX[lo]].xmin <= xmax; ++lo)
+        if (_entries[_byX[lo]].xmax >= xmin)
+            _found.push_back(_byX[lo]);
+    _found.insert(_found.end(), _always.begin(), _always.end());
+    if (coll.hasSeqClass())
+        foundCluster(base);
+    // The target is walked too, since resolveCollisions notes which side of it each neighbour is.
+    found(slotFix);
+
+    std::sort(_found.begin(), _found.end());
+    _walk.clear();
+    const uint32 first = isRev ? _revFirst : 0;
+    uint32 last = NOT_HERE;
+    for (Vector<uint32>::const_iterator f = _found.begin(); f != _found.end(); ++f)
+        if (*f != last && *f >= first)
+            _walk.push_back(_entries[last = *f].slot);
+    if (isRev)
+        std::reverse(_walk.begin(), _walk.end());
+    return &_walk;
+}
+
+
+////    KERN-COLLIDER    ////
+
+// Set edges[0..n) to the given edge of the glyph in slices first.., taking any slant box into account.
+static void get_edges(Segment *seg, const Slot *s, const Position &shift, const SliceRun &run,
+        int first, int n, slice_edges_fn slices, Vector<float> &edges)
 {
     const GlyphCache &gc = seg->getFace()->glyphs();
     unsigned short gid = s->gid();
     float sx = s->origin().x + shift.x;
     float sy = s->origin().y + shift.y;
     uint8 numsub = gc.numSubBounds(gid);
-    float res = isRight ? (float)-1e38 : (float)1e38;
+    edges.assign(n, run.right ? (float)-1e38 : (float)1e38);
 
     if (numsub > 0)
     {
         for (int i = 0; i < numsub; ++i)
-        {
-            const BBox &sbb = gc.getSubBoundingBBox(gid, i);
-            const SlantBox &ssb = gc.getSubBoundingSlantBox(gid, i);
-            if (sy + sbb.yi - margin > y + width / 2 || sy + sbb.ya + margin < y - width / 2)
-                continue;
-            if (isRight)
-            {
-                float x = sx + sbb.xa + margin;
-                if (x > res)
-                {
-                    float td = sx - sy + ssb.da + margin + y;
-                    float ts = sx + sy + ssb.sa + margin - y;
-                    x = localmax(td - width / 2, td + width / 2,  ts - width / 2, ts + width / 2, x);
-                    if (x > res)
-                        res = x;
-                }
-            }
-            else
-            {
-                float x = sx + sbb.xi - margin;
-                if (x < res)
-                {
-                    float td = sx - sy + ssb.di - margin + y;
-                    float ts = sx + sy + ssb.si - margin - y;
-                    x = localmin(td - width / 2, td + width / 2, ts - width / 2, ts + width / 2, x);
-                    if (x < res)
-                        res = x;
-                }
-            }
-        }
+            slices(run, first, n, gc.getSubBoundingBBox(gid, i), gc.getSubBoundingSlantBox(gid, i),
+                   true, sx, sy, edges.begin());
     }
     else
-    {
-        const BBox &bb = gc.getBoundingBBox(gid);
-        const SlantBox &sb = gc.getBoundingSlantBox(gid);
-        if (sy + bb.yi - margin > y + width / 2 || sy + bb.ya + margin < y - width / 2)
-            return res;
-        float td = sx - sy + y;
-        float ts = sx + sy - y;
-        if (isRight)
-            res = localmax(td + sb.da - width / 2, td + sb.da + width / 2, ts + sb.sa - width / 2, ts + sb.sa + width / 2, sx + bb.xa) + margin;
-        else
-            res = localmin(td + sb.di - width / 2, td + sb.di + width / 2, ts + sb.si - width / 2, ts + sb.si + width / 2, sx + bb.xi) - margin;
-    }
-    return res;
+        slices(run, first, n, gc.getBoundingBBox(gid), gc.getBoundingSlantBox(gid),
+               false, sx, sy, edges.begin());
 }
 
 
@@ -901,13 +1019,15 @@ bool KernCollider::initSlot(Segment *seg, Slot *aSlot, const Rect &limit, float
         float toffset = c->shift().y - _miny + 1 + s->origin().y;
         int smin = max(0, int((bs.yi + toffset) / _sliceWidth));
         int smax = min(numSlices - 1, int((bs.ya + toffset) / _sliceWidth + 1));
+        if (smin > smax)
+            continue;
+        const SliceRun run = { _miny - 1, _sliceWidth, margin, !(dir & 1) };
+        get_edges(seg, s, c->shift(), run, smin, smax - smin + 1, _sliceEdges, _slices);
         for (int i = smin; i <= smax; ++i)
         {
-            float t;
-            float y = _miny - 1 + (i + .5f) * _sliceWidth; // vertical center of slice
+            float t = _slices[i - smin];
             if ((dir & 1) && x < _edges[i])
             {
-                t = get_edge(seg, s, c->shift(), y, _sliceWidth, margin, false);
                 if (t < _edges[i])
                 {
                     _edges[i] = t;
@@ -917,7 +1037,6 @@ bool KernCollider::initSlot(Segment *seg, Slot *aSlot, const Rect &limit, float
             }
             else if (!(dir & 1) && x > _edges[i])
             {
-                t = get_edge(seg, s, c->shift(), y, _sliceWidth, margin, true);
                 if (t > _edges[i])
                 {
                     _edges[i] = t;
@@ -959,6 +1078,8 @@ bool KernCollider::mergeSlot(Segment *seg, Slot *slot, const Position &currShift
         return false;
     bool collides = false;
     bool nooverlap = true;
+    const SliceRun run = { _miny - 1, _sliceWidth, 0.f, rtl > 0 };
+    get_edges(seg, slot, currShift, run, smin, smax - smin + 1, _sliceEdges, _slices);
 
     for (int i = smin; i <= smax; ++i)
     {
@@ -967,9 +1088,8 @@ bool KernCollider::mergeSlot(Segment *seg, Slot *slot, const Position &currShift
             continue;
         if (!_hit || x > here - _mingap - currSpace)
         {
-            float y = (float)(_miny - 1 + (i + .5f) * _sliceWidth);  // vertical center of slice
             // 2 * currSpace to account for the space that is already separating them and the space we want to add
-            float m = get_edge(seg, slot, currShift, y, _sliceWidth, 0., rtl > 0) * rtl + 2 * currSpace;
+            float m = _slices[i - smin] * rtl + 2 * currSpace;
             if (m < (float)-8e37)       // only true if the glyph has a gap in it
                 continue;
             nooverlap = false;
@@ -32,11 +32,14 @@ of the License or (at your option) any later version.
 #include "inc/Endian.h"
 #include "inc/Face.h"
 #include "inc/FileFace.h"
+#include "inc/MemoryFace.h"
 #include "inc/GlyphFace.h"
 #include "inc/json.h"
 #include "inc/Segment.h"
 #include "inc/NameTable.h"
+#include "inc/SegCache.h"
 #include "inc/Error.h"
+#include "inc/Snapshot.h"
 
 using namespace graphite2;
 
@@ -53,9 +56,12 @@ enum compression
 Face::Face(const void* appFaceHandle/*non-NULL*/, const gr_face_ops & ops)
 : m_appFaceHandle(appFaceHandle),
   m_pFileFace(NULL),
+  m_pMemoryFace(NULL),
   m_pGlyphFaceCache(NULL),
   m_cmap(NULL),
   m_pNames(NULL),
+  m_segCache(NULL),
+  m_silfTable(NULL),
   m_logger(NULL),
   m_error(0), m_errcntxt(0),
   m_silfs(NULL),
@@ -71,12 +77,15 @@ Face::Face(const void* appFaceHandle/*non-NULL*/, const gr_face_ops & ops)
 Face::~Face()
 {
     setLogger(0);
+    delete m_segCache;
     delete m_pGlyphFaceCache;
     delete m_cmap;
     delete[] m_silfs;
+    delete m_silfTable;
 #ifndef GRAPHITE2_NFILEFACE
     delete m_pFileFace;
 #endif
+    delete m_pMemoryFace;
     delete m_pNames;
 }
 
@@ -116,7 +125,7 @@ bool Face::readGlyphs(uint32 faceOptions)
     return true;
 }
 
-bool Face::readGraphite(const Table & silf)
+bool Face::readGraphite(const Table & silf, uint32 faceOptions)
 {
 #ifdef GRAPHITE2_TELEMETRY
     telemetry::category _silf_cat(tele.silf);
@@ -145,16 +154,100 @@ bool Face::readGraphite(const Table & silf)
         if (e.test(next > silf.size() || offset >= next, E_BADSIZE))
             return error(e);
 
-        if (!m_silfs[i].readGraphite(silf + offset, next - offset, *this, version))
+        if (!m_silfs[i].readGraphite(silf + offset, next - offset, *this, version, faceOptions))
             return false;
 
         if (m_silfs[i].numPasses())
             havePasses = true;
     }
 
+    // Lazily decoded passes point into the table, so hang on to it.
+    if (havePasses && (faceOptions & gr_face_lazyPasses))
+    {
+        m_silfTable = new Table(std::move(silf));
+        if (e.test(!m_silfTable, E_OUTOFMEM)) return error(e);
+    }
+
     return havePasses;
 }
 
+// A snapshot is only good for the exact Silf table it was decoded from and
+// the glyph and feature counts its code was checked against.
+void Face::snapshotKey(const Table & silf, SnapshotHeader & key) const
+{
+    memset(&key, 0, sizeof key);
+    key.magic         = SNAPSHOT_MAGIC;
+    key.version       = SNAPSHOT_VERSION;
+    key.byte_order    = 0x01020304;
+    const Table head(*this, Tag::head);
+    key.head_checksum = snapshotChecksum(head, head.size());
+    key.silf_checksum = snapshotChecksum(silf, silf.size());
+    key.silf_size     = uint32(silf.size());
+    key.num_glyphs    = glyphs().numGlyphs();
+    key.num_attrs     = glyphs().numAttrs();
+    key.num_features  = numFeatures();
+    key.num_opcodes   = vm::NUM_OPCODES;
+}
+
+size_t Face::writeSnapshot(void * buf, size_t len) const
+{
+    const Table silf(*this, Tag::Silf, 0x00050000);
+    if (!silf || !m_silfs)  return 0;
+
+    // Size the image first so nothing is written into a buffer too small for it.
+    SnapshotWriter sizer(0, 0);
+    if (!writeSilfImages(sizer))    return 0;
+    const size_t body_size = sizer.size();
+    if (!buf || len < sizeof(SnapshotHeader) + body_size)
+        return sizeof(SnapshotHeader) + body_size;
+
+    SnapshotHeader h;
+    snapshotKey(silf, h);
+    byte * const body = static_cast<byte *>(buf) + sizeof h;
+    SnapshotWriter w(body, body_size);
+    if (!writeSilfImages(w) || !w.complete()) return 0;
+    h.body_size     = uint32(body_size);
+    h.body_checksum = snapshotChecksum(body, body_size);
+    memcpy(buf, &h, sizeof h);
+    return sizeof h + body_size;
+}
+
+bool Face::writeSilfImages(SnapshotWriter & w) const
+{
+    w.write(m_numSilf);
+    for (int i = 0; i < m_numSilf; i++)
+        if (!m_silfs[i].writeImage(w))  return false;
+    return true;
+}
+
+bool Face::readSnapshot(const Table & silf, const void * image, size_t len, uint32 faceOptions)
+{
+    Error e;
+    error_context(EC_READSNAPSHOT);
+    SnapshotHeader h, key;
+    if (e.test(!image || len < sizeof h, E_BADSNAPSHOT)) return error(e);
+    memcpy(&h, image, sizeof h);
+    snapshotKey(silf, key);
+    key.body_size     = h.body_size;
+    key.body_checksum = h.body_checksum;
+    if (e.test(memcmp(&h, &key, sizeof h) != 0, E_SNAPSHOTMISMATCH)) return error(e);
+
+    const byte * const body = static_cast<const byte *>(image) + sizeof h;
+    if (e.test(h.body_size > len - sizeof h
+            || snapshotChecksum(body, h.body_size) != h.body_checksum, E_BADSNAPSHOT))
+        return error(e);
+
+    SnapshotReader r(body, h.body_size);
+    m_numSilf = r.read<uint16>();
+    m_silfs = new Silf[m_numSilf];
+    if (e.test(!m_silfs, E_OUTOFMEM)) return error(e);
+    for (int i = 0; i < m_numSilf; i++)
+        if (e.test(!m_silfs[i].readImage(r, *this, faceOptions), E_BADSNAPSHOT)) return error(e);
+
+    if (e.test(!r.atEnd(), E_BADSNAPSHOT)) return error(e);
+    return true;
+}
+
 bool Face::readFeatures()
 {
     return m_Sill.readFace(*this);
@@ -162,9 +255,20 @@ bool Face::readFeatures()
 
 bool Face::runGraphite(Segment *seg, const Silf *aSilf) const
 {
+    // Whether the segment is traced is settled here, the untraced passes
+    // are built without any logging in them.
 #if !defined GRAPHITE2_NTRACING
-    json * dbgout = logger();
-    if (dbgout)
+    if (logger())   return runPasses<true>(seg, aSilf);
+#endif
+    return runPasses<false>(seg, aSilf);
+}
+
+template <bool traced>
+bool Face::runPasses(Segment *seg, const Silf *aSilf) const
+{
+#if !defined GRAPHITE2_NTRACING
+    json * const dbgout = logger();
+    if (traced && dbgout)
     {
         *dbgout << json::object
                     << "id"         << objectid(seg)
@@ -176,18 +280,21 @@ bool Face::runGraphite(Segment *seg, const Silf *aSilf) const
 //        seg->reverseSlots();
     if ((seg->dir() & 3) == 3 && aSilf->bidiPass() == 0xFF)
         seg->doMirror(aSilf->aMirror());
-    bool res = aSilf->runGraphite(seg, 0, aSilf->positionPass(), true);
+    // Text no rule can touch, commonly plain Latin, needs nothing more than
+    // its cmap glyphs positioned by their advances.
+    const bool bypass = !traced && aSilf->bypasses(*seg);
+    bool res = bypass || aSilf->runGraphite<traced>(seg, 0, aSilf->positionPass(), true);
     if (res)
     {
         seg->associateChars(0, seg->charInfoCount());
         if (aSilf->flags() & 0x20)
             res &= seg->initCollisions();
-        if (res)
-            res &= aSilf->runGraphite(seg, aSilf->positionPass(), aSilf->numPasses(), false);
+        if (res && !bypass)
+            res &= aSilf->runGraphite<traced>(seg, aSilf->positionPass(), aSilf->numPasses(), false);
     }
 
 #if !defined GRAPHITE2_NTRACING
-    if (dbgout)
+    if (traced && dbgout)
 {
         seg->positionSlots(0, 0, 0, seg->currdir());
         *dbgout             << json::item
@@ -255,20 +362,44 @@ void Face::takeFileFace(FileFace* pFileFace GR_MAYBE_UNUSED/*takes ownership*/)
 #endif
 }
 
+void Face::takeMemoryFace(MemoryFace* pMemoryFace/*takes ownership*/)
+{
+    if (m_pMemoryFace==pMemoryFace)
+      return;
+
+    delete m_pMemoryFace;
+    m_pMemoryFace = pMemoryFace;
+}
+
+bool Face::setupSegCache(size_t maxSegments)
+{
+    delete m_segCache;
+    m_segCache = maxSegments ? new SegCache(*this, maxSegments) : NULL;
+    return m_segCache || !maxSegments;
+}
+
 NameTable * Face::nameTable() const
 {
-    if (m_pNames) return m_pNames;
+    NameTable * names = atomic_acquire(m_pNames);
+    if (names) return names;
     const Table name(*this, Tag::name);
     if (name)
-        m_pNames = new NameTable(name, name.size());
-    return m_pNames;
+    {
+        names = new NameTable(name, name.size());
+        if (names && atomic_publish(m_pNames, names) != names)
+        {
+            delete names;
+            names = atomic_acquire(m_pNames);
+        }
+    }
+    return names;
 }
 
 uint16 Face::languageForLocale(const char * locale) const
 {
-    nameTable();
-    if (m_pNames)
-        return m_pNames->getLanguageId(locale);
+    NameTable * names = nameTable();
+    if (names)
+        return names->getLanguageId(locale);
     return 0;
 }
 
@@ -30,14 +30,26 @@ of the License or (at your option) any later version.
 
 #ifndef GRAPHITE2_NFILEFACE
 
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace graphite2;
 
 FileFace::FileFace(const char *filename)
-: _file(fopen(filename, "rb")),
+: _file(NULL),
   _file_len(0),
   _header_tbl(NULL),
-  _table_dir(NULL)
+  _table_dir(NULL),
+  _map(NULL),
+  _mapped(NULL, 0)
 {
+    if (map(filename)) return;
+
+    _file = fopen(filename, "rb");
     if (!_file) return;
 
     if (fseek(_file, 0, SEEK_END)) return;
@@ -68,8 +80,35 @@ FileFace::FileFace(const char *filename)
     return;
 }
 
+// Tables are then handed out as pointers into the mapping, with no copying.
+bool FileFace::map(const char *filename GR_MAYBE_UNUSED)
+{
+#ifdef HAVE_MMAP
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void * const p = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            _map = p;
+            _file_len = size_t(st.st_size);
+            _mapped = MemoryFace(_map, _file_len);
+        }
+    }
+    close(fd);
+#endif
+    return _map != NULL;
+}
+
 FileFace::~FileFace()
 {
+#ifdef HAVE_MMAP
+    if (_map)
+        munmap(_map, _file_len);
+#endif
     free(_table_dir);
     free(_header_tbl);
     if (_file)
@@ -81,6 +120,8 @@ const void *FileFace::get_table_fn(const void* appFaceHandle, unsigned int name,
 {
     if (appFaceHandle == 0)     return 0;
     const FileFace & file_face = *static_cast<const FileFace *>(appFaceHandle);
+    if (file_face._map)
+        return file_face._mapped.table(name, len);
 
     void *tbl;
     size_t tbl_offset, tbl_len;
@@ -105,6 +146,7 @@ const void *FileFace::get_table_fn(const void* appFaceHandle, unsigned int name,
 void FileFace::rel_table_fn(const void* appFaceHandle, const void *table_buffer)
 {
     if (appFaceHandle == 0)     return;
+    if (static_cast<const FileFace *>(appFaceHandle)->_map)   return;
 
     free(const_cast<void *>(table_buffer));
 }
@@ -24,6 +24,7 @@ Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
 License, as published by the Free Software Foundation, either version 2
 of the License or (at your option) any later version.
 */
+#include <cstring>
 #include "graphite2/Font.h"
 
 #include "inc/Main.h"
@@ -32,6 +33,7 @@ of the License or (at your option) any later version.
 #include "inc/GlyphFace.h"
 #include "inc/Endian.h"
 #include "inc/bits.h"
+#include "inc/Parallel.h"
 
 using namespace graphite2;
 
@@ -126,40 +128,52 @@ GlyphCache::GlyphCache(const Face & face, const uint32 face_options)
 {
     if ((face_options & gr_face_preloadGlyphs) && _glyph_loader && _glyphs)
     {
-        int numsubs = 0;
         GlyphFace * const glyphs = new GlyphFace [_num_glyphs];
         if (!glyphs)
             return;
 
-        // The 0 glyph is definately required.
-        _glyphs[0] = _glyph_loader->read_glyph(0, glyphs[0], &numsubs);
-
-        // glyphs[0] has the same address as the glyphs array just allocated,
-        //  thus assigning the &glyphs[0] to _glyphs[0] means _glyphs[0] points
-        //  to the entire array.
-        const GlyphFace * loaded = _glyphs[0];
-        for (uint16 gid = 1; loaded && gid != _num_glyphs; ++gid)
-            _glyphs[gid] = loaded = _glyph_loader->read_glyph(gid, glyphs[gid], &numsubs);
-
-        if (!loaded)
+        if ((face_options & gr_face_parallelLoad) && _num_glyphs > PRELOAD_CHUNK)
         {
-            _glyphs[0] = 0;
-            delete [] glyphs;
+            if (!preloadParallel(glyphs))
+            {
+                _glyphs[0] = 0;
+                delete [] glyphs;
+            }
         }
-        else if (numsubs > 0 && _boxes)
+        else
         {
-            GlyphBox * boxes = (GlyphBox *)gralloc<char>(_num_glyphs * sizeof(GlyphBox) + numsubs * 8 * sizeof(float));
-            GlyphBox * currbox = boxes;
+            int numsubs = 0;
+
+            // The 0 glyph is definately required.
+            _glyphs[0] = _glyph_loader->read_glyph(0, glyphs[0], &numsubs);
 
-            for (uint16 gid = 0; currbox && gid != _num_glyphs; ++gid)
+            // glyphs[0] has the same address as the glyphs array just allocated,
+            //  thus assigning the &glyphs[0] to _glyphs[0] means _glyphs[0] points
+            //  to the entire array.
+            const GlyphFace * loaded = _glyphs[0];
+            for (uint16 gid = 1; loaded && gid != _num_glyphs; ++gid)
+                _glyphs[gid] = loaded = _glyph_loader->read_glyph(gid, glyphs[gid], &numsubs);
+
+            if (!loaded)
             {
-                _boxes[gid] = currbox;
-                currbox = _glyph_loader->read_box(gid, currbox, *_glyphs[gid]);
+                _glyphs[0] = 0;
+                delete [] glyphs;
             }
-            if (!currbox)
+            else if (numsubs > 0 && _boxes)
             {
-                free(boxes);
-                _boxes[0] = 0;
+                GlyphBox * boxes = (GlyphBox *)gralloc<char>(_num_glyphs * sizeof(GlyphBox) + numsubs * 8 * sizeof(float));
+                GlyphBox * currbox = boxes;
+
+                for (uint16 gid = 0; currbox && gid != _num_glyphs; ++gid)
+                {
+                    _boxes[gid] = currbox;
+                    currbox = _glyph_loader->read_box(gid, currbox, *_glyphs[gid]);
+                }
+                if (!currbox)
+                {
+                    free(boxes);
+                    _boxes[0] = 0;
+                }
             }
         }
         delete _glyph_loader;
@@ -184,6 +198,87 @@ GlyphCache::GlyphCache(const Face & face, const uint32 face_options)
 }
 
 
+struct GlyphCache::Preload
+{
+    GlyphCache    * cache;
+    GlyphFace     * glyphs;
+    GlyphBox      * boxes;
+    int           * numsubs;    // per chunk, then the running total before it
+    bool          * loaded;     // per chunk
+};
+
+void GlyphCache::preloadGlyphsJob(void * data, unsigned int chunk)
+{
+    Preload & p = *static_cast<Preload *>(data);
+    GlyphCache & c = *p.cache;
+    const unsigned int end = min(unsigned(c._num_glyphs), (chunk + 1) * PRELOAD_CHUNK);
+    int numsubs = 0;
+    bool loaded = true;
+    for (unsigned int gid = chunk * PRELOAD_CHUNK; loaded && gid != end; ++gid)
+        loaded = (c._glyphs[gid] = c._glyph_loader->read_glyph(uint16(gid), p.glyphs[gid], &numsubs)) != 0;
+    p.numsubs[chunk] = numsubs;
+    p.loaded[chunk] = loaded;
+}
+
+void GlyphCache::preloadBoxesJob(void * data, unsigned int chunk)
+{
+    Preload & p = *static_cast<Preload *>(data);
+    GlyphCache & c = *p.cache;
+    const unsigned int begin = chunk * PRELOAD_CHUNK,
+                       end = min(unsigned(c._num_glyphs), begin + PRELOAD_CHUNK);
+    GlyphBox * currbox = reinterpret_cast<GlyphBox *>(reinterpret_cast<char *>(p.boxes)
+                            + begin * sizeof(GlyphBox) + p.numsubs[chunk] * 8 * sizeof(float));
+    for (unsigned int gid = begin; currbox && gid != end; ++gid)
+    {
+        c._boxes[gid] = currbox;
+        currbox = c._glyph_loader->read_box(uint16(gid), currbox, *c._glyphs[gid]);
+    }
+    p.loaded[chunk] = currbox != 0;
+}
+
+// Reads glyphs and then their boxes a chunk at a time on a few threads. Each
+// chunk's boxes start where a serial load would have put them, so the result
+// is laid out the same.
+bool GlyphCache::preloadParallel(GlyphFace * glyphs)
+{
+    const unsigned int nchunks = (_num_glyphs + PRELOAD_CHUNK - 1) / PRELOAD_CHUNK;
+    Preload p = { this, glyphs, 0, gralloc<int>(nchunks), gralloc<bool>(nchunks) };
+    bool loaded = p.numsubs && p.loaded;
+    if (loaded)
+    {
+        parallel_for(nchunks, &preloadGlyphsJob, &p);
+        int numsubs = 0;
+        for (unsigned int i = 0; i != nchunks; ++i)
+        {
+            loaded &= p.loaded[i];
+            const int n = p.numsubs[i];
+            p.numsubs[i] = numsubs;
+            numsubs += n;
+        }
+
+        if (loaded && numsubs > 0 && _boxes)
+        {
+            p.boxes = (GlyphBox *)gralloc<char>(_num_glyphs * sizeof(GlyphBox) + numsubs * 8 * sizeof(float));
+            bool boxed = p.boxes != 0;
+            if (boxed)
+            {
+                parallel_for(nchunks, &preloadBoxesJob, &p);
+                for (unsigned int i = 0; i != nchunks; ++i)
+                    boxed &= p.loaded[i];
+            }
+            if (!boxed)
+            {
+                free(p.boxes);
+                memset(_boxes, 0, _num_glyphs * sizeof(GlyphBox *));
+            }
+        }
+    }
+    free(p.numsubs);
+    free(p.loaded);
+    return loaded;
+}
+
+
 GlyphCache::~GlyphCache()
 {
     if (_glyphs)
@@ -213,11 +308,14 @@ GlyphCache::~GlyphCache()
     delete _glyph_loader;
 }
 
-const GlyphFace *GlyphCache::glyph(unsigned short glyphid) const      //result may be changed by subsequent call with a different glyphid
+// Several threads may race to load the same glyph. Each builds a private copy
+// and publishes it; the box goes in first so anyone who sees the glyph also
+// sees its box, and the losers free their copies.
+const GlyphFace *GlyphCache::glyph(unsigned short glyphid) const
 {
     if (glyphid >= numGlyphs())
         return _glyphs[0];
-    const GlyphFace * & p = _glyphs[glyphid];
+    const GlyphFace * p = atomic_acquire(_glyphs[glyphid]);
     if (p == 0 && _glyph_loader)
     {
         int numsubs = 0;
@@ -230,13 +328,18 @@ const GlyphFace *GlyphCache::glyph(unsigned short glyphid) const      //result m
         }
         if (_boxes)
         {
-            _boxes[glyphid] = (GlyphBox *)gralloc<char>(sizeof(GlyphBox) + 8 * numsubs * sizeof(float));
-            if (!_glyph_loader->read_box(glyphid, _boxes[glyphid], *_glyphs[glyphid]))
+            GlyphBox * b = (GlyphBox *)gralloc<char>(sizeof(GlyphBox) + 8 * numsubs * sizeof(float));
+            if (!b || !_glyph_loader->read_box(glyphid, b, *p))
             {
-                free(_boxes[glyphid]);
-                _boxes[glyphid] = 0;
+                free(b);
+                b = 0;
             }
+            if (b && atomic_publish(_boxes[glyphid], b) != b)
+                free(b);
         }
+        p = atomic_publish(_glyphs[glyphid], p);
+        if (p != g)
+            delete g;
     }
     return p;
 }
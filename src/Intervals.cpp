@@ -26,6 +26,8 @@ of the License or (at your option) any later version.
 */
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
 
 #include "inc/Intervals.h"
@@ -36,42 +38,50 @@ of the License or (at your option) any later version.
 
 using namespace graphite2;
 
-#include <cmath>
-
-inline
-Zones::Exclusion  Zones::Exclusion::split_at(float p) {
-    Exclusion r(*this);
-    r.xm = x = p;
-    return r;
-}
-
-inline
-void Zones::Exclusion::left_trim(float p) {
-    x = p;
-}
-
-inline
-Zones::Exclusion & Zones::Exclusion::operator += (Exclusion const & rhs) {
-    c += rhs.c; sm += rhs.sm; smx += rhs.smx; open = false;
-    return *this;
-}
+namespace
+{
 
 inline
-uint8 Zones::Exclusion::outcode(float val) const {
+uint8 outcode(float x, float xm, float val) {
     float p = val;
     //float d = std::numeric_limits<float>::epsilon();
     float d = 0.;
     return ((p - xm >= d) << 1) | (x - p > d);
 }
 
-void Zones::exclude_with_margins(float xmin, float xmax, int axis) {
-    remove(xmin, xmax);
-    weightedAxis(axis, xmin-_margin_len, xmin, 0, 0, _margin_weight, xmin-_margin_len, 0, 0, false);
-    weightedAxis(axis, xmax, xmax+_margin_len, 0, 0, _margin_weight, xmax+_margin_len, 0, 0, false);
+inline
+float cost(float c, float sm, float smx, float p) {
+    return (sm * p - 2 * smx) * p + c;
 }
 
-namespace
-{
+// Where within x..xm an exclusion with these weights costs least.
+inline
+float test_position(float x, float xm, float c, float sm, float smx, float origin) {
+    if (sm < 0)
+    {
+        // sigh, test both ends and perhaps the middle too!
+        float res = x;
+        float cl = cost(c, sm, smx, x);
+        if (x < origin && xm > origin)
+        {
+            float co = cost(c, sm, smx, origin);
+            if (co < cl)
+            {
+                cl = co;
+                res = origin;
+            }
+        }
+        float cr = cost(c, sm, smx, xm);
+        return cl > cr ? xm : res;
+    }
+    else
+    {
+        float zerox = smx / sm + origin;
+        if (zerox < x) return x;
+        else if (zerox > xm) return xm;
+        else return zerox;
+    }
+}
 
 inline
 bool separated(float a, float b) {
@@ -85,6 +95,108 @@ bool separated(float a, float b) {
 
 }
 
+inline
+uint8 Zones::Exclusion::outcode(float val) const {
+    return ::outcode(x, xm, val);
+}
+
+Zones::value_type Zones::operator [] (size_t i) const
+{
+    assert(i < _size);
+    Exclusion e(col(X)[i], col(XM)[i], col(SM)[i], col(SMX)[i], col(C)[i]);
+    e.open = open()[i] != 0;
+    return e;
+}
+
+void Zones::reserve(size_t n)
+{
+    if (n <= _capacity) return;
+    size_t cap = _capacity ? _capacity : 8;
+    while (cap < n) cap <<= 1;
+    float * const cols = gralloc<float>(NUM_COLS * cap + (cap + sizeof(float) - 1) / sizeof(float));
+    if (!cols)  std::abort();
+    if (_size)
+    {
+        for (int k = 0; k != NUM_COLS; ++k)
+            memcpy(cols + k * cap, col(k), _size * sizeof(float));
+        memcpy(cols + NUM_COLS * cap, open(), _size);
+    }
+    free(_cols);
+    _cols = cols;
+    _capacity = cap;
+}
+
+// Opens a gap of n entries at i, leaving what was there before the columns
+// moved.  There are seldom more than a handful of entries after i, too few
+// for a call to memmove to pay for itself on each column.
+void Zones::make_room(size_t i, size_t n)
+{
+    if (_size + n > _capacity)  reserve(_size + n);
+    uint8 * const opens = open();
+    for (size_t j = _size; j-- != i; )
+    {
+        for (int k = X; k <= SMX; ++k)
+            col(k)[j + n] = col(k)[j];
+        opens[j + n] = opens[j];
+    }
+    _size += n;
+}
+
+void Zones::erase(size_t i)
+{
+    uint8 * const opens = open();
+    for (size_t j = i + 1; j < _size; ++j)
+    {
+        for (int k = X; k <= SMX; ++k)
+            col(k)[j - 1] = col(k)[j];
+        opens[j - 1] = opens[j];
+    }
+    --_size;
+}
+
+// Splits entry i at each of the n increasing points in at, every part keeping
+// its weights, with the columns moved along only once.
+void Zones::split(size_t i, const float * at, size_t n)
+{
+    make_room(i, n);
+    for (size_t j = i; j != i + n; ++j)
+    {
+        for (int k = X; k <= SMX; ++k)
+            col(k)[j] = col(k)[i + n];
+        open()[j] = open()[i + n];
+    }
+    for (size_t j = 0; j != n; ++j)
+        col(XM)[i + j] = col(X)[i + j + 1] = at[j];
+}
+
+void Zones::set(size_t i, const Exclusion & e)
+{
+    col(X)[i] = e.x; col(XM)[i] = e.xm;
+    col(C)[i] = e.c; col(SM)[i] = e.sm; col(SMX)[i] = e.smx;
+    open()[i] = e.open;
+}
+
+inline
+void Zones::add(size_t i, const Exclusion & e)
+{
+    col(C)[i] += e.c; col(SM)[i] += e.sm; col(SMX)[i] += e.smx; open()[i] = false;
+}
+
+// The first exclusion that ends beyond x.  Those before it lie wholly to the
+// left of anything starting at x, which insert and remove would only step over.
+inline
+size_t Zones::first_reaching(float x) const
+{
+    const float * const xms = col(XM);
+    return std::upper_bound(xms, xms + _size, x) - xms;
+}
+
+void Zones::exclude_with_margins(float xmin, float xmax, int axis) {
+    remove(xmin, xmax);
+    weightedAxis(axis, xmin-_margin_len, xmin, 0, 0, _margin_weight, xmin-_margin_len, 0, 0, false);
+    weightedAxis(axis, xmax, xmax+_margin_len, 0, 0, _margin_weight, xmax+_margin_len, 0, 0, false);
+}
+
 void Zones::insert(Exclusion e)
 {
 #if !defined GRAPHITE2_NTRACING
@@ -94,10 +206,11 @@ void Zones::insert(Exclusion e)
     e.xm = min(e.xm, _posm);
     if (e.x >= e.xm) return;
 
-    for (iterator i = _exclusions.begin(), ie = _exclusions.end(); i != ie && e.x < e.xm; ++i)
+    for (size_t i = first_reaching(e.x); i != _size && e.x < e.xm; ++i)
     {
-        const uint8 oca = e.outcode(i->x),
-                    ocb = e.outcode(i->xm);
+        const float ix = col(X)[i], ixm = col(XM)[i];
+        const uint8 oca = e.outcode(ix),
+                    ocb = e.outcode(ixm);
         if ((oca & ocb) != 0) continue;
 
         switch (oca ^ ocb)  // What kind of overlap?
@@ -106,37 +219,37 @@ void Zones::insert(Exclusion e)
             // split e at i.x into e1,e2
             // split e2 at i.mx into e2,e3
             // drop e1 ,i+e2, e=e3
-            *i += e;
-            e.left_trim(i->xm);
+            add(i, e);
+            e.x = ixm;
             break;
         case 1:     // e overlaps on the rhs of i
             // split i at e->x into i1,i2
             // split e at i.mx into e1,e2
             // trim i1, insert i2+e1, e=e2
-            if (!separated(i->xm, e.x)) break;
-            if (separated(i->x,e.x))   { i = _exclusions.insert(i,i->split_at(e.x)); ++i; }
-            *i += e;
-            e.left_trim(i->xm);
+            if (!separated(ixm, e.x)) break;
+            if (separated(ix, e.x))     split(i++, &e.x, 1);
+            add(i, e);
+            e.x = ixm;
             break;
         case 2:     // e overlaps on the lhs of i
             // split e at i->x into e1,e2
             // split i at e.mx into i1,i2
             // drop e1, insert e2+i1, trim i2
-            if (!separated(e.xm, i->x)) return;
-            if (separated(e.xm, i->xm)) i = _exclusions.insert(i,i->split_at(e.xm));
-            *i += e;
+            if (!separated(e.xm, ix)) return;
+            if (separated(e.xm, ixm))   split(i, &e.xm, 1);
+            add(i, e);
             return;
         case 3:     // i completely covers e
             // split i at e.x into i1,i2
             // split i2 at e.mx into i2,i3
             // insert i1, insert e+i2
-            if (separated(e.xm, i->xm)) i = _exclusions.insert(i,i->split_at(e.xm));
-            i = _exclusions.insert(i, i->split_at(e.x));
-            *++i += e;
+        {
+            const float at[2] = { e.x, e.xm };
+            split(i, at, separated(e.xm, ixm) ? 2 : 1);
+            add(i + 1, e);
             return;
         }
-
-        ie = _exclusions.end();
+        }
     }
 }
 
@@ -150,54 +263,71 @@ void Zones::remove(float x, float xm)
     xm = min(xm, _posm);
     if (x >= xm) return;
 
-    for (iterator i = _exclusions.begin(), ie = _exclusions.end(); i != ie; ++i)
+    for (size_t i = first_reaching(x); i != _size; ++i)
     {
-        const uint8 oca = i->outcode(x),
-                    ocb = i->outcode(xm);
+        const uint8 oca = outcode(col(X)[i], col(XM)[i], x),
+                    ocb = outcode(col(X)[i], col(XM)[i], xm);
         if ((oca & ocb) != 0)   continue;
 
         switch (oca ^ ocb)  // What kind of overlap?
         {
         case 0:     // i completely covers e
-            if (separated(i->x, x))  { i = _exclusions.insert(i,i->split_at(x)); ++i; }
+            if (separated(col(X)[i], x))  split(i++, &x, 1);
             GR_FALLTHROUGH;
             // no break
         case 1:     // i overlaps on the rhs of e
-            i->left_trim(xm);
+            col(X)[i] = xm;
             return;
         case 2:     // i overlaps on the lhs of e
-            i->xm = x;
-            if (separated(i->x, i->xm)) break;
+            col(XM)[i] = x;
+            if (separated(col(X)[i], col(XM)[i])) break;
             GR_FALLTHROUGH;
             // no break
         case 3:     // e completely covers i
-            i = _exclusions.erase(i);
-            --i;
+            erase(i--);
             break;
         }
-
-        ie = _exclusions.end();
     }
 }
 
 
-Zones::const_iterator Zones::find_exclusion_under(float x) const
+size_t Zones::find_exclusion_under(float x) const
 {
-    size_t l = 0, h = _exclusions.size();
+    const float * const xs = col(X),
+                * const xms = col(XM);
+    size_t l = 0, h = _size;
 
     while (l < h)
     {
         size_t const p = (l+h) >> 1;
-        switch (_exclusions[p].outcode(x))
+        switch (outcode(xs[p], xms[p], x))
         {
-        case 0 : return _exclusions.begin()+p;
+        case 0 : return p;
         case 1 : h = p; break;
         case 2 :
         case 3 : l = p+1; break;
         }
     }
 
-    return _exclusions.begin()+l;
+    return l;
+}
+
+
+// Tries exclusion i as the best so far, true if the scan it is part of should
+// stop there.
+inline
+bool Zones::track_cost(size_t i, float & best_cost, float & best_pos, float origin) const
+{
+    const float c = col(C)[i], sm = col(SM)[i], smx = col(SMX)[i],
+                p = test_position(col(X)[i], col(XM)[i], c, sm, smx, origin),
+                localc = ::cost(c, sm, smx, p - origin);
+    if (open()[i] && localc > best_cost) return true;
+    if (localc < best_cost)
+    {
+        best_cost = localc;
+        best_pos = p;
+    }
+    return false;
 }
 
 
@@ -206,72 +336,23 @@ float Zones::closest(float origin, float & cost) const
     float best_c = std::numeric_limits<float>::max(),
           best_x = 0;
 
-    const const_iterator start = find_exclusion_under(origin);
+    const size_t start = find_exclusion_under(origin);
 
     // Forward scan looking for lowest cost
-    for (const_iterator i = start, ie = _exclusions.end(); i != ie; ++i)
-        if (i->track_cost(best_c, best_x, origin)) break;
+    for (size_t i = start; i < _size; ++i)
+        if (track_cost(i, best_c, best_x, origin)) break;
 
     // Backward scan looking for lowest cost
     //  We start from the exclusion to the immediate left of start since we've
     //  already tested start with the right most scan above.
-    for (const_iterator i = start-1, ie = _exclusions.begin()-1; i != ie; --i)
-        if (i->track_cost(best_c, best_x, origin)) break;
+    for (size_t i = start; i-- != 0; )
+        if (track_cost(i, best_c, best_x, origin)) break;
 
     cost = (best_c == std::numeric_limits<float>::max() ? -1 : best_c);
     return best_x;
 }
 
 
-// Cost and test position functions
-
-bool Zones::Exclusion::track_cost(float & best_cost, float & best_pos, float origin) const {
-    const float p = test_position(origin),
-                localc = cost(p - origin);
-    if (open && localc > best_cost) return true;
-
-    if (localc < best_cost)
-    {
-        best_cost = localc;
-        best_pos = p;
-    }
-    return false;
-}
-
-inline
-float Zones::Exclusion::cost(float p) const {
-    return (sm * p - 2 * smx) * p + c;
-}
-
-
-float Zones::Exclusion::test_position(float origin) const {
-    if (sm < 0)
-    {
-        // sigh, test both ends and perhaps the middle too!
-        float res = x;
-        float cl = cost(x);
-        if (x < origin && xm > origin)
-        {
-            float co = cost(origin);
-            if (co < cl)
-            {
-                cl = co;
-                res = origin;
-            }
-        }
-        float cr = cost(xm);
-        return cl > cr ? xm : res;
-    }
-    else
-    {
-        float zerox = smx / sm + origin;
-        if (zerox < x) return x;
-        else if (zerox > xm) return xm;
-        else return zerox;
-    }
-}
-
-
 #if !defined GRAPHITE2_NTRACING
 
 void Zones::jsonDbgOut(Segment *seg) const {
@@ -0,0 +1,76 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#include "inc/MemoryFace.h"
+
+
+using namespace graphite2;
+
+MemoryFace::MemoryFace(const void *data, size_t len)
+: _data(static_cast<const byte *>(data)),
+  _data_len(data ? len : 0),
+  _header_tbl(NULL),
+  _table_dir(NULL)
+{
+    size_t tbl_offset, tbl_len;
+
+    // Get the header.
+    if (!TtfUtil::GetHeaderInfo(tbl_offset, tbl_len)) return;
+    if (tbl_offset > _data_len || tbl_len > _data_len - tbl_offset) return;
+    const TtfUtil::Sfnt::OffsetSubTable * const header
+        = reinterpret_cast<const TtfUtil::Sfnt::OffsetSubTable *>(_data + tbl_offset);
+    if (!TtfUtil::CheckHeader(header)) return;
+
+    // Get the table directory
+    if (!TtfUtil::GetTableDirInfo(header, tbl_offset, tbl_len)) return;
+    if (tbl_offset > _data_len || tbl_len > _data_len - tbl_offset) return;
+    _header_tbl = header;
+    _table_dir = reinterpret_cast<const TtfUtil::Sfnt::OffsetSubTable::Entry *>(_data + tbl_offset);
+}
+
+
+const void *MemoryFace::table(unsigned int name, size_t *len) const
+{
+    size_t tbl_offset, tbl_len;
+    if (!TtfUtil::GetTableInfo(name, _header_tbl, _table_dir, tbl_offset, tbl_len))
+        return 0;
+
+    if (tbl_offset > _data_len || tbl_len > _data_len - tbl_offset)
+        return 0;
+
+    if (len) *len = tbl_len;
+    return _data + tbl_offset;
+}
+
+
+const void *MemoryFace::get_table_fn(const void* appFaceHandle, unsigned int name, size_t *len)
+{
+    if (appFaceHandle == 0)     return 0;
+    return static_cast<const MemoryFace *>(appFaceHandle)->table(name, len);
+}
+
+// Tables point into memory we do not own, so there is nothing to release.
+const gr_face_ops MemoryFace::ops = { sizeof MemoryFace::ops, &MemoryFace::get_table_fn, 0 };
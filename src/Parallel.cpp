@@ -0,0 +1,106 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#include "inc/Parallel.h"
+
+#if defined(GRAPHITE2_TELEMETRY)
+  // Telemetry counts into a single global category, so stay on one thread.
+#elif defined(GRAPHITE2_PTHREADS)
+  #include <pthread.h>
+  #include <unistd.h>
+  #define HAVE_THREADS
+#elif defined(_WIN32)
+  #include <windows.h>
+  #define HAVE_THREADS
+#endif
+
+using namespace graphite2;
+
+namespace
+{
+    // Enough to cover a font's passes without making threads to sit idle.
+    enum { MAX_WORKERS = 7 };
+
+    struct work
+    {
+        parallel_job    job;
+        void          * data;
+        long            n,
+                        next;
+    };
+
+    void drain(work & w) throw()
+    {
+        for (long i; (i = atomic_fetch_add(w.next, 1)) < w.n;)
+            w.job(w.data, unsigned(i));
+    }
+
+#if defined(HAVE_THREADS) && !defined(_WIN32)
+    typedef pthread_t thread;
+
+    void * run(void * w) { drain(*static_cast<work *>(w)); return 0; }
+    bool start(thread & t, work & w) { return pthread_create(&t, 0, &run, &w) == 0; }
+    void join(thread & t) { pthread_join(t, 0); }
+
+    unsigned int cpus()
+    {
+        const long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return n > 0 ? unsigned(n) : 1;
+    }
+#elif defined(HAVE_THREADS)
+    typedef HANDLE thread;
+
+    DWORD WINAPI run(LPVOID w) { drain(*static_cast<work *>(w)); return 0; }
+    bool start(thread & t, work & w) { return (t = CreateThread(0, 0, &run, &w, 0, 0)) != 0; }
+    void join(thread & t) { WaitForSingleObject(t, INFINITE); CloseHandle(t); }
+
+    unsigned int cpus()
+    {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        return si.dwNumberOfProcessors > 0 ? unsigned(si.dwNumberOfProcessors) : 1;
+    }
+#endif
+}
+
+void graphite2::parallel_for(unsigned int n, parallel_job job, void * data) throw()
+{
+    work w = { job, data, long(n), 0 };
+#if defined(HAVE_THREADS)
+    // The calling thread works too, so a failure to start a thread only
+    // costs speed.
+    thread workers[MAX_WORKERS];
+    const unsigned int wanted = min(min(cpus(), n), unsigned(MAX_WORKERS) + 1);
+    unsigned int started = 0;
+    while (started + 1 < wanted && start(workers[started], w))
+        ++started;
+    drain(w);
+    while (started)
+        join(workers[--started]);
+#else
+    drain(w);
+#endif
+}
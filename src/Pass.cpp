@@ -37,6 +37,7 @@ of the License or (at your option) any later version.
 #include "inc/Rule.h"
 #include "inc/Error.h"
 #include "inc/Collider.h"
+#include "inc/Snapshot.h"
 
 using namespace graphite2;
 using vm::Machine;
@@ -52,11 +53,9 @@ enum KernCollison
 
 Pass::Pass()
 : m_silf(0),
-  m_cols(0),
   m_rules(0),
   m_ruleMap(0),
   m_startStates(0),
-  m_transitions(0),
   m_states(0),
   m_codes(0),
   m_progs(0),
@@ -73,15 +72,15 @@ Pass::Pass()
   m_minPreCtxt(0),
   m_maxPreCtxt(0),
   m_colThreshold(0),
-  m_isReverseDir(false)
+  m_isReverseDir(false),
+  m_setsFeats(false)
 {
+    m_runRules[0] = m_runRules[1] = 0;
 }
 
 Pass::~Pass()
 {
-    free(m_cols);
     free(m_startStates);
-    free(m_transitions);
     free(m_states);
     free(m_ruleMap);
 
@@ -200,14 +199,18 @@ bool Pass::readPass(const byte * const pass_start, size_t pass_length, size_t su
     }
     if (m_numRules)
     {
-        if (!readRanges(ranges, numRanges, e)) return face.error(e);
+        if (!readRanges(ranges, numRanges, GlyphCoverage::shiftFor(face.glyphs().numGlyphs()), e))
+            return face.error(e);
         if (!readRules(rule_map, numEntries,  precontext, sort_keys,
                    o_constraint, rcCode, o_actions, aCode, face, pt, e)) return false;
     }
 #ifdef GRAPHITE2_TELEMETRY
     telemetry::category _states_cat(face.tele.states);
 #endif
-    return m_numRules ? readStates(start_states, states, o_rule_map, face, e) : true;
+    if (!m_numRules)    return true;
+    if (!readStates(start_states, states, o_rule_map, face, e)) return false;
+    chooseKernel();
+    return true;
 }
 
 
@@ -270,6 +273,7 @@ bool Pass::readRules(const byte * rule_map, const size_t num_entries,
                 || e.test(r->constraint->status() != Code::loaded, r->constraint->status() + E_CODEFAILURE)
                 || e.test(!r->constraint->immutable(), E_MUTABLECCODE))
             return face.error(e);
+        m_setsFeats |= r->action->setsFeatures();
     }
 
     byte * const moved_progs = prog_pool_free > m_progs ? static_cast<byte *>(realloc(m_progs, prog_pool_free - m_progs)) : 0;
@@ -320,9 +324,13 @@ bool Pass::readStates(const byte * starts, const byte *states, const byte * o_ru
 #ifdef GRAPHITE2_TELEMETRY
     telemetry::set_category(face.tele.transitions);
 #endif
-    m_transitions      = gralloc<uint16>(m_numTransition * m_numColumns);
+    uint16 * const trans = gralloc<uint16>(m_numTransition * m_numColumns);
 
-    if (e.test(!m_startStates || !m_states || !m_transitions, E_OUTOFMEM)) return face.error(e);
+    if (e.test(!m_startStates || !m_states || !trans, E_OUTOFMEM))
+    {
+        free(trans);
+        return face.error(e);
+    }
     // load start states
     for (uint16 * s = m_startStates,
                 * const s_end = s + m_maxPreCtxt - m_minPreCtxt + 1; s != s_end; ++s)
@@ -336,16 +344,18 @@ bool Pass::readStates(const byte * starts, const byte *states, const byte * o_ru
     }
 
     // load state transition table.
-    for (uint16 * t = m_transitions,
+    for (uint16 * t = trans,
                 * const t_end = t + m_numTransition*m_numColumns; t != t_end; ++t)
     {
         *t = be::read<uint16>(states);
         if (e.test(*t >= m_numStates, E_BADSTATE))
         {
-            face.error_context((face.error_context() & 0xFFFF00) + EC_ATRANS + int(((t - m_transitions) / m_numColumns) << 8));
+            face.error_context((face.error_context() & 0xFFFF00) + EC_ATRANS + int(((t - trans) / m_numColumns) << 8));
+            free(trans);
             return face.error(e);
         }
     }
+    m_transitions.build(trans, m_numTransition, m_numColumns);
 
     State * s = m_states,
           * const success_begin = m_states + m_numStates - m_numSuccess;
@@ -370,35 +380,245 @@ bool Pass::readStates(const byte * starts, const byte *states, const byte * o_ru
     return true;
 }
 
-bool Pass::readRanges(const byte * ranges, size_t num_ranges, Error &e)
+bool Pass::readRanges(const byte * ranges, size_t num_ranges, uint8 coverage_shift, Error &e)
 {
-    m_cols = gralloc<uint16>(m_numGlyphs);
-    if (e.test(!m_cols, E_OUTOFMEM)) return false;
-    memset(m_cols, 0xFF, m_numGlyphs * sizeof(uint16));
+    uint16 * const cols = gralloc<uint16>(m_numGlyphs);
+    if (e.test(!cols, E_OUTOFMEM)) return false;
+    memset(cols, 0xFF, m_numGlyphs * sizeof(uint16));
     for (size_t n = num_ranges; n; --n)
     {
-        uint16     * ci     = m_cols + be::read<uint16>(ranges),
-                   * ci_end = m_cols + be::read<uint16>(ranges) + 1,
+        uint16     * ci     = cols + be::read<uint16>(ranges),
+                   * ci_end = cols + be::read<uint16>(ranges) + 1,
                      col    = be::read<uint16>(ranges);
 
-        if (e.test(ci >= ci_end || ci_end > m_cols+m_numGlyphs || col >= m_numColumns, E_BADRANGE))
+        if (e.test(ci >= ci_end || ci_end > cols+m_numGlyphs || col >= m_numColumns, E_BADRANGE))
+        {
+            free(cols);
             return false;
+        }
+        m_coverage.add(uint16(ci - cols), uint16(ci_end - cols - 1), coverage_shift);
 
         // A glyph must only belong to one column at a time
         while (ci != ci_end && *ci == 0xffff)
             *ci++ = col;
 
         if (e.test(ci != ci_end, E_BADRANGE))
+        {
+            free(cols);
             return false;
+        }
+    }
+    return !e.test(!m_cols.build(cols, m_numGlyphs), E_OUTOFMEM);
+}
+
+
+// Only entries reachable from some state are written, so the unsorted tail
+// beyond FiniteStateMachine::MAX_RULES in an overlong state is dropped.
+bool Pass::writeImage(SnapshotWriter & w) const
+{
+    w.write(m_numCollRuns);
+    w.write(m_kernColls);
+    w.write(m_iMaxLoop);
+    w.write(m_numGlyphs);
+    w.write(m_numRules);
+    w.write(m_numStates);
+    w.write(m_numTransition);
+    w.write(m_numSuccess);
+    w.write(m_successStart);
+    w.write(m_numColumns);
+    w.write(m_minPreCtxt);
+    w.write(m_maxPreCtxt);
+    w.write(m_colThreshold);
+    w.write(byte(m_isReverseDir));
+    if (!m_cPConstraint.writeImage(w))  return false;
+    if (!m_numRules)                    return true;
+
+    for (unsigned int gid = 0; gid != m_numGlyphs; ++gid)
+        w.write(m_cols[gid]);
+    w.write(&m_coverage, sizeof m_coverage);
+    for (const Rule * r = m_rules, * const re = r + m_numRules; r != re; ++r)
+    {
+        w.write(r->sort);
+        w.write(r->preContext);
+    }
+
+    uint32 prog_pool_sz = 0;
+    for (const Code * c = m_codes, * const ce = c + m_numRules*2; c != ce; ++c)
+        prog_pool_sz += uint32(c->imageProgramSize());
+    w.write(prog_pool_sz);
+    for (const Code * c = m_codes, * const ce = c + m_numRules*2; c != ce; ++c)
+        if (!c->writeImage(w)) return false;
+
+    uint32 num_entries = 0;
+    for (const State * s = m_states, * const se = s + m_numStates; s != se; ++s)
+        if (s->rules_end)   num_entries = max(num_entries, uint32(s->rules_end - m_ruleMap));
+    w.write(num_entries);
+    for (const RuleEntry * re = m_ruleMap, * const ree = re + num_entries; re != ree; ++re)
+        w.write(uint16(re->rule - m_rules));
+
+    w.write(m_startStates, (m_maxPreCtxt - m_minPreCtxt + 1) * sizeof(uint16));
+    for (uint16 s = 0; s != m_numTransition; ++s)
+        for (uint16 c = 0; c != m_numColumns; ++c)
+            w.write(m_transitions(s, c));
+    for (const State * s = m_states, * const se = s + m_numStates; s != se; ++s)
+    {
+        w.write(s->rules ? uint32(s->rules - m_ruleMap) : ~uint32(0));
+        w.write(s->rules ? uint32(s->rules_end - m_ruleMap) : ~uint32(0));
     }
     return true;
 }
 
+void Pass::compile() throw()
+{
+    const size_t n = m_numRules*2 + 1;
+    Code ** const progs = gralloc<Code *>(n);
+    if (!progs) return;
+    for (size_t i = 0; i + 1 < n; ++i)
+        progs[i] = m_codes + i;
+    progs[n-1] = &m_cPConstraint;
+    m_jit.compile(progs, n);
+    free(progs);
+}
+
+// Whether any of the n values at v is lim or more, an unmapped 0xFFFF aside
+// if the values may be unmapped.
+static bool out_of_range(const uint16 * v, size_t n, uint16 lim, bool unmapped = false)
+{
+    if (!v) return false;
+    for (const uint16 * const e = v + n; v != e; ++v)
+        if (*v >= lim && !(unmapped && *v == 0xFFFF))   return true;
+    return false;
+}
+
+// The image is checked as readPass, readRules, readStates and readRanges
+// check the font, so that runFSM can trust it as far as it trusts them.
+bool Pass::readImage(SnapshotReader & r)
+{
+    m_numCollRuns   = r.read<byte>();
+    m_kernColls     = r.read<byte>();
+    m_iMaxLoop      = r.read<byte>();
+    m_numGlyphs     = r.read<uint16>();
+    m_numRules      = r.read<uint16>();
+    m_numStates     = r.read<uint16>();
+    m_numTransition = r.read<uint16>();
+    m_numSuccess    = r.read<uint16>();
+    m_successStart  = r.read<uint16>();
+    m_numColumns    = r.read<uint16>();
+    m_minPreCtxt    = r.read<byte>();
+    m_maxPreCtxt    = r.read<byte>();
+    m_colThreshold  = r.read<byte>();
+    m_isReverseDir  = r.read<byte>() != 0;
+    if (!m_cPConstraint.readImage(r)
+        || !r.test(m_minPreCtxt > m_maxPreCtxt
+                   || m_numTransition > m_numStates
+                   || m_numSuccess > m_numStates
+                   || m_numSuccess + m_numTransition < m_numStates
+                   || m_successStart != m_numStates - m_numSuccess
+                   || m_numColumns > 0x7FFF))
+        return false;
+    if (!m_numRules)    return true;
 
+    uint16 * const cols = r.readArray<uint16>(m_numGlyphs);
+    if (!r.test(out_of_range(cols, m_numGlyphs, m_numColumns, true)))
+    {
+        free(cols);
+        return false;
+    }
+    if (!r.test(!m_cols.build(cols, m_numGlyphs))) return false;
+    r.read(&m_coverage, sizeof m_coverage);
+    m_rules = new Rule [m_numRules];
+    m_codes = new Code [m_numRules*2];
+    if (!r.test(!m_rules || !m_codes)) return false;
+    for (int i = 0; i < m_numRules; ++i)
+    {
+        Rule & rule = m_rules[i];
+        rule.sort       = r.read<uint16>();
+        rule.preContext = r.read<byte>();
+        if (!r.test(rule.sort > 63 || rule.preContext >= rule.sort
+                    || rule.preContext > m_maxPreCtxt || rule.preContext < m_minPreCtxt))
+            return false;
+#ifndef NDEBUG
+        rule.rule_idx   = uint16(i);
+#endif
+        rule.action     = m_codes + i*2;
+        rule.constraint = m_codes + i*2 + 1;
+    }
+
+    // Each opcode in the image becomes an instr in the pool.
+    const uint32 prog_pool_sz = r.read<uint32>();
+    if (!r.test(prog_pool_sz / sizeof(vm::instr) > r.remaining())) return false;
+    m_progs = gralloc<byte>(prog_pool_sz ? prog_pool_sz : 1);
+    if (!r.test(!m_progs)) return false;
+    byte * prog_pool_free = m_progs;
+    for (Code * c = m_codes, * const ce = c + m_numRules*2; c != ce; ++c)
+    {
+        if (!c->readImage(r, &prog_pool_free, m_progs + prog_pool_sz)) return false;
+        m_setsFeats |= c->setsFeatures();
+    }
+
+    const uint32 num_entries = r.read<uint32>();
+    if (!r.test(num_entries > r.remaining())) return false;
+    m_ruleMap = gralloc<RuleEntry>(num_entries ? num_entries : 1);
+    if (!r.test(!m_ruleMap)) return false;
+    for (RuleEntry * re = m_ruleMap, * const ree = re + num_entries; re != ree; ++re)
+    {
+        const uint16 rn = r.read<uint16>();
+        if (!r.test(rn >= m_numRules)) return false;
+        re->rule = m_rules + rn;
+    }
+
+    m_startStates = r.readArray<uint16>(m_maxPreCtxt - m_minPreCtxt + 1);
+    uint16 * const trans = r.readArray<uint16>(m_numTransition * m_numColumns);
+    if (!r.test(out_of_range(m_startStates, m_maxPreCtxt - m_minPreCtxt + 1, m_numStates)
+                || out_of_range(trans, m_numTransition * m_numColumns, m_numStates)))
+    {
+        free(trans);
+        return false;
+    }
+    const bool has_trans = m_transitions.build(trans, m_numTransition, m_numColumns);
+    m_states      = gralloc<State>(m_numStates ? m_numStates : 1);
+    if (!r.test(!m_states || !has_trans)) return false;
+    for (State * s = m_states, * const se = s + m_numStates; s != se; ++s)
+    {
+        const uint32 begin = r.read<uint32>(),
+                     end   = r.read<uint32>();
+        if (begin == ~uint32(0) && end == ~uint32(0))
+            s->rules = s->rules_end = 0;
+        else if (r.test(begin > end || end > num_entries))
+        {
+            s->rules     = m_ruleMap + begin;
+            s->rules_end = m_ruleMap + end;
+        }
+        else
+            return false;
+    }
+    chooseKernel();
+    return r;
+}
+
+// Clears shifts unless some glyph is to be shifted clear of the others, and
+// kerns unless some glyph is to be kerned, which are the only glyphs the
+// collision stages ever move.
+static void collisionTargets(const Segment *seg, bool &shifts, bool &kerns)
+{
+    bool shift = false, kern = false;
+    for (const Slot *s = seg->first(); s && !(shift && kern); s = s->next())
+    {
+        const uint16 flags = seg->collisionInfo(s)->flags()
+                           & (SlotCollision::COLL_FIX | SlotCollision::COLL_KERN);
+        shift |= flags == SlotCollision::COLL_FIX;
+        kern  |= flags == (SlotCollision::COLL_FIX | SlotCollision::COLL_KERN);
+    }
+    shifts &= shift;
+    kerns  &= kern;
+}
+
+template <bool traced>
 bool Pass::runGraphite(vm::Machine & m, FiniteStateMachine & fsm, bool reverse) const
 {
+    json * const dbgout = fsm.dbgout;
     Slot *s = m.slotMap().segment.first();
-    if (!s || !testPassConstraint(m)) return true;
+    if (!s || !testPassConstraint(m, traced ? dbgout : 0)) return true;
     if (reverse)
     {
         m.slotMap().segment.reverseSlots();
@@ -406,27 +626,20 @@ bool Pass::runGraphite(vm::Machine & m, FiniteStateMachine & fsm, bool reverse)
     }
     if (m_numRules)
     {
+        // Classify the run once, rules that change a glyph mark its slot for
+        // runFSM to classify again.
+        for (Slot * c = s; c; c = c->next())
+            c->column(glyphToCol(c->gid()));
+
         Slot *currHigh = s->next();
 
 #if !defined GRAPHITE2_NTRACING
-        if (fsm.dbgout)  *fsm.dbgout << "rules" << json::array;
-        json::closer rules_array_closer(fsm.dbgout);
+        if (traced && dbgout)  *dbgout << "rules" << json::array;
+        json::closer rules_array_closer(traced ? dbgout : 0);
 #endif
 
         m.slotMap().highwater(currHigh);
-        int lc = m_iMaxLoop;
-        do
-        {
-            findNDoRule(s, m, fsm);
-            if (m.status() != Machine::finished) return false;
-            if (s && (s == m.slotMap().highwater() || m.slotMap().highpassed() || --lc == 0)) {
-                if (!lc)
-                    s = m.slotMap().highwater();
-                lc = m_iMaxLoop;
-                if (s)
-                    m.slotMap().highwater(s->next());
-            }
-        } while (s);
+        if (!(this->*m_runRules[traced])(s, m, fsm)) return false;
     }
     //TODO: Use enums for flags
     const bool collisions = m_numCollRuns || m_kernColls;
@@ -434,6 +647,24 @@ bool Pass::runGraphite(vm::Machine & m, FiniteStateMachine & fsm, bool reverse)
     if (!collisions || !m.slotMap().segment.hasCollisionInfo())
         return true;
 
+    // Only the stages some glyph in the segment is marked for are run, and if
+    // there are none nothing is, positioning included. Traced runs go through
+    // them all so that the log is complete.
+    bool shifts = m_numCollRuns != 0,
+         kerns  = m_kernColls != 0;
+    collisionTargets(&m.slotMap().segment, shifts, kerns);
+#ifdef GRAPHITE2_TELEMETRY
+    ++m.slotMap().segment.getFace()->tele.coll_passes;
+    if (!shifts && !kerns)  ++m.slotMap().segment.getFace()->tele.coll_skipped;
+#endif
+    if (traced)
+    {
+        shifts = m_numCollRuns != 0;
+        kerns  = m_kernColls != 0;
+    }
+    else if (!shifts && !kerns)
+        return true;
+
     if (m_numCollRuns)
     {
         if (!(m.slotMap().segment.flags() & Segment::SEG_INITCOLLISIONS))
@@ -441,35 +672,212 @@ bool Pass::runGraphite(vm::Machine & m, FiniteStateMachine & fsm, bool reverse)
             m.slotMap().segment.positionSlots(0, 0, 0, m.slotMap().dir(), true);
 //            m.slotMap().segment.flags(m.slotMap().segment.flags() | Segment::SEG_INITCOLLISIONS);
         }
-        if (!collisionShift(&m.slotMap().segment, m.slotMap().dir(), fsm.dbgout))
+        if (shifts && !collisionShift<traced>(&m.slotMap().segment, m.slotMap().dir(), dbgout))
             return false;
     }
-    if ((m_kernColls) && !collisionKern(&m.slotMap().segment, m.slotMap().dir(), fsm.dbgout))
+    if (kerns && !collisionKern<traced>(&m.slotMap().segment, m.slotMap().dir(), dbgout))
         return false;
-    if (collisions && !collisionFinish(&m.slotMap().segment, fsm.dbgout))
+    if (!collisionFinish<traced>(&m.slotMap().segment, dbgout))
         return false;
     return true;
 }
 
-bool Pass::runFSM(FiniteStateMachine& fsm, Slot * slot) const
+template bool Pass::runGraphite<false>(vm::Machine &, FiniteStateMachine &, bool) const;
+template bool Pass::runGraphite<true>(vm::Machine &, FiniteStateMachine &, bool) const;
+
+template <int kernel>
+bool Pass::runRules(Slot * s, vm::Machine & m, FiniteStateMachine & fsm) const
 {
-    fsm.reset(slot, m_maxPreCtxt);
-    if (fsm.slots.context() < m_minPreCtxt)
-        return false;
+    int lc = m_iMaxLoop;
+    do
+    {
+        findNDoRule<kernel>(s, m, fsm);
+        if (m.status() != Machine::finished) return false;
+        if (s && (s == m.slotMap().highwater() || m.slotMap().highpassed() || --lc == 0)) {
+            if (!lc)
+                s = m.slotMap().highwater();
+            lc = m_iMaxLoop;
+            if (s)
+                m.slotMap().highwater(s->next());
+        }
+    } while (s);
+    return true;
+}
+
+void Pass::chooseKernel() throw()
+{
+    static const rule_runner runners[NUM_KERNELS] = {
+        &Pass::runRules<0>,  &Pass::runRules<1>,  &Pass::runRules<2>,  &Pass::runRules<3>,
+        &Pass::runRules<4>,  &Pass::runRules<5>,  &Pass::runRules<6>,  &Pass::runRules<7>,
+        &Pass::runRules<8>,  &Pass::runRules<9>,  &Pass::runRules<10>, &Pass::runRules<11>,
+        &Pass::runRules<12>, &Pass::runRules<13>, &Pass::runRules<14>, &Pass::runRules<15>
+    };
+
+    int kernel = m_maxPreCtxt ? HAS_PRECONTEXT : 0;
+    for (const Rule * r = m_rules, * const re = r + m_numRules; r != re; ++r)
+    {
+        if (*r->constraint)         kernel |= HAS_CONSTRAINTS;
+        if (r->action->deletes())   kernel |= HAS_DELETES;
+    }
+    m_runRules[0] = runners[kernel];
+    m_runRules[1] = runners[kernel | TRACED];
+}
+
+inline
+uint16 Pass::glyphToCol(const uint16 gid) const
+{
+    return m_cols[gid];
+}
+
+Pass::InertGlyphs::InertGlyphs(const Pass & pass, const FeatureMap & fmap, const FeatureVal & feats)
+: m_pass(pass),
+  m_cols(0),
+  m_reached(0),
+  m_liveRules(0),
+  m_pendingStates(0),
+  m_pendingCol(0xffffU),
+  m_numPending(0)
+{
+    // A pass whose constraint fails, or without rules, matches nothing.
+    if (!m_pass.m_numRules || (m_pass.m_cPConstraint && m_pass.m_cPConstraint.failsWith(fmap, feats)))
+        return;
+
+    m_cols = grzeroalloc<byte>(m_pass.m_numColumns);
+    m_reached = grzeroalloc<byte>(m_pass.m_numStates);
+    m_liveRules = gralloc<byte>(m_pass.m_numRules);
+    m_pendingStates = gralloc<uint16>(m_pass.m_numStates);
+    bool ok = m_cols && m_reached && m_liveRules && m_pendingStates;
+    for (size_t i = 0; ok && i != m_pass.m_numRules; ++i)
+    {
+        const vm::Machine::Code * const c = m_pass.m_rules[i].constraint;
+        m_liveRules[i] = !c || !*c || !c->failsWith(fmap, feats);
+    }
+    // Runs start out in any start state, whatever their precontext. State 0
+    // starts runs with the longest precontext, elsewhere it means no match.
+    for (int i = 0; ok && i <= m_pass.m_maxPreCtxt - m_pass.m_minPreCtxt; ++i)
+        ok = visit(m_pass.m_startStates[i]);
+    if (!ok)
+    {
+        free(m_reached);
+        m_reached = 0;
+        m_numPending = 0;
+    }
+    else
+        settle(true);
+}
+
+Pass::InertGlyphs::~InertGlyphs()
+{
+    free(m_cols);
+    free(m_reached);
+    free(m_liveRules);
+    free(m_pendingStates);
+}
+
+bool Pass::InertGlyphs::visit(uint16 state)
+{
+    if (m_reached[state] != UNSEEN)     return true;
+    if (state >= m_pass.m_successStart)
+    {
+        const State & s = m_pass.m_states[state];
+        for (const RuleEntry * r = s.rules; r != s.rules_end; ++r)
+            if (m_liveRules[r->rule - m_pass.m_rules])
+                return false;
+    }
+    m_reached[state] = TENTATIVE;
+    m_pendingStates[m_numPending++] = state;
+    return true;
+}
+
+bool Pass::InertGlyphs::reach(uint16 state)
+{
+    return state == 0 || visit(state);
+}
+
+bool Pass::InertGlyphs::refuses(uint16 gid) const
+{
+    if (!m_liveRules)   return false;
+    const uint16 col = m_pass.glyphToCol(gid);
+    return col != 0xffffU && m_cols[col] == REFUSED;
+}
+
+bool Pass::InertGlyphs::admit(uint16 gid)
+{
+    if (!m_liveRules)           return true;
+    const uint16 col = m_pass.glyphToCol(gid);
+    // The FSM stops at a glyph without a column.
+    if (col == 0xffffU)         return true;
+    if (m_cols[col] != UNSEEN)  return m_cols[col] != REFUSED;
+
+    const StateTable & trans = m_pass.m_transitions;
+    const uint16 num_cols = m_pass.m_numColumns;
+    m_cols[col] = TENTATIVE;
+    m_pendingCol = col;
+    bool ok = true;
+    // Anywhere a run could already get to may now step on by col, and
+    // from any new state on by any column allowed so far.
+    for (uint16 s = 0; ok && s < m_pass.m_numTransition; ++s)
+        if (m_reached[s] == KEPT)
+            ok = reach(trans(s, col));
+    for (size_t i = 0; ok && i != m_numPending; ++i)
+    {
+        const uint16 s = m_pendingStates[i];
+        if (s >= m_pass.m_numTransition) continue;
+        for (uint16 c = 0; ok && c != num_cols; ++c)
+            if (m_cols[c] == KEPT || m_cols[c] == TENTATIVE)
+                ok = reach(trans(s, c));
+    }
+    if (!ok)
+    {
+        // More states are only ever reached, so col stays out for good.
+        m_cols[col] = REFUSED;
+        m_pendingCol = 0xffffU;
+    }
+    return ok;
+}
 
-    uint16 state = m_startStates[m_maxPreCtxt - fsm.slots.context()];
+void Pass::InertGlyphs::settle(bool keep)
+{
+    if (m_pendingCol != 0xffffU)
+        m_cols[m_pendingCol] = keep ? KEPT : UNSEEN;
+    m_pendingCol = 0xffffU;
+    for (size_t i = 0; i != m_numPending; ++i)
+        m_reached[m_pendingStates[i]] = keep ? KEPT : UNSEEN;
+    m_numPending = 0;
+}
+
+template <int kernel>
+bool Pass::runFSM(FiniteStateMachine& fsm, Slot * slot) const
+{
+    uint16 state;
+    if (kernel & HAS_PRECONTEXT)
+    {
+        fsm.reset(slot, m_maxPreCtxt);
+        if (fsm.slots.context() < m_minPreCtxt)
+            return false;
+        state = m_startStates[m_maxPreCtxt - fsm.slots.context()];
+    }
+    else
+    {
+        fsm.reset(slot, 0);
+        state = m_startStates[0];
+    }
     uint8  free_slots = SlotMap::MAX_SLOTS;
     do
     {
         fsm.slots.pushSlot(slot);
-        if (slot->gid() >= m_numGlyphs
-         || m_cols[slot->gid()] == 0xffffU
+        uint16 col = slot->column();
+        if (col == Slot::UNCLASSIFIED)
+        {
+            col = glyphToCol(slot->gid());
+            slot->column(col);
+        }
+        if (col == 0xffffU
          || --free_slots == 0
          || state >= m_numTransition)
             return free_slots != 0;
 
-        const uint16 * transitions = m_transitions + state*m_numColumns;
-        state = transitions[m_cols[slot->gid()]];
+        state = m_transitions(state, col);
         if (state >= m_successStart)
             fsm.rules.accumulate_rules(m_states[state]);
 
@@ -500,16 +908,17 @@ Slot * output_slot(const SlotMap &  slots, const int n)
 
 #endif //!defined GRAPHITE2_NTRACING
 
+template <int kernel>
 void Pass::findNDoRule(Slot * & slot, Machine &m, FiniteStateMachine & fsm) const
 {
     assert(slot);
 
-    if (runFSM(fsm, slot))
+    if (runFSM<kernel>(fsm, slot))
     {
         // Search for the first rule which passes the constraint
         const RuleEntry *        r = fsm.rules.begin(),
                         * const re = fsm.rules.end();
-        while (r != re && !testConstraint(*r->rule, m))
+        while (r != re && !testConstraint<kernel>(*r->rule, m, fsm))
         {
             ++r;
             if (m.status() != Machine::finished)
@@ -517,7 +926,7 @@ void Pass::findNDoRule(Slot * & slot, Machine &m, FiniteStateMachine & fsm) cons
         }
 
 #if !defined GRAPHITE2_NTRACING
-        if (fsm.dbgout)
+        if (kernel & TRACED)
         {
             if (fsm.rules.size() != 0)
             {
@@ -527,7 +936,7 @@ void Pass::findNDoRule(Slot * & slot, Machine &m, FiniteStateMachine & fsm) cons
                 {
                     const int adv = doAction(r->rule->action, slot, m);
                     dumpRuleEventOutput(fsm, *r->rule, slot);
-                    if (r->rule->action->deletes()) fsm.slots.collectGarbage(slot);
+                    if ((kernel & HAS_DELETES) && r->rule->action->deletes()) fsm.slots.collectGarbage(slot);
                     adjustSlot(adv, slot, fsm.slots);
                     *fsm.dbgout << "cursor" << objectid(dslot(&fsm.slots.segment, slot))
                             << json::close; // Close RuelEvent object
@@ -550,7 +959,7 @@ void Pass::findNDoRule(Slot * & slot, Machine &m, FiniteStateMachine & fsm) cons
             {
                 const int adv = doAction(r->rule->action, slot, m);
                 if (m.status() != Machine::finished) return;
-                if (r->rule->action->deletes()) fsm.slots.collectGarbage(slot);
+                if ((kernel & HAS_DELETES) && r->rule->action->deletes()) fsm.slots.collectGarbage(slot);
                 adjustSlot(adv, slot, fsm.slots);
                 return;
             }
@@ -614,7 +1023,7 @@ void Pass::dumpRuleEventOutput(const FiniteStateMachine & fsm, const Rule & r, S
 
 
 inline
-bool Pass::testPassConstraint(Machine & m) const
+bool Pass::testPassConstraint(Machine & m, GR_MAYBE_UNUSED json * const dbgout) const
 {
     if (!m_cPConstraint) return true;
 
@@ -626,7 +1035,6 @@ bool Pass::testPassConstraint(Machine & m) const
     const uint32 ret = m_cPConstraint.run(m, map);
 
 #if !defined GRAPHITE2_NTRACING
-    json * const dbgout = m.slotMap().segment.getFace()->logger();
     if (dbgout)
         *dbgout << "constraint" << (ret && m.status() == Machine::finished);
 #endif
@@ -635,7 +1043,8 @@ bool Pass::testPassConstraint(Machine & m) const
 }
 
 
-bool Pass::testConstraint(const Rule & r, Machine & m) const
+template <int kernel>
+bool Pass::testConstraint(const Rule & r, Machine & m, FiniteStateMachine & fsm) const
 {
     const uint16 curr_context = m.slotMap().context();
     if (unsigned(r.sort + curr_context - r.preContext) > m.slotMap().size()
@@ -645,13 +1054,38 @@ bool Pass::testConstraint(const Rule & r, Machine & m) const
     if (map[r.sort - 1] == 0)
         return false;
 
-    if (!*r.constraint) return true;
+    if (!(kernel & HAS_CONSTRAINTS) || !*r.constraint) return true;
     assert(r.constraint->constraint());
+
+    // Reuse what the constraint said about the same glyph at the same place
+    // before, as long as it would run at all and no rule changes features.
+    const SlotMap & smap = m.slotMap();
+    const size_t last = r.constraint->maxRef() + curr_context;
+    const bool memoise = r.constraint->ownGlyphOnly() && !m_setsFeats
+                      && last < smap.size() && smap[int(last)];
     for (int n = r.sort; n && map; --n, ++map)
     {
         if (!*map) continue;
+        const uint8 pos = uint8(r.sort - n);
+        uint16 gid = 0;
+        uint8  fid = 0;
+        if (memoise)
+        {
+            gid = (*map)->gid();
+            fid = smap.segment.charinfo((*map)->original())->fid();
+            const int known = fsm.memo.find(r, pos, gid, fid);
+            if (known != FiniteStateMachine::Memo::UNKNOWN)
+            {
+                if (!known) return false;
+                continue;
+            }
+        }
         const int32 ret = r.constraint->run(m, map);
-        if (!ret || m.status() != Machine::finished)
+        if (m.status() != Machine::finished)
+            return false;
+        if (memoise)
+            fsm.memo.store(r, pos, gid, fid, ret != 0);
+        if (!ret)
             return false;
     }
 
@@ -733,9 +1167,11 @@ void Pass::adjustSlot(int delta, Slot * & slot_out, SlotMap & smap) const
     }
 }
 
+template <bool traced>
 bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
 {
     ShiftCollider shiftcoll(dbgout);
+    CollisionIndex index;
     // bool isfirst = true;
     bool hasCollisions = false;
     Slot *start = seg->first();      // turn on collision fixing for the first slot
@@ -743,7 +1179,7 @@ bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
     bool moved = false;
 
 #if !defined GRAPHITE2_NTRACING
-    if (dbgout)
+    if (traced && dbgout)
         *dbgout << "collisions" << json::array
             << json::flat << json::object << "num-loops" << m_numCollRuns << json::close;
 #endif
@@ -751,16 +1187,17 @@ bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
     while (start)
     {
 #if !defined GRAPHITE2_NTRACING
-        if (dbgout)  *dbgout << json::object << "phase" << "1" << "moves" << json::array;
+        if (traced && dbgout)  *dbgout << json::object << "phase" << "1" << "moves" << json::array;
 #endif
         hasCollisions = false;
         end = NULL;
+        index.build(seg, start);
         // phase 1 : position shiftable glyphs, ignoring kernable glyphs
         for (Slot *s = start; s; s = s->next())
         {
             const SlotCollision * c = seg->collisionInfo(s);
             if (start && (c->flags() & (SlotCollision::COLL_FIX | SlotCollision::COLL_KERN)) == SlotCollision::COLL_FIX
-                      && !resolveCollisions(seg, s, start, shiftcoll, false, dir, moved, hasCollisions, dbgout))
+                      && !resolveCollisions<traced>(seg, s, start, shiftcoll, index, false, dir, moved, hasCollisions, dbgout))
                 return false;
             if (s != start && (c->flags() & SlotCollision::COLL_END))
             {
@@ -770,7 +1207,7 @@ bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
         }
 
 #if !defined GRAPHITE2_NTRACING
-        if (dbgout)
+        if (traced && dbgout)
             *dbgout << json::close << json::close; // phase-1
 #endif
 
@@ -781,7 +1218,7 @@ bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
             {
 
 #if !defined GRAPHITE2_NTRACING
-                if (dbgout)
+                if (traced && dbgout)
                     *dbgout << json::object << "phase" << "2a" << "loop" << i << "moves" << json::array;
 #endif
                 // phase 2a : if any shiftable glyphs are in collision, iterate backwards,
@@ -807,7 +1244,7 @@ bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
                         if (start && (c->flags() & (SlotCollision::COLL_FIX | SlotCollision::COLL_KERN | SlotCollision::COLL_ISCOL))
                                         == (SlotCollision::COLL_FIX | SlotCollision::COLL_ISCOL)) // ONLY if this glyph is still colliding
                         {
-                            if (!resolveCollisions(seg, s, lend, shiftcoll, true, dir, moved, hasCollisions, dbgout))
+                            if (!resolveCollisions<traced>(seg, s, lend, shiftcoll, index, true, dir, moved, hasCollisions, dbgout))
                                 return false;
                             c->setFlags(c->flags() | SlotCollision::COLL_TEMPLOCK);
                         }
@@ -815,7 +1252,7 @@ bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
                 }
 
 #if !defined GRAPHITE2_NTRACING
-                if (dbgout)
+                if (traced && dbgout)
                     *dbgout << json::close << json::close // phase 2a
                         << json::object << "phase" << "2b" << "loop" << i << "moves" << json::array;
 #endif
@@ -833,7 +1270,7 @@ bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
                         SlotCollision * c = seg->collisionInfo(s);
                         if (start && (c->flags() & (SlotCollision::COLL_FIX | SlotCollision::COLL_TEMPLOCK
                                                         | SlotCollision::COLL_KERN)) == SlotCollision::COLL_FIX
-                                  && !resolveCollisions(seg, s, start, shiftcoll, false, dir, moved, hasCollisions, dbgout))
+                                  && !resolveCollisions<traced>(seg, s, start, shiftcoll, index, false, dir, moved, hasCollisions, dbgout))
                             return false;
                         else if (c->flags() & SlotCollision::COLL_TEMPLOCK)
                             c->setFlags(c->flags() & ~SlotCollision::COLL_TEMPLOCK);
@@ -842,7 +1279,7 @@ bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
         //      if (!hasCollisions) // no, don't leave yet because phase 2b will continue to improve things
         //          break;
 #if !defined GRAPHITE2_NTRACING
-                if (dbgout)
+                if (traced && dbgout)
                     *dbgout << json::close << json::close; // phase 2
 #endif
             }
@@ -862,6 +1299,7 @@ bool Pass::collisionShift(Segment *seg, int dir, json * const dbgout) const
     return true;
 }
 
+template <bool traced>
 bool Pass::collisionKern(Segment *seg, int dir, json * const dbgout) const
 {
     Slot *start = seg->first();
@@ -871,7 +1309,7 @@ bool Pass::collisionKern(Segment *seg, int dir, json * const dbgout) const
 
     // phase 3 : handle kerning of clusters
 #if !defined GRAPHITE2_NTRACING
-    if (dbgout)
+    if (traced && dbgout)
         *dbgout << json::object << "phase" << "3" << "moves" << json::array;
 #endif
 
@@ -889,7 +1327,7 @@ bool Pass::collisionKern(Segment *seg, int dir, json * const dbgout) const
         }
         if (start && (c->flags() & (SlotCollision::COLL_KERN | SlotCollision::COLL_FIX))
                         == (SlotCollision::COLL_KERN | SlotCollision::COLL_FIX))
-            resolveKern(seg, s, start, dir, ymin, ymax, dbgout);
+            resolveKern<traced>(seg, s, start, dir, ymin, ymax, dbgout);
         if (c->flags() & SlotCollision::COLL_END)
             start = NULL;
         if (c->flags() & SlotCollision::COLL_START)
@@ -897,12 +1335,13 @@ bool Pass::collisionKern(Segment *seg, int dir, json * const dbgout) const
     }
 
 #if !defined GRAPHITE2_NTRACING
-    if (dbgout)
+    if (traced && dbgout)
         *dbgout << json::close << json::close; // phase 3
 #endif
     return true;
 }
 
+template <bool traced>
 bool Pass::collisionFinish(Segment *seg, GR_MAYBE_UNUSED json * const dbgout) const
 {
     for (Slot *s = seg->first(); s; s = s->next())
@@ -919,7 +1358,7 @@ bool Pass::collisionFinish(Segment *seg, GR_MAYBE_UNUSED json * const dbgout) co
 //    seg->positionSlots();
 
 #if !defined GRAPHITE2_NTRACING
-        if (dbgout)
+        if (traced && dbgout)
             *dbgout << json::close;
 #endif
     return true;
@@ -944,8 +1383,9 @@ static bool inKernCluster(Segment *seg, Slot *s)
 // Fix collisions for the given slot.
 // Return true if everything was fixed, false if there are still collisions remaining.
 // isRev means be we are processing backwards.
+template <bool traced>
 bool Pass::resolveCollisions(Segment *seg, Slot *slotFix, Slot *start,
-        ShiftCollider &coll, GR_MAYBE_UNUSED bool isRev, int dir, bool &moved, bool &hasCol,
+        ShiftCollider &coll, CollisionIndex &index, GR_MAYBE_UNUSED bool isRev, int dir, bool &moved, bool &hasCol,
         json * const dbgout) const
 {
     Slot * nbor;  // neighboring slot
@@ -963,8 +1403,12 @@ bool Pass::resolveCollisions(Segment *seg, Slot *slotFix, Slot *start,
         base = base->attachedTo();
     Position zero(0., 0.);
 
-    // Look for collisions with the neighboring glyphs.
-    for (nbor = start; nbor; nbor = isRev ? nbor->prev() : nbor->next())
+    // Look for collisions with the neighboring glyphs, only those near enough
+    // to matter if the range is indexed.
+    const Vector<Slot *> * const near = index.neighbours(seg, coll, start, slotFix, base, isRev);
+    Vector<Slot *>::const_iterator n = near ? near->begin() : 0;
+    for (nbor = near ? (n != near->end() ? *n : 0) : start; nbor;
+         nbor = near ? (++n != near->end() ? *n : 0) : isRev ? nbor->prev() : nbor->next())
     {
         SlotCollision *cNbor = seg->collisionInfo(nbor);
         bool sameCluster = nbor->isChildOf(base);
@@ -1003,13 +1447,14 @@ bool Pass::resolveCollisions(Segment *seg, Slot *slotFix, Slot *start,
                 float clusterMin = here.x;
                 slotFix->firstChild()->finalise(seg, NULL, here, bbox, 0, clusterMin, rtl, false);
             }
+            index.moved(seg, slotFix);
         }
     }
     else
     {
         // This glyph is not colliding with anything.
 #if !defined GRAPHITE2_NTRACING
-        if (dbgout)
+        if (traced && dbgout)
         {
             *dbgout << json::object
                             << "missed" << objectid(dslot(seg, slotFix));
@@ -1028,6 +1473,7 @@ bool Pass::resolveCollisions(Segment *seg, Slot *slotFix, Slot *start,
     return true;
 }
 
+template <bool traced>
 float Pass::resolveKern(Segment *seg, Slot *slotFix, GR_MAYBE_UNUSED Slot *start, int dir,
     float &ymin, float &ymax, json *const dbgout) const
 {
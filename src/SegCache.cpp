@@ -0,0 +1,299 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#include "inc/Face.h"
+#include "inc/SegCache.h"
+#include "inc/Segment.h"
+#include "inc/Silf.h"
+
+using namespace graphite2;
+
+struct SegCache::Key
+{
+    const uint32    * usv;
+    size_t            length;
+    const Features  & feats;
+    const Silf      * silf;
+    uint32            script,
+                      hash;
+    int8              dir;
+};
+
+struct SegCache::Entry
+{
+    Entry(const Key & k, Segment * s);
+    ~Entry();
+
+    bool matches(const Key & k) const;
+
+    Entry       * chain,    // next entry in the same hash bucket
+                * older,
+                * newer;
+    uint32      * usv;
+    size_t        length;
+    Features      feats;
+    const Silf  * silf;
+    uint32        script,
+                  hash;
+    int8          dir;
+    Segment     * seg;      // owned, already run through all the passes
+
+    CLASS_NEW_DELETE;
+};
+
+namespace
+{
+    uint32 hash_key(const uint32 * usv, size_t length, const Features & feats, uint32 script, int8 dir)
+    {
+        // FNV-1a
+        uint32 h = 2166136261u;
+        for (const uint32 * const end = usv + length; usv != end; ++usv)
+            h = (h ^ *usv) * 16777619u;
+        for (Features::const_iterator f = feats.begin(); f != feats.end(); ++f)
+            h = (h ^ *f) * 16777619u;
+        h = (h ^ script) * 16777619u;
+        return (h ^ uint8(dir)) * 16777619u;
+    }
+}
+
+SegCache::Entry::Entry(const Key & k, Segment * s)
+: chain(0), older(0), newer(0),
+  usv(gralloc<uint32>(k.length)),
+  length(k.length),
+  feats(k.feats),
+  silf(k.silf),
+  script(k.script),
+  hash(k.hash),
+  dir(k.dir),
+  seg(s)
+{
+    if (usv)
+        memcpy(usv, k.usv, length * sizeof(uint32));
+}
+
+SegCache::Entry::~Entry()
+{
+    free(usv);
+    delete seg;
+}
+
+bool SegCache::Entry::matches(const Key & k) const
+{
+    return hash == k.hash && length == k.length && silf == k.silf
+        && script == k.script && dir == k.dir
+        && memcmp(usv, k.usv, length * sizeof(uint32)) == 0
+        && feats == k.feats;
+}
+
+
+SegCache::SegCache(const Face & face, size_t maxSegments)
+: m_face(face),
+  m_buckets(0),
+  m_newest(0),
+  m_oldest(0),
+  m_maxSize(maxSegments),
+  m_size(0),
+  m_mask(15),
+  m_hits(0),
+  m_misses(0),
+  m_lock(0)
+{
+    while (m_mask < m_maxSize && m_mask < 0xFFFFF)
+        m_mask = (m_mask << 1) | 1;
+    m_buckets = grzeroalloc<Entry *>(m_mask + 1);
+    if (!m_buckets)
+        m_maxSize = 0;
+}
+
+SegCache::~SegCache()
+{
+    for (Entry * e = m_newest, * n; e; e = n)
+    {
+        n = e->older;
+        delete e;
+    }
+    free(m_buckets);
+}
+
+// Spaces must not take part in any rule, and neither bidi resolution nor
+// collision avoidance may look across them, for a run to be shaped on its own.
+// Only gr_space_none promises the first; most fonts say gr_space_unknown.
+bool SegCache::suits(const Segment & seg) const
+{
+    const Silf * const silf = seg.silf();
+    return m_maxSize
+        && silf
+        && !m_face.logger()
+        && silf->bidiPass() == 0xFF
+        && !(silf->flags() & 0x20)
+        && silf->silfInfo()->space_contextuals == gr_faceinfo::gr_space_none;
+}
+
+bool SegCache::runGraphite(Segment & seg, uint32 script)
+{
+    const size_t n = seg.charInfoCount();
+    const int8 dir = seg.dir();
+    uint32 * const usv = gralloc<uint32>(n);
+    if (!usv) return n == 0;
+    for (size_t i = 0; i != n; ++i)
+        usv[i] = seg.charinfo(i)->unicodeChar();
+
+    // The slots made by read_text are replaced wholesale by the shaped runs.
+    // Free from the back, freeSlot does not unlink a slot from its neighbours.
+    while (seg.last())
+    {
+        Slot * const s = seg.last();
+        seg.freeSlot(s);
+        if (seg.last()) seg.last()->next(0);
+    }
+    seg.first(0);
+    seg.extendLength(-ptrdiff_t(seg.slotCount()));
+
+    bool res = true;
+    for (size_t start = 0, end; res && start < n; start = end)
+    {
+        const bool space = seg.isWhitespace(usv[start]);
+        for (end = start + 1; end < n && seg.isWhitespace(usv[end]) == space; ++end) {}
+        res = shapeRun(seg, script, dir, int(start), end - start, usv + start);
+    }
+    free(usv);
+
+    if (res)
+        seg.associateChars(0, n);
+    return res;
+}
+
+bool SegCache::shapeRun(Segment & seg, uint32 script, int8 dir, int start, size_t length, const uint32 * usv)
+{
+    const Features & feats = seg.getFeatures(0);
+    const Key key = { usv, length, feats, seg.silf(), script, hash_key(usv, length, feats, script, dir), dir };
+    const bool cacheable = length <= eMaxSpliceSize;
+
+    if (cacheable)
+    {
+        lock();
+        const Entry * const e = find(key);
+        if (e)
+        {
+            ++m_hits;
+            const bool res = seg.splice(*e->seg, start);
+            unlock();
+            return res;
+        }
+        ++m_misses;
+        unlock();
+    }
+
+    Segment * const sub = new Segment(length, &m_face, script, dir);
+    if (!sub || !sub->read_text(&m_face, &feats, gr_utf32, usv, length) || !sub->runGraphite())
+    {
+        delete sub;
+        return false;
+    }
+    // Number the slots so splice can map attachments across.
+    int i = 0;
+    for (Slot * s = sub->first(); s; s = s->next())
+        s->index(i++);
+    const bool res = seg.splice(*sub, start);
+
+    if (!cacheable)
+    {
+        delete sub;
+        return res;
+    }
+
+    Entry * const e = new Entry(key, sub);
+    if (!e)
+    {
+        delete sub;
+        return res;
+    }
+    lock();
+    if (!e->usv || find(key))   // another thread beat us to it
+        delete e;
+    else
+        insert(e);
+    unlock();
+    return res;
+}
+
+SegCache::Entry * SegCache::find(const Key & key)
+{
+    Entry * e = m_buckets[key.hash & m_mask];
+    for (; e && !e->matches(key); e = e->chain) {}
+    if (e && e != m_newest)
+    {
+        unlink(e);
+        e->older = m_newest;
+        m_newest->newer = e;
+        m_newest = e;
+        if (!m_oldest) m_oldest = e;
+    }
+    return e;
+}
+
+void SegCache::insert(Entry * e)
+{
+    Entry * & bucket = m_buckets[e->hash & m_mask];
+    e->chain = bucket;
+    bucket = e;
+    e->older = m_newest;
+    if (m_newest)   m_newest->newer = e;
+    else            m_oldest = e;
+    m_newest = e;
+
+    if (++m_size <= m_maxSize)
+        return;
+
+    Entry * const victim = m_oldest;
+    Entry ** p = &m_buckets[victim->hash & m_mask];
+    while (*p != victim)
+        p = &(*p)->chain;
+    *p = victim->chain;
+    unlink(victim);
+    delete victim;
+    --m_size;
+}
+
+// Take an entry out of the recency list, leaving its hash chain alone.
+void SegCache::unlink(Entry * e)
+{
+    if (e->newer)   e->newer->older = e->older;
+    else            m_newest = e->older;
+    if (e->older)   e->older->newer = e->newer;
+    else            m_oldest = e->newer;
+    e->newer = e->older = 0;
+}
+
+void SegCache::lock() const
+{
+    while (atomic_acquire_exchange(m_lock, 1L)) {}
+}
+
+void SegCache::unlock() const
+{
+    atomic_release_store(m_lock, 0L);
+}
@@ -47,6 +47,9 @@ Segment::Segment(size_t numchars, const Face* face, uint32 script, int textDir)
   m_freeJustifies(NULL),
   m_charinfo(new CharInfo[numchars]),
   m_collisions(NULL),
+  m_charinfoSize(numchars),
+  m_collisionsSize(0),
+  m_numFeats(0),
   m_face(face),
   m_silf(face->chooseSilf(script)),
   m_first(NULL),
@@ -56,9 +59,12 @@ Segment::Segment(size_t numchars, const Face* face, uint32 script, int textDir)
   m_numCharinfo(numchars),
   m_defaultOriginal(0),
   m_dir(textDir),
-  m_flags(((m_silf->flags() & 0x20) != 0) << 1),
-  m_passBits(m_silf->aPassBits() ? -1 : 0)
+  m_flags(((m_silf->flags() & 0x20) != 0) << 1 | (face->logger() ? SEG_TRACED : 0)),
+  m_passBits(m_silf->aPassBits() ? -1 : 0),
+  m_coverageShift(GlyphCoverage::shiftFor(face->glyphs().numGlyphs()))
 {
+    // Inserted slots start out as glyph 0.
+    m_coverage.add(0, m_coverageShift);
     freeSlot(newSlot());
     m_bufSize = log_binary(numchars)+1;
 }
@@ -67,14 +73,91 @@ Segment::~Segment()
 {
     for (SlotRope::iterator i = m_slots.begin(); i != m_slots.end(); ++i)
         free(*i);
-    for (AttributeRope::iterator i = m_userAttrs.begin(); i != m_userAttrs.end(); ++i)
-        free(*i);
     for (JustifyRope::iterator i = m_justifies.begin(); i != m_justifies.end(); ++i)
         free(*i);
     delete[] m_charinfo;
     free(m_collisions);
 }
 
+// Get ready to shape new text as if freshly constructed, keeping the buffers
+// already allocated wherever they are big enough.
+void Segment::reset(size_t numchars, const Face* face, uint32 script, int textDir)
+{
+    const Silf * const silf = face->chooseSilf(script);
+    // Slot and justification buffers are laid out for one silf's counts of
+    // user attributes and justification levels.
+    const bool keep = silf->numUser() == m_silf->numUser()
+                   && silf->numJustLevels() == m_silf->numJustLevels()
+                   && !face->logger() == !(m_flags & SEG_TRACED);
+    if (keep)
+    {
+        for (Slot * s = m_first; s; s = s->next())
+            if (s->m_justs) freeJustify(s->m_justs);
+        // Free from the back, freeSlot does not unlink a slot from its neighbours.
+        while (m_last)
+        {
+            freeSlot(m_last);
+            if (m_last) m_last->next(NULL);
+        }
+    }
+    else
+    {
+        for (SlotRope::iterator i = m_slots.begin(); i != m_slots.end(); ++i)
+            free(*i);
+        for (JustifyRope::iterator i = m_justifies.begin(); i != m_justifies.end(); ++i)
+            free(*i);
+        m_slots.clear();
+        m_justifies.clear();
+        m_freeSlots = NULL;
+        m_freeJustifies = NULL;
+        m_last = NULL;
+    }
+    m_first = NULL;
+
+    if (numchars > m_charinfoSize)
+    {
+        delete[] m_charinfo;
+        m_charinfo = numchars <= ~size_t(0) / sizeof(CharInfo) ? new CharInfo[numchars] : NULL;
+        m_charinfoSize = m_charinfo ? numchars : 0;
+    }
+    else
+        for (size_t i = 0; i != numchars; ++i)
+            ::new (m_charinfo + i) CharInfo();
+
+    m_face = face;
+    m_silf = silf;
+    m_advance = Position();
+    m_numGlyphs = numchars;
+    m_numCharinfo = numchars;
+    m_numFeats = 0;
+    m_defaultOriginal = 0;
+    m_dir = textDir;
+    m_flags = ((m_silf->flags() & 0x20) != 0) << 1 | (face->logger() ? SEG_TRACED : 0);
+    m_passBits = m_silf->aPassBits() ? -1 : 0;
+    m_coverageShift = GlyphCoverage::shiftFor(face->glyphs().numGlyphs());
+    m_coverage.clear();
+    m_coverage.add(0, m_coverageShift);
+
+    // Top up the free list to what the constructor would have allocated.
+    Slot * tail = NULL;
+    size_t nfree = 0;
+    for (Slot * s = m_freeSlots; s && nfree < numchars + 10; s = s->next(), ++nfree)
+        tail = s;
+    if (nfree < numchars + 10)
+    {
+        Slot * const spare = m_freeSlots;
+        m_freeSlots = NULL;
+        m_bufSize = numchars + 10 - nfree;
+        freeSlot(newSlot());
+        if (tail)
+        {
+            tail->next(m_freeSlots);
+            m_freeSlots = spare;
+        }
+    }
+    m_bufSize = log_binary(numchars)+1;
+}
+
 void Segment::appendSlot(int id, int cid, int gid, int iFeats, size_t coffset)
 {
     Slot *aSlot = newSlot();
@@ -109,16 +192,17 @@ Slot *Segment::newSlot()
             return NULL;
         int numUser = m_silf->numUser();
 #if !defined GRAPHITE2_NTRACING
-        if (m_face->logger()) ++numUser;
+        if (m_flags & SEG_TRACED) ++numUser;
 #endif
-        Slot *newSlots = grzeroalloc<Slot>(m_bufSize);
-        int16 *newAttrs = grzeroalloc<int16>(m_bufSize * numUser);
-        if (!newSlots || !newAttrs)
-        {
-            free(newSlots);
-            free(newAttrs);
+        // The slots start on a cache line and their user attributes follow
+        // them in the same block.
+        size_t bufBytes;
+        if (checked_mul(m_bufSize, sizeof(Slot) + numUser * sizeof(int16), bufBytes))
             return NULL;
-        }
+        byte * const buf = grzeroalloc<byte>(bufBytes + SLOT_ALIGN - 1);
+        if (!buf) return NULL;
+        Slot * const newSlots = reinterpret_cast<Slot *>((uintptr(buf) + SLOT_ALIGN - 1) & ~uintptr(SLOT_ALIGN - 1));
+        int16 * const newAttrs = reinterpret_cast<int16 *>(newSlots + m_bufSize);
         for (size_t i = 0; i < m_bufSize; i++)
         {
             ::new (newSlots + i) Slot(newAttrs + i * numUser);
@@ -126,8 +210,7 @@ Slot *Segment::newSlot()
         }
         newSlots[m_bufSize - 1].next(NULL);
         newSlots[0].next(NULL);
-        m_slots.push_back(newSlots);
-        m_userAttrs.push_back(newAttrs);
+        m_slots.push_back(buf);
         m_freeSlots = (m_bufSize > 1)? newSlots + 1 : NULL;
         return newSlots;
     }
@@ -159,7 +242,7 @@ void Segment::freeSlot(Slot *aSlot)
     memset(aSlot->userAttrs(), 0, m_silf->numUser() * sizeof(int16));
     // Update generation counter for debug
 #if !defined GRAPHITE2_NTRACING
-    if (m_face->logger())
+    if (m_flags & SEG_TRACED)
         ++aSlot->userAttrs()[m_silf->numUser()];
 #endif
     // update next pointer
@@ -365,6 +448,58 @@ void Segment::associateChars(int offset, size_t numChars)
 }
 
 
+// Copy the slots of a shaped sub-segment, made from our characters starting at
+// charOffset and numbered in slot order, onto our slot list. A sub-segment left
+// reversed goes on the front, as it would have been reversed with the rest.
+bool Segment::splice(const Segment & sub, int charOffset)
+{
+    Vector<Slot *> copies;
+    for (const Slot * s = sub.m_first; s; s = s->next())
+    {
+        Slot * const c = newSlot();
+        if (!c) return false;
+        if (s->m_justs && !(c->m_justs = newJustify()))
+            return false;
+        c->set(*s, charOffset, m_silf->numUser(), m_silf->numJustLevels(), m_numCharinfo);
+        copies.push_back(c);
+    }
+    m_coverage.merge(sub.m_coverage);
+
+    const size_t n = copies.size();
+    Slot * prev = 0;
+    int i = 0;
+    for (const Slot * s = sub.m_first; s; s = s->next(), ++i)
+    {
+        Slot * const c = copies[i];
+        if (s->m_parent && s->m_parent->index() < n)    c->m_parent = copies[s->m_parent->index()];
+        if (s->m_child && s->m_child->index() < n)      c->m_child = copies[s->m_child->index()];
+        if (s->m_sibling && s->m_sibling->index() < n)  c->m_sibling = copies[s->m_sibling->index()];
+        c->prev(prev);
+        if (prev) prev->next(c);
+        prev = c;
+    }
+    if (!n) return true;
+
+    Slot * const first = copies[0], * const last = copies[n - 1];
+    if ((sub.m_dir & 64) && m_first)
+    {
+        last->next(m_first);
+        m_first->prev(last);
+        m_first = first;
+    }
+    else
+    {
+        first->prev(m_last);
+        if (m_last) m_last->next(first);
+        else        m_first = first;
+        m_last = last;
+    }
+    m_dir = sub.m_dir;
+    m_numGlyphs += n;
+    return true;
+}
+
+
 template <typename utf_iter>
 inline void process_utf_data(Segment & seg, const Face & face, const int fid, utf_iter c, size_t n_chars)
 {
@@ -411,8 +546,15 @@ void Segment::doMirror(uint16 aMirror)
 
 bool Segment::initCollisions()
 {
-    m_collisions = grzeroalloc<SlotCollision>(slotCount());
-    if (!m_collisions) return false;
+    if (!m_collisions || slotCount() > m_collisionsSize)
+    {
+        free(m_collisions);
+        m_collisionsSize = slotCount();
+        m_collisions = grzeroalloc<SlotCollision>(m_collisionsSize);
+        if (!m_collisions) return false;
+    }
+    else
+        memset(static_cast<void *>(m_collisions), 0, slotCount() * sizeof(SlotCollision));
 
     for (Slot *p = m_first; p; p = p->next())
         if (p->index() < slotCount())
@@ -421,3 +563,26 @@ bool Segment::initCollisions()
             return false;
     return true;
 }
+
+
+ShapeContext::~ShapeContext()
+{
+    for (Vector<Segment *>::iterator i = m_spares.begin(); i != m_spares.end(); ++i)
+        delete *i;
+}
+
+Segment * ShapeContext::acquire(size_t numchars, const Face * face, uint32 script, int dir)
+{
+    if (m_spares.empty())
+        return new Segment(numchars, face, script, dir);
+
+    Segment * const seg = m_spares.back();
+    m_spares.pop_back();
+    seg->reset(numchars, face, script, dir);
+    return seg;
+}
+
+void ShapeContext::release(Segment * seg)
+{
+    if (seg) m_spares.push_back(seg);
+}
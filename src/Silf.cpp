@@ -32,18 +32,45 @@ of the License or (at your option) any later version.
 #include "inc/Segment.h"
 #include "inc/Rule.h"
 #include "inc/Error.h"
+#include "inc/Parallel.h"
+#include "inc/Snapshot.h"
 
 
 using namespace graphite2;
 
-namespace { static const uint32 ERROROFFSET = 0xFFFFFFFF; }
+namespace
+{
+    static const uint32 ERROROFFSET = 0xFFFFFFFF;
+
+    // Lookup classes whose glyphs span no more than this many times their
+    // count (plus a little, for small classes) get a dense index table.
+    const unsigned int DENSE_CLASS_SPREAD = 4,
+                       DENSE_CLASS_SLACK = 32;
+
+    inline unsigned int class_hash(uint16 gid) { return (gid * 0x9E3779B1U) >> 16; }
+
+    bool readPassExtent(size_t i, size_t lSilf, size_t passes_start, const byte * const o_passes,
+                        uint32 & pass_start, uint32 & pass_end, Error & e)
+    {
+        pass_start = be::peek<uint32>(o_passes + i*sizeof(uint32));
+        pass_end   = be::peek<uint32>(o_passes + (i+1)*sizeof(uint32));
+        return !(e.test(pass_start > pass_end, E_BADPASSSTART)
+                || e.test(pass_start < passes_start, E_BADPASSSTART)
+                || e.test(pass_end > lSilf, E_BADPASSEND));
+    }
+}
 
 Silf::Silf() throw()
 : m_passes(0),
+  m_lazy(0),
   m_pseudos(0),
   m_classOffsets(0),
   m_classData(0),
+  m_classLookups(0),
+  m_classIndex(0),
   m_justs(0),
+  m_inertGlyphs(0),
+  m_numInertGlyphs(0),
   m_numPasses(0),
   m_numJusts(0),
   m_sPass(0),
@@ -64,7 +91,8 @@ Silf::Silf() throw()
   m_numPseudo(0),
   m_nClass(0),
   m_nLinear(0),
-  m_gEndLine(0)
+  m_gEndLine(0),
+  m_compile(false)
 {
     memset(&m_silfinfo, 0, sizeof m_silfinfo);
 }
@@ -77,23 +105,38 @@ Silf::~Silf() throw()
 void Silf::releaseBuffers() throw()
 {
     delete [] m_passes;
+    if (m_lazy)
+    {
+        for (size_t i = 0; i < m_numPasses; ++i)
+            delete m_lazy->passes[i];
+        free(m_lazy->passes);
+        free(m_lazy);
+    }
     delete [] m_pseudos;
     free(m_classOffsets);
     free(m_classData);
+    free(m_classLookups);
+    free(m_classIndex);
     free(m_justs);
+    free(m_inertGlyphs);
     m_passes= 0;
+    m_lazy = 0;
     m_pseudos = 0;
     m_classOffsets = 0;
     m_classData = 0;
+    m_classLookups = 0;
+    m_classIndex = 0;
     m_justs = 0;
+    m_inertGlyphs = 0;
 }
 
 
-bool Silf::readGraphite(const byte * const silf_start, size_t lSilf, Face& face, uint32 version)
+bool Silf::readGraphite(const byte * const silf_start, size_t lSilf, Face& face, uint32 version, uint32 faceOptions)
 {
     const byte * p = silf_start,
                * const silf_end = p + lSilf;
     Error e;
+    m_compile = (faceOptions & gr_face_jit) != 0;
 
     if (e.test(version >= 0x00060000, E_BADSILFVERSION))
     {
@@ -190,43 +233,331 @@ bool Silf::readGraphite(const byte * const silf_start, size_t lSilf, Face& face,
     }
 
     const size_t clen = readClassMap(p, passes_start + silf_start - p, version, e);
-    m_passes = new Pass[m_numPasses];
-    if (e || e.test(clen > unsigned(passes_start + silf_start - p), E_BADPASSESSTART)
-          || e.test(!m_passes, E_OUTOFMEM))
+    if (e || e.test(clen > unsigned(passes_start + silf_start - p), E_BADPASSESSTART))
     { releaseBuffers(); return face.error(e); }
 
-    for (size_t i = 0; i < m_numPasses; ++i)
+    if ((faceOptions & gr_face_lazyPasses) && m_numPasses)
     {
-        uint32 pass_start = be::read<uint32>(o_passes);
-        uint32 pass_end = be::peek<uint32>(o_passes);
-        face.error_context((face.error_context() & 0xFF00) + EC_ASILF + unsigned(i << 16));
-        if (e.test(pass_start > pass_end, E_BADPASSSTART)
-                || e.test(pass_start < passes_start, E_BADPASSSTART)
-                || e.test(pass_end > lSilf, E_BADPASSEND)) {
+        // Only check where each pass lies, the caller keeps the table alive
+        // and decodePass() reads a pass the first time it is run.
+        for (size_t i = 0; i < m_numPasses; ++i)
+        {
+            uint32 pass_start, pass_end;
+            face.error_context((face.error_context() & 0xFF00) + EC_ASILF + unsigned(i << 16));
+            if (!readPassExtent(i, lSilf, passes_start, o_passes, pass_start, pass_end, e))
+            {
+                releaseBuffers(); return face.error(e);
+            }
+        }
+        Pass ** const passes = grzeroalloc<Pass *>(m_numPasses);
+        m_lazy = gralloc<LazyPasses>(1);
+        if (e.test(!passes || !m_lazy, E_OUTOFMEM))
+        {
+            free(passes); free(m_lazy); m_lazy = 0;
             releaseBuffers(); return face.error(e);
         }
+        const LazyPasses l = { &face, silf_start, o_passes, lSilf, passes_start, version, passes };
+        *m_lazy = l;
+        fillSilfInfo(face);
+        return true;
+    }
 
-        enum passtype pt = PASS_TYPE_UNKNOWN;
-        if (i >= m_jPass) pt = PASS_TYPE_JUSTIFICATION;
-        else if (i >= m_pPass) pt = PASS_TYPE_POSITIONING;
-        else if (i >= m_sPass) pt = PASS_TYPE_SUBSTITUTE;
-        else pt = PASS_TYPE_LINEBREAK;
+    m_passes = new Pass[m_numPasses];
+    if (e.test(!m_passes, E_OUTOFMEM)) { releaseBuffers(); return face.error(e); }
 
-        m_passes[i].init(this);
-        if (!m_passes[i].readPass(silf_start + pass_start, pass_end - pass_start, pass_start, face, pt,
-            version, e))
+    if ((faceOptions & gr_face_parallelLoad) && m_numPasses > 1)
+    {
+        if (!readPassesParallel(silf_start, lSilf, passes_start, o_passes, face, version))
         {
             releaseBuffers();
             return false;
         }
     }
+    else
+    {
+        for (size_t i = 0; i < m_numPasses; ++i)
+        {
+            if (!readPass(m_passes[i], i, silf_start, lSilf, passes_start, o_passes, face, version))
+            {
+                releaseBuffers();
+                return false;
+            }
+        }
+    }
+
+    findInertGlyphs(face);
+    fillSilfInfo(face);
+    return true;
+}
+
+bool Silf::readPass(Pass & pass, size_t i, const byte * const silf_start, size_t lSilf, size_t passes_start,
+                    const byte * const o_passes, Face & face, uint32 version) const
+{
+    Error e;
+    uint32 pass_start, pass_end;
+    face.error_context((face.error_context() & 0xFF00) + EC_ASILF + unsigned(i << 16));
+    if (!readPassExtent(i, lSilf, passes_start, o_passes, pass_start, pass_end, e))
+        return face.error(e);
+
+    enum passtype pt = PASS_TYPE_UNKNOWN;
+    if (i >= m_jPass) pt = PASS_TYPE_JUSTIFICATION;
+    else if (i >= m_pPass) pt = PASS_TYPE_POSITIONING;
+    else if (i >= m_sPass) pt = PASS_TYPE_SUBSTITUTE;
+    else pt = PASS_TYPE_LINEBREAK;
+
+    pass.init(this);
+    if (!pass.readPass(silf_start + pass_start, pass_end - pass_start, pass_start, face, pt,
+        version, e))
+        return false;
+    if (m_compile)
+        pass.compile();
+    return true;
+}
+
+// Racing threads decode identical copies of a pass, the first one published
+// is kept. A pass that fails to decode sets the face's error and is tried
+// again the next time it is needed.
+const Pass * Silf::decodePass(size_t i) const
+{
+    const LazyPasses & l = *m_lazy;
+    Error e;
+    Pass * p = new Pass();
+    if (e.test(!p, E_OUTOFMEM)) { l.face->error(e); return 0; }
+    if (!readPass(*p, i, l.silf_start, l.lSilf, l.passes_start, l.o_passes, *l.face, l.version))
+    {
+        delete p;
+        return 0;
+    }
+    Pass * const q = atomic_publish(l.passes[i], p);
+    if (q != p) delete p;
+    return q;
+}
 
-    // fill in gr_faceinfo
+struct Silf::PassLoad
+{
+    Silf          * silf;
+    const byte    * silf_start;
+    size_t          lSilf,
+                    passes_start;
+    const byte    * o_passes;
+    Face          * face;
+    uint32          version;
+    bool          * loaded;
+};
+
+void Silf::readPassJob(void * data, unsigned int i)
+{
+    PassLoad & l = *static_cast<PassLoad *>(data);
+    l.loaded[i] = l.silf->readPass(l.silf->m_passes[i], i, l.silf_start, l.lSilf, l.passes_start, l.o_passes, *l.face, l.version);
+}
+
+// Passes only share read only state, so they can be decoded side by side. If
+// any fail the first failure is read again on its own, leaving the face's
+// error exactly as a serial load would.
+bool Silf::readPassesParallel(const byte * const silf_start, size_t lSilf, size_t passes_start,
+                              const byte * const o_passes, Face & face, uint32 version)
+{
+    Error e;
+    bool * const loaded = grzeroalloc<bool>(m_numPasses);
+    if (e.test(!loaded, E_OUTOFMEM)) return face.error(e);
+
+    e.error(face.error());
+    PassLoad job = { this, silf_start, lSilf, passes_start, o_passes, &face, version, loaded };
+    parallel_for(m_numPasses, &readPassJob, &job);
+
+    size_t i = 0;
+    while (i < m_numPasses && loaded[i]) ++i;
+    free(loaded);
+    if (i == m_numPasses) return true;
+
+    face.error(e);
+    m_passes[i].~Pass();
+    ::new (m_passes + i) Pass();
+    return readPass(m_passes[i], i, silf_start, lSilf, passes_start, o_passes, face, version);
+}
+
+void Silf::fillSilfInfo(const Face & face) throw()
+{
     m_silfinfo.upem = face.glyphs().unitsPerEm();
     m_silfinfo.has_bidi_pass = (m_bPass != 0xFF);
     m_silfinfo.justifies = (m_numJusts != 0) || (m_jPass < m_pPass);
     m_silfinfo.line_ends = (m_flags & 1);
     m_silfinfo.space_contextuals = gr_faceinfo::gr_space_contextuals((m_flags >> 2) & 0x7);
+}
+
+// Find glyphs that, in a run made only of them, no rule in any pass can
+// match with the default features, so such runs can skip the passes. Rules
+// whose constraint fails for those features are left out. Glyphs are taken
+// greedily in glyph id order, which puts the common letters of most fonts
+// first. Lazily decoded passes are not walked, leaving every segment to go
+// through the passes.
+void Silf::findInertGlyphs(const Face & face) throw()
+{
+    const uint16 n = face.glyphs().numGlyphs();
+    const FeatureMap & fmap = face.theSill().theFeatureMap();
+    const FeatureVal & feats = face.theSill().defaultFeatures();
+    Pass::InertGlyphs ** const passes = grzeroalloc<Pass::InertGlyphs *>(m_numPasses + 1);
+    bool ok = passes && (m_inertGlyphs = grzeroalloc<uint32>((n + 31) >> 5 ? (n + 31) >> 5 : 1));
+    for (size_t i = 0; ok && i < m_numPasses; ++i)
+        ok = (passes[i] = new Pass::InertGlyphs(m_passes[i], fmap, feats)) && *passes[i];
+
+    if (ok)
+    {
+        m_numInertGlyphs = n;
+        for (uint16 gid = 0; gid != n; ++gid)
+        {
+            // Check what is already known before walking any pass's states.
+            size_t i = 0;
+            while (i < m_numPasses && !passes[i]->refuses(gid)) ++i;
+            if (i != m_numPasses)   continue;
+            i = 0;
+            while (i < m_numPasses && passes[i]->admit(gid)) ++i;
+            const bool inert = i == m_numPasses;
+            for (i = 0; i < m_numPasses; ++i)
+                passes[i]->settle(inert);
+            if (inert)
+                m_inertGlyphs[gid >> 5] |= 1U << (gid & 31);
+        }
+    }
+    else
+    {
+        free(m_inertGlyphs);
+        m_inertGlyphs = 0;
+    }
+
+    if (passes)
+        for (size_t i = 0; i < m_numPasses; ++i)
+            delete passes[i];
+    free(passes);
+}
+
+bool Silf::writeImage(SnapshotWriter & w) const
+{
+    w.write(m_numPasses);
+    w.write(m_numJusts);
+    w.write(m_sPass);
+    w.write(m_pPass);
+    w.write(m_jPass);
+    w.write(m_bPass);
+    w.write(m_flags);
+    w.write(m_dir);
+    w.write(m_aPseudo);
+    w.write(m_aBreak);
+    w.write(m_aUser);
+    w.write(m_aBidi);
+    w.write(m_aMirror);
+    w.write(m_aPassBits);
+    w.write(m_iMaxComp);
+    w.write(m_aCollision);
+    w.write(m_aLig);
+    w.write(m_numPseudo);
+    w.write(m_nClass);
+    w.write(m_nLinear);
+    w.write(m_gEndLine);
+    w.write(m_silfinfo.extra_ascent);
+    w.write(m_silfinfo.extra_descent);
+
+    w.write(m_justs, m_numJusts * sizeof(Justinfo));
+    for (const Pseudo * p = m_pseudos, * const pe = p + m_numPseudo; p != pe; ++p)
+    {
+        w.write(p->uid);
+        w.write(p->gid);
+    }
+    const uint32 class_data_sz = m_classOffsets ? m_classOffsets[m_nClass] : 0;
+    w.write(class_data_sz);
+    w.write(m_classOffsets, m_classOffsets ? (m_nClass + 1) * sizeof(uint32) : 0);
+    w.write(m_classData, class_data_sz * sizeof(uint16));
+
+    for (size_t i = 0; i < m_numPasses; ++i)
+    {
+        const Pass * const p = pass(i);
+        if (!p || !p->writeImage(w)) return false;
+    }
+    return true;
+}
+
+// The image is checked as readGraphite and readClassMap check the font.
+bool Silf::readImage(SnapshotReader & r, const Face & face, uint32 faceOptions)
+{
+    m_compile = (faceOptions & gr_face_jit) != 0;
+    m_numPasses  = r.read<uint8>();
+    m_numJusts   = r.read<uint8>();
+    m_sPass      = r.read<uint8>();
+    m_pPass      = r.read<uint8>();
+    m_jPass      = r.read<uint8>();
+    m_bPass      = r.read<uint8>();
+    m_flags      = r.read<uint8>();
+    m_dir        = r.read<uint8>();
+    m_aPseudo    = r.read<uint8>();
+    m_aBreak     = r.read<uint8>();
+    m_aUser      = r.read<uint8>();
+    m_aBidi      = r.read<uint8>();
+    m_aMirror    = r.read<uint8>();
+    m_aPassBits  = r.read<uint8>();
+    m_iMaxComp   = r.read<uint8>();
+    m_aCollision = r.read<uint8>();
+    m_aLig       = r.read<uint16>();
+    m_numPseudo  = r.read<uint16>();
+    m_nClass     = r.read<uint16>();
+    m_nLinear    = r.read<uint16>();
+    m_gEndLine   = r.read<uint16>();
+    m_silfinfo.extra_ascent  = r.read<uint16>();
+    m_silfinfo.extra_descent = r.read<uint16>();
+
+    const size_t num_attrs = face.glyphs().numAttrs();
+    if (!r.test(m_aPseudo >= num_attrs || m_aBreak >= num_attrs
+                || m_aBidi >= num_attrs || m_aMirror >= num_attrs
+                || (m_aCollision && m_aCollision >= num_attrs - 5)
+                || m_numPasses > 128
+                || m_pPass < m_sPass || m_pPass > m_numPasses || m_sPass > m_numPasses
+                || m_jPass < m_pPass || m_jPass > m_numPasses
+                || (m_bPass != 0xFF && (m_bPass < m_jPass || m_bPass > m_numPasses))
+                || m_aLig > 127 || m_nLinear > m_nClass))
+        return false;
+
+    if (m_numJusts)
+        m_justs = r.readArray<Justinfo>(m_numJusts);
+    m_pseudos = new Pseudo[m_numPseudo];
+    if (!r.test(!m_pseudos))    return false;
+    for (Pseudo * p = m_pseudos, * const pe = p + m_numPseudo; p != pe; ++p)
+    {
+        p->uid = r.read<uint32>();
+        p->gid = r.read<uint32>();
+    }
+
+    const uint32 class_data_sz = r.read<uint32>();
+    m_classOffsets = r.readArray<uint32>(m_nClass + 1);
+    m_classData    = r.readArray<uint16>(class_data_sz);
+    if (!r || !r.test(m_classOffsets[m_nClass] != class_data_sz))
+        return false;
+    for (const uint32 * o = m_classOffsets, * const o_end = o + m_nClass; o != o_end; ++o)
+        if (!r.test(*o > class_data_sz || (o < m_classOffsets + m_nLinear && o[0] > o[1])))
+            return false;
+    for (const uint32 * o = m_classOffsets + m_nLinear, * const o_end = m_classOffsets + m_nClass; o != o_end; ++o)
+    {
+        const uint16 * lookup = m_classData + *o;
+        if (!r.test(*o + 4 > class_data_sz
+                    || lookup[0] == 0
+                    || lookup[0] * 2 + *o + 4 > class_data_sz
+                    || lookup[3] + lookup[1] != lookup[0]
+                    || ((o[1] - *o) & 1) != 0))
+            return false;
+    }
+    if (!r.test(!buildClassIndex()))
+        return false;
+
+    m_passes = new Pass[m_numPasses];
+    if (!r.test(!m_passes))     return false;
+    for (Pass * p = m_passes, * const pe = p + m_numPasses; p != pe; ++p)
+    {
+        p->init(this);
+        if (!p->readImage(r))   return false;
+        if (m_compile)
+            p->compile();
+    }
+
+    findInertGlyphs(face);
+    fillSilfInfo(face);
     return true;
 }
 
@@ -299,9 +630,87 @@ size_t Silf::readClassMap(const byte *p, size_t data_len, uint32 version, Error
             return ERROROFFSET;
     }
 
+    if (e.test(!buildClassIndex(), E_OUTOFMEM)) return ERROROFFSET;
     return max_off;
 }
 
+// Build a direct index for every lookup class with its glyphs in order, so
+// findClassIndex is a single load or, for sparse classes, a short probe.
+bool Silf::buildClassIndex() throw()
+{
+    const unsigned int nlookup = m_nClass - m_nLinear;
+    if (nlookup == 0) return true;
+
+    m_classLookups = gralloc<ClassLookup>(nlookup);
+    if (!m_classLookups) return false;
+
+    size_t size = 0;
+    for (unsigned int i = 0; i < nlookup; ++i)
+    {
+        const uint16 * const cls = m_classData + m_classOffsets[m_nLinear + i],
+                     * const lookups = cls + 4;
+        const unsigned int n = cls[0];
+        ClassLookup & cl = m_classLookups[i];
+        cl.offset = ~0U;
+        cl.base = lookups[0];
+        cl.mask = 0;
+        cl.hashed = false;
+        if (n == 0) continue;
+
+        // The binary search in findClassIndex only means anything for glyphs
+        // in ascending order; leave any other class to it.
+        unsigned int j = 1;
+        while (j < n && lookups[2*j] > lookups[2*j - 2]) ++j;
+        if (j < n) continue;
+
+        const unsigned int span = lookups[2*n - 2] - cl.base + 1;
+        cl.offset = uint32(size);
+        if (span <= n * DENSE_CLASS_SPREAD + DENSE_CLASS_SLACK)
+        {
+            cl.mask = uint16(span - 1);
+            size += span;
+        }
+        else
+        {
+            unsigned int slots = 2;
+            while (slots < 2*n) slots <<= 1;
+            cl.mask = uint16(slots - 1);
+            cl.hashed = true;
+            size += 2*slots;
+        }
+    }
+
+    if (size == 0) return true;
+    m_classIndex = gralloc<uint16>(size);
+    if (!m_classIndex) return false;
+    memset(m_classIndex, 0xFF, size * sizeof(uint16));
+
+    for (unsigned int i = 0; i < nlookup; ++i)
+    {
+        const ClassLookup & cl = m_classLookups[i];
+        if (cl.offset == ~0U) continue;
+
+        const uint16 * const cls = m_classData + m_classOffsets[m_nLinear + i];
+        uint16 * const index = m_classIndex + cl.offset;
+        for (const uint16 * l = cls + 4, * const le = l + 2*cls[0]; l != le; l += 2)
+        {
+            if (!cl.hashed)
+            {
+                index[l[0] - cl.base] = l[1];
+                continue;
+            }
+            // An index of 0xFFFF marks an empty slot and reads as not found
+            // anyway, so such entries need not be stored.
+            if (l[1] == 0xFFFF) continue;
+            unsigned int h = class_hash(l[0]) & cl.mask;
+            while (index[2*h + 1] != 0xFFFF) h = (h + 1) & cl.mask;
+            index[2*h] = l[0];
+            index[2*h + 1] = l[1];
+        }
+    }
+    return true;
+}
+
 uint16 Silf::findPseudo(uint32 uid) const
 {
     for (int i = 0; i < m_numPseudo; i++)
@@ -311,7 +720,7 @@ uint16 Silf::findPseudo(uint32 uid) const
 
 uint16 Silf::findClassIndex(uint16 cid, uint16 gid) const
 {
-    if (cid > m_nClass) return -1;
+    if (cid >= m_nClass) return -1;
 
     const uint16 * cls = m_classData + m_classOffsets[cid];
     if (cid < m_nLinear)        // output class being used for input, shouldn't happen
@@ -320,6 +729,20 @@ uint16 Silf::findClassIndex(uint16 cid, uint16 gid) const
             if (*cls == gid) return i;
         return -1;
     }
+
+    const ClassLookup & cl = m_classLookups[cid - m_nLinear];
+    if (cl.offset != ~0U)
+    {
+        const uint16 * const index = m_classIndex + cl.offset;
+        if (!cl.hashed)
+        {
+            const unsigned int i = uint16(gid - cl.base);
+            return i <= cl.mask ? index[i] : uint16(-1);
+        }
+        for (unsigned int h = class_hash(gid) & cl.mask; index[2*h + 1] != 0xFFFF; h = (h + 1) & cl.mask)
+            if (index[2*h] == gid) return index[2*h + 1];
+        return -1;
+    }
     else
     {
         const uint16 *  min = cls + 4,      // lookups array
@@ -354,17 +777,44 @@ uint16 Silf::getClassGlyph(uint16 cid, unsigned int index) const
 }
 
 
+// Whether the passes would leave seg as it is: with the default features no
+// rule can match a run of its glyphs, none of them takes part in collision
+// fixing and no reordering or mirroring is due.
+bool Silf::bypasses(const Segment & seg) const
+{
+    if (!m_inertGlyphs || seg.currdir() != (m_dir & 1)
+        || (m_bPass != 0xFF && m_aMirror && (seg.dir() & 3) == 3)
+        || !seg.allFeaturesAre(seg.getFace()->theSill().defaultFeatures()))
+        return false;
+    for (const Slot * s = seg.first(); s; s = s->next())
+    {
+        const uint16 gid = s->gid();
+        if (gid >= m_numInertGlyphs || !(m_inertGlyphs[gid >> 5] & (1U << (gid & 31)))
+            || (m_aCollision && seg.glyphAttr(gid, m_aCollision)))
+            return false;
+    }
+    return true;
+}
+
+bool Silf::runGraphite(Segment *seg, uint8 firstPass, uint8 lastPass, int dobidi) const
+{
+#if !defined GRAPHITE2_NTRACING
+    if (seg->getFace()->logger())
+        return runGraphite<true>(seg, firstPass, lastPass, dobidi);
+#endif
+    return runGraphite<false>(seg, firstPass, lastPass, dobidi);
+}
+
+template <bool traced>
 bool Silf::runGraphite(Segment *seg, uint8 firstPass, uint8 lastPass, int dobidi) const
 {
     assert(seg != 0);
+    json * const       dbgout = seg->getFace()->logger();
     size_t             maxSize = seg->slotCount() * MAX_SEG_GROWTH_FACTOR;
     SlotMap            map(*seg, m_dir, maxSize);
-    FiniteStateMachine fsm(map, seg->getFace()->logger());
+    FiniteStateMachine fsm(map, traced ? dbgout : 0);
     vm::Machine        m(map);
     uint8              lbidi = m_bPass;
-#if !defined GRAPHITE2_NTRACING
-    json * const dbgout = seg->getFace()->logger();
-#endif
 
     if (lastPass == 0)
     {
@@ -383,7 +833,7 @@ bool Silf::runGraphite(Segment *seg, uint8 firstPass, uint8 lastPass, int dobidi
         if (i == lbidi)
         {
 #if !defined GRAPHITE2_NTRACING
-            if (dbgout)
+            if (traced && dbgout)
             {
                 *dbgout << json::item << json::object
 //							<< "pindex" << i   // for debugging
@@ -409,14 +859,17 @@ bool Silf::runGraphite(Segment *seg, uint8 firstPass, uint8 lastPass, int dobidi
         continue;
         }
 
+        const Pass * const p = pass(i);
+        if (!p) return false;
+
 #if !defined GRAPHITE2_NTRACING
-        if (dbgout)
+        if (traced && dbgout)
         {
             *dbgout << json::item << json::object
 //						<< "pindex" << i   // for debugging
                         << "id"     << i+1
                         << "slotsdir" << (seg->currdir() ? "rtl" : "ltr")
-                        << "passdir" << ((m_dir & 1) ^ m_passes[i].reverseDir() ? "rtl" : "ltr")
+                        << "passdir" << ((m_dir & 1) ^ p->reverseDir() ? "rtl" : "ltr")
                         << "slots"  << json::array;
             seg->positionSlots(0, 0, 0, seg->currdir());
             for(Slot * s = seg->first(); s; s = s->next())
@@ -426,9 +879,12 @@ bool Silf::runGraphite(Segment *seg, uint8 firstPass, uint8 lastPass, int dobidi
 #endif
 
         // test whether to reorder, prepare for positioning
-        bool reverse = (lbidi == 0xFF) && (seg->currdir() != ((m_dir & 1) ^ m_passes[i].reverseDir()));
-        if ((i >= 32 || (seg->passBits() & (1 << i)) == 0 || m_passes[i].collisionLoops())
-                && !m_passes[i].runGraphite(m, fsm, reverse))
+        bool reverse = (lbidi == 0xFF) && (seg->currdir() != ((m_dir & 1) ^ p->reverseDir()));
+        // Skip passes that cannot match anything in the segment, unless tracing
+        // where every pass should show up.
+        if ((i >= 32 || (seg->passBits() & (1 << i)) == 0 || p->collisionLoops())
+                && (traced || p->mayChange(seg->coverage()))
+                && !p->runGraphite<traced>(m, fsm, reverse))
             return false;
         // only subsitution passes can change segment length, cached subsegments are short for their text
         if (m.status() != vm::Machine::finished
@@ -437,3 +893,6 @@ bool Silf::runGraphite(Segment *seg, uint8 firstPass, uint8 lastPass, int dobidi
     }
     return true;
 }
+
+template bool Silf::runGraphite<false>(Segment *, uint8, uint8, int) const;
+template bool Silf::runGraphite<true>(Segment *, uint8, uint8, int) const;
@@ -0,0 +1,224 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2015, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#include "inc/SliceEdges.h"
+
+// As for AxisBounds, only where scalar floats are done in SSE registers too.
+// SSE2 is always there on such builds, so no need to ask the CPU.
+#if ((defined(__GNUC__) || defined(__clang__)) && defined(__SSE2_MATH__) \
+     && (defined(__x86_64__) || defined(__i386__))) \
+    || (defined(_MSC_VER) && defined(_M_X64))
+  #include <emmintrin.h>
+  #define HAVE_SSE
+#endif
+
+using namespace graphite2;
+
+namespace
+{
+    inline
+    float localmax(float al, float au, float bl, float bu, float x)
+    {
+        if (al < bl)
+        { if (au < bu) return au < x ? au : x; }
+        else if (au > bu) return bl < x ? bl : x;
+        return x;
+    }
+
+    inline
+    float localmin(float al, float au, float bl, float bu, float x)
+    {
+        if (bl > al)
+        { if (bu > au) return bl > x ? bl : x; }
+        else if (au > bu) return al > x ? al : x;
+        return x;
+    }
+
+    // The edge in the slice centred on y, given the edge so far in res.
+    inline
+    float box_edge(const SliceRun & r, float y, const BBox & bb, const SlantBox & sb, bool sub,
+                   float sx, float sy, float res)
+    {
+        const float width = r.width, margin = r.margin;
+        if (sy + bb.yi - margin > y + width / 2 || sy + bb.ya + margin < y - width / 2)
+            return res;
+        if (sub)
+        {
+            if (r.right)
+            {
+                float x = sx + bb.xa + margin;
+                if (x > res)
+                {
+                    float td = sx - sy + sb.da + margin + y;
+                    float ts = sx + sy + sb.sa + margin - y;
+                    x = localmax(td - width / 2, td + width / 2,  ts - width / 2, ts + width / 2, x);
+                    if (x > res)
+                        res = x;
+                }
+            }
+            else
+            {
+                float x = sx + bb.xi - margin;
+                if (x < res)
+                {
+                    float td = sx - sy + sb.di - margin + y;
+                    float ts = sx + sy + sb.si - margin - y;
+                    x = localmin(td - width / 2, td + width / 2, ts - width / 2, ts + width / 2, x);
+                    if (x < res)
+                        res = x;
+                }
+            }
+            return res;
+        }
+        float td = sx - sy + y;
+        float ts = sx + sy - y;
+        if (r.right)
+            return localmax(td + sb.da - width / 2, td + sb.da + width / 2, ts + sb.sa - width / 2, ts + sb.sa + width / 2, sx + bb.xa) + margin;
+        else
+            return localmin(td + sb.di - width / 2, td + sb.di + width / 2, ts + sb.si - width / 2, ts + sb.si + width / 2, sx + bb.xi) - margin;
+    }
+
+    void edges_scalar(const SliceRun & r, int first, int n, const BBox & bb, const SlantBox & sb, bool sub,
+                      float sx, float sy, float * edges) throw()
+    {
+        for (int k = 0; k < n; ++k)
+            edges[k] = box_edge(r, r.base + (first + k + .5f) * r.width, bb, sb, sub, sx, sy, edges[k]);
+    }
+
+#if defined HAVE_SSE
+    inline __m128 select(__m128 m, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+    }
+
+    // _mm_min_ps(a, x) and _mm_max_ps(a, x) pick just as a < x ? a : x and
+    // a > x ? a : x do.
+    inline __m128 localmax(__m128 al, __m128 au, __m128 bl, __m128 bu, __m128 x)
+    {
+        return select(_mm_cmplt_ps(al, bl),
+                      select(_mm_cmplt_ps(au, bu), _mm_min_ps(au, x), x),
+                      select(_mm_cmpgt_ps(au, bu), _mm_min_ps(bl, x), x));
+    }
+
+    inline __m128 localmin(__m128 al, __m128 au, __m128 bl, __m128 bu, __m128 x)
+    {
+        return select(_mm_cmpgt_ps(bl, al),
+                      select(_mm_cmpgt_ps(bu, au), _mm_max_ps(bl, x), x),
+                      select(_mm_cmpgt_ps(au, bu), _mm_max_ps(al, x), x));
+    }
+
+    // Four slices at a time, the rest as edges_scalar does them.  A sub-box
+    // only ever narrows localmax() or localmin() towards its x, so testing
+    // the result against the edge so far skips just what box_edge() skips by
+    // testing x first.
+    void edges_sse(const SliceRun & r, int first, int n, const BBox & bb, const SlantBox & sb, bool sub,
+                   float sx, float sy, float * edges) throw()
+    {
+        const float width = r.width, margin = r.margin;
+        const __m128 w = _mm_set1_ps(width),
+                     w2 = _mm_set1_ps(width / 2),
+                     base = _mm_set1_ps(r.base),
+                     lo = _mm_set1_ps(sy + bb.yi - margin),
+                     hi = _mm_set1_ps(sy + bb.ya + margin);
+        __m128 x, td0, ts0;
+        if (sub)
+        {
+            x   = _mm_set1_ps(r.right ? sx + bb.xa + margin : sx + bb.xi - margin);
+            td0 = _mm_set1_ps(r.right ? sx - sy + sb.da + margin : sx - sy + sb.di - margin);
+            ts0 = _mm_set1_ps(r.right ? sx + sy + sb.sa + margin : sx + sy + sb.si - margin);
+        }
+        else
+        {
+            x   = _mm_set1_ps(r.right ? sx + bb.xa : sx + bb.xi);
+            td0 = _mm_set1_ps(sx - sy);
+            ts0 = _mm_set1_ps(sx + sy);
+        }
+        const __m128 ds = _mm_set1_ps(r.right ? sb.da : sb.di),
+                     ss = _mm_set1_ps(r.right ? sb.sa : sb.si),
+                     m = _mm_set1_ps(margin);
+
+        int k = 0;
+        for (; k + 4 <= n; k += 4)
+        {
+            const __m128 i = _mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(first + k),
+                                                                      _mm_setr_epi32(0, 1, 2, 3))),
+                                        _mm_set1_ps(.5f));
+            const __m128 y = _mm_add_ps(base, _mm_mul_ps(i, w));
+            const __m128 out = _mm_or_ps(_mm_cmpgt_ps(lo, _mm_add_ps(y, w2)),
+                                         _mm_cmplt_ps(hi, _mm_sub_ps(y, w2)));
+            const __m128 res = _mm_loadu_ps(edges + k);
+            __m128 td = _mm_add_ps(td0, y),
+                   ts = _mm_sub_ps(ts0, y),
+                   e;
+            if (sub)
+            {
+                if (r.right)
+                {
+                    e = localmax(_mm_sub_ps(td, w2), _mm_add_ps(td, w2), _mm_sub_ps(ts, w2), _mm_add_ps(ts, w2), x);
+                    e = select(_mm_andnot_ps(out, _mm_cmpgt_ps(e, res)), e, res);
+                }
+                else
+                {
+                    e = localmin(_mm_sub_ps(td, w2), _mm_add_ps(td, w2), _mm_sub_ps(ts, w2), _mm_add_ps(ts, w2), x);
+                    e = select(_mm_andnot_ps(out, _mm_cmplt_ps(e, res)), e, res);
+                }
+            }
+            else
+            {
+                td = _mm_add_ps(td, ds);
+                ts = _mm_add_ps(ts, ss);
+                if (r.right)
+                    e = _mm_add_ps(localmax(_mm_sub_ps(td, w2), _mm_add_ps(td, w2), _mm_sub_ps(ts, w2), _mm_add_ps(ts, w2), x), m);
+                else
+                    e = _mm_sub_ps(localmin(_mm_sub_ps(td, w2), _mm_add_ps(td, w2), _mm_sub_ps(ts, w2), _mm_add_ps(ts, w2), x), m);
+                e = select(out, res, e);
+            }
+            _mm_storeu_ps(edges + k, e);
+        }
+        edges_scalar(r, first + k, n - k, bb, sb, sub, sx, sy, edges + k);
+    }
+#endif
+}
+
+
+slice_edges_fn graphite2::slice_edges(slice_edges_kind kind) throw()
+{
+    switch (kind)
+    {
+    case SLICE_EDGES_SCALAR:
+        return edges_scalar;
+#if defined HAVE_SSE
+    case SLICE_EDGES_SSE:
+    case SLICE_EDGES_BEST:
+        return edges_sse;
+#else
+    case SLICE_EDGES_BEST:
+        return edges_scalar;
+#endif
+    default:
+        return 0;
+    }
+}
@@ -36,12 +36,15 @@ using namespace graphite2;
 
 Slot::Slot(int16 *user_attrs) :
     m_next(NULL), m_prev(NULL),
-    m_glyphid(0), m_realglyphid(0), m_original(0), m_before(0), m_after(0),
-    m_index(0), m_parent(NULL), m_child(NULL), m_sibling(NULL),
-    m_position(0, 0), m_shift(0, 0), m_advance(0, 0),
-    m_attach(0, 0), m_with(0, 0), m_just(0.),
+    m_parent(NULL), m_child(NULL), m_sibling(NULL),
+    m_userAttr(user_attrs),
+    m_glyphid(0), m_realglyphid(0),
     m_flags(0), m_attLevel(0), m_bidiCls(-1), m_bidiLevel(0),
-    m_userAttr(user_attrs), m_justs(NULL)
+    m_original(0), m_col(UNCLASSIFIED),
+    m_position(0, 0), m_shift(0, 0), m_advance(0, 0),
+    m_attach(0, 0), m_with(0, 0),
+    m_before(0), m_after(0), m_just(0.), m_index(0),
+    m_justs(NULL)
 {
 }
 
@@ -51,6 +54,7 @@ void Slot::set(const Slot & orig, int charOffset, size_t sizeAttr, size_t justLe
     // leave m_next and m_prev unchanged
     m_glyphid = orig.m_glyphid;
     m_realglyphid = orig.m_realglyphid;
+    m_col = orig.m_col;
     m_original = orig.m_original + charOffset;
     if (charOffset + int(orig.m_before) < 0)
         m_before = 0;
@@ -452,6 +456,8 @@ bool Slot::removeChild(Slot *ap)
 void Slot::setGlyph(Segment *seg, uint16 glyphid, const GlyphFace * theGlyph)
 {
     m_glyphid = glyphid;
+    m_col = UNCLASSIFIED;
+    seg->addCoverage(glyphid);
     m_bidiCls = -1;
     if (!theGlyph)
     {
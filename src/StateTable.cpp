@@ -0,0 +1,287 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#include <cstdlib>
+#include <cstring>
+#include "inc/StateTable.h"
+#include "inc/bits.h"
+
+using namespace graphite2;
+
+namespace
+{
+    const uint16 NO_ROW = 0xFFFF;
+
+    uint32 hash_page(const uint16 * p)
+    {
+        uint32 h = 0;
+        for (unsigned int i = 0; i != ColumnMap::PAGE_SIZE; ++i)
+            h = (h ^ p[i]) * 0x01000193U;
+        return h;
+    }
+
+    // Row keys sort rows with the most entries first.
+    int cmp_row_keys(const void * a, const void * b)
+    {
+        const uint32 ka = *static_cast<const uint32 *>(a),
+                     kb = *static_cast<const uint32 *>(b);
+        return ka < kb ? 1 : (kb < ka ? -1 : 0);
+    }
+}
+
+
+ColumnMap::~ColumnMap() throw()
+{
+    free(m_pages);
+    free(m_cols);
+}
+
+bool ColumnMap::build(uint16 * cols, uint16 num_glyphs) throw()
+{
+    free(m_pages);
+    free(m_cols);
+    m_pages = m_cols = 0;
+    m_numGlyphs = m_numPages = 0;
+    if (!cols || !num_glyphs)
+    {
+        free(cols);
+        return cols != 0;
+    }
+
+    const unsigned int num_pages = (num_glyphs + PAGE_SIZE - 1) >> PAGE_BITS;
+    unsigned int hash_mask = 1;
+    while (hash_mask < 2*num_pages) hash_mask <<= 1;
+    --hash_mask;
+    m_numGlyphs = num_glyphs;
+    m_pages = gralloc<uint16>(num_pages);
+    m_cols  = gralloc<uint16>(num_pages << PAGE_BITS);
+    uint16 * const seen = gralloc<uint16>(hash_mask + 1);
+    if (!m_pages || !m_cols || !seen)
+    {
+        // The dense map will do.
+        free(seen);
+        free(m_pages);
+        free(m_cols);
+        m_pages = 0;
+        m_cols = cols;
+        return true;
+    }
+    memset(seen, 0xFF, (hash_mask + 1) * sizeof(uint16));
+
+    for (unsigned int p = 0; p != num_pages; ++p)
+    {
+        // Gather the page where the next distinct page would go, the last
+        // one padded out with glyphs that have no column.
+        uint16 * const page = m_cols + (m_numPages << PAGE_BITS);
+        const unsigned int first = p << PAGE_BITS,
+                           n = min(unsigned(PAGE_SIZE), num_glyphs - first);
+        memcpy(page, cols + first, n * sizeof(uint16));
+        memset(page + n, 0xFF, (PAGE_SIZE - n) * sizeof(uint16));
+
+        unsigned int h = hash_page(page) & hash_mask;
+        while (seen[h] != 0xFFFF
+            && memcmp(m_cols + (seen[h] << PAGE_BITS), page, PAGE_SIZE * sizeof(uint16)))
+            h = (h + 1) & hash_mask;
+        if (seen[h] == 0xFFFF)
+            seen[h] = m_numPages++;
+        m_pages[p] = seen[h];
+    }
+    free(seen);
+
+    if (num_pages + (m_numPages << PAGE_BITS) > num_glyphs - num_glyphs / 4u)
+    {
+        free(m_pages);
+        free(m_cols);
+        m_pages = 0;
+        m_cols = cols;
+        m_numPages = 0;
+        return true;
+    }
+    free(cols);
+    uint16 * const shrunk = static_cast<uint16 *>(realloc(m_cols, (m_numPages << PAGE_BITS) * sizeof(uint16)));
+    if (shrunk) m_cols = shrunk;
+    return true;
+}
+
+size_t ColumnMap::size() const throw()
+{
+    return (m_pages ? ((m_numGlyphs + PAGE_SIZE - 1) >> PAGE_BITS) + (m_numPages << PAGE_BITS) : m_numGlyphs) * sizeof(uint16);
+}
+
+
+StateTable::~StateTable() throw()
+{
+    free(m_dense);
+    free(m_base);
+    free(m_slots);
+}
+
+bool StateTable::build(uint16 * trans, uint16 rows, uint16 columns, bool compact) throw()
+{
+    free(m_dense);
+    free(m_base);
+    free(m_slots);
+    m_dense = trans;
+    m_base = 0;
+    m_slots = 0;
+    m_numRows = rows;
+    m_numColumns = columns;
+    m_numSlots = 0;
+    if (!trans) return false;
+
+    if (compact && rows && columns && overlay())
+    {
+        free(m_dense);
+        m_dense = 0;
+    }
+    return true;
+}
+
+// Places the rows most full first, each at the lowest offset its entries fit
+// at.  A bit map of the slots in use is read a word at a time at each of the
+// row's columns, which tests 32 offsets at once.  Gives up, leaving the table
+// dense, unless that saves at least a quarter of the dense size.
+bool StateTable::overlay() throw()
+{
+    const size_t dense_size = size_t(m_numRows) * m_numColumns * sizeof(uint16),
+                 budget = dense_size - dense_size / 4;
+    uint32 * const keys = gralloc<uint32>(m_numRows);
+    if (!keys)  return false;
+
+    size_t entries = 0, reach = 0;
+    for (unsigned int r = 0; r != m_numRows; ++r)
+    {
+        const uint16 * const row = m_dense + r*m_numColumns;
+        unsigned int n = 0, last = 0;
+        for (unsigned int c = 0; c != m_numColumns; ++c)
+            if (row[c])
+            {
+                ++n;
+                last = c;
+            }
+        keys[r] = n << 16 | r;
+        entries += n;
+        if (n)  reach += last + 1;
+    }
+    if (entries * sizeof(slot) + m_numRows * sizeof(uint32) >= budget)
+    {
+        free(keys);
+        return false;
+    }
+
+    // A row is placed no further on than one past the last slot in use, so
+    // the slots never reach beyond the rows end to end.
+    const size_t capacity = reach + m_numColumns;
+    m_base  = gralloc<uint32>(m_numRows);
+    m_slots = gralloc<slot>(capacity);
+    uint32 * const used_bits = grzeroalloc<uint32>(capacity / 32 + m_numColumns / 32 + 3);
+    uint16 * const cols = gralloc<uint16>(m_numColumns);
+    if (!m_base || !m_slots || !used_bits || !cols)
+    {
+        free(keys);
+        free(used_bits);
+        free(cols);
+        free(m_base);
+        free(m_slots);
+        m_base = 0;
+        m_slots = 0;
+        return false;
+    }
+    for (slot * s = m_slots, * const se = s + capacity; s != se; ++s)
+        s->row = NO_ROW, s->next = 0;
+    qsort(keys, m_numRows, sizeof(uint32), &cmp_row_keys);
+
+    size_t first_free = 0,
+           used = m_numColumns,
+           last_n = 0,
+           last_b = 0;
+    for (unsigned int i = 0; i != m_numRows; ++i)
+    {
+        const uint16 r = uint16(keys[i]);
+        const uint16 * const row = m_dense + r*m_numColumns;
+        m_base[r] = 0;
+        if (!(keys[i] >> 16))   continue;
+
+        size_t n = 0;
+        for (unsigned int c = 0; c != m_numColumns; ++c)
+            if (row[c]) cols[n++] = uint16(c);
+
+        // Bit j of clash is set if offset b + j puts an entry on a used slot.
+        // Rows as full as the last one start where it was put, which packs
+        // nearly as well for far less searching.
+        size_t b = first_free > cols[0] ? first_free - cols[0] : 0;
+        if (n == last_n)    b = max(b, last_b);
+        for (;; b += 32)
+        {
+            uint32 clash = 0;
+            for (size_t k = 0; k != n && clash != ~0U; ++k)
+            {
+                const size_t p = b + cols[k], q = p >> 5, sh = p & 31;
+                clash |= used_bits[q] >> sh | (sh ? used_bits[q + 1] << (32 - sh) : 0);
+            }
+            if (clash != ~0U)
+            {
+                b += bit_set_count((~clash & (clash + 1)) - 1);
+                break;
+            }
+        }
+
+        last_n = n;
+        last_b = b;
+        m_base[r] = uint32(b);
+        for (size_t k = 0; k != n; ++k)
+        {
+            const size_t p = b + cols[k];
+            m_slots[p].row = r;
+            m_slots[p].next = row[cols[k]];
+            used_bits[p >> 5] |= 1U << (p & 31);
+        }
+        while (used_bits[first_free >> 5] & (1U << (first_free & 31))) ++first_free;
+        used = max(used, b + m_numColumns);
+    }
+    free(keys);
+    free(used_bits);
+    free(cols);
+
+    if (used * sizeof(slot) + m_numRows * sizeof(uint32) >= budget)
+    {
+        free(m_base);
+        free(m_slots);
+        m_base = 0;
+        m_slots = 0;
+        return false;
+    }
+    slot * const shrunk = static_cast<slot *>(realloc(m_slots, used * sizeof(slot)));
+    if (shrunk) m_slots = shrunk;
+    m_numSlots = uint32(used);
+    return true;
+}
+
+size_t StateTable::size() const throw()
+{
+    return m_base ? m_numRows * sizeof(uint32) + m_numSlots * sizeof(slot)
+                  : size_t(m_numRows) * m_numColumns * sizeof(uint16);
+}
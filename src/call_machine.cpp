@@ -49,16 +49,18 @@ of the License or (at your option) any later version.
 #define registers           const byte * & dp, vm::Machine::stack_t * & sp, \
                             vm::Machine::stack_t * const sb, regbank & reg
 
-// These are required by opcodes.h and should not be changed
-#define STARTOP(name)       bool name(registers) REGPARM(4);\
-                            bool name(registers) {
-#define ENDOP                   return (sp - sb)/Machine::STACK_MAX==0; \
+// These are required by opcodes.h and should not be changed. Each opcode is
+// built twice, programs whose stack depth the decoder has proven use the
+// ones without the stack check.
+#define STARTOP(name)       template <bool checked> bool name(registers) REGPARM(4);\
+                            template <bool checked> bool name(registers) {
+#define ENDOP                   return !checked || (sp - sb)/Machine::STACK_MAX==0; \
                             }
 
 #define EXIT(status)        { push(status); return false; }
 
 // This is required by opcode_table.h
-#define do_(name)           instr(name)
+#define do_(name)           instr(name<checked>)
 
 
 using namespace graphite2;
@@ -105,7 +107,8 @@ namespace {
 
 Machine::stack_t  Machine::run(const instr   * program,
                                const byte    * data,
-                               slotref     * & map)
+                               slotref     * & map,
+                               bool)
 
 {
     assert(program != 0);
@@ -129,10 +132,15 @@ Machine::stack_t  Machine::run(const instr   * program,
 
 // Pull in the opcode table
 namespace {
-#include "inc/opcode_table.h"
+template <bool checked>
+const opcode_t * opcode_table_for() throw()
+{
+    #include "inc/opcode_table.h"
+    return opcode_table;
+}
 }
 
-const opcode_t * Machine::getOpcodeTable() throw()
+const opcode_t * Machine::getOpcodeTable(bool verified) throw()
 {
-    return opcode_table;
+    return verified ? opcode_table_for<false>() : opcode_table_for<true>();
 }
@@ -45,7 +45,7 @@ of the License or (at your option) any later version.
 #include "inc/Rule.h"
 
 #define STARTOP(name)           name: {
-#define ENDOP                   }; goto *((sp - sb)/Machine::STACK_MAX ? &&end : *++ip);
+#define ENDOP                   }; goto *((checked && (sp - sb)/Machine::STACK_MAX) ? &&end : *++ip);
 #define EXIT(status)            { push(status); goto end; }
 
 #define do_(name)               &&name
@@ -75,6 +75,10 @@ namespace {
 // which breaks at least is_return. https://bugs.llvm.org/show_bug.cgi?id=39241
 // So all in all, we need at least the __noinline__ attribute. __noclone__
 // is not supported by clang.
+//
+// It is built twice, programs whose stack depth the decoder has proven run
+// without the stack check after every instruction.
+template <bool checked>
 __attribute__((__noinline__))
 const void * direct_run(const bool          get_table_mode,
                         const instr       * program,
@@ -118,22 +122,26 @@ const void * direct_run(const bool          get_table_mode,
 
 }
 
-const opcode_t * Machine::getOpcodeTable() throw()
+const opcode_t * Machine::getOpcodeTable(bool verified) throw()
 {
     slotref * dummy;
     Machine::status_t dumstat = Machine::finished;
-    return static_cast<const opcode_t *>(direct_run(true, 0, 0, 0, dummy, 0, dumstat));
+    return static_cast<const opcode_t *>(verified
+                ? direct_run<false>(true, 0, 0, 0, dummy, 0, dumstat)
+                : direct_run<true>(true, 0, 0, 0, dummy, 0, dumstat));
 }
 
 
 Machine::stack_t  Machine::run(const instr   * program,
                                const byte    * data,
-                               slotref     * & is)
+                               slotref     * & is,
+                               bool            verified)
 {
     assert(program != 0);
 
-    const stack_t *sp = static_cast<const stack_t *>(
-                direct_run(false, program, data, _stack, is, _map.dir(), _status, &_map));
+    const stack_t *sp = static_cast<const stack_t *>(verified
+                ? direct_run<false>(false, program, data, _stack, is, _map.dir(), _status, &_map)
+                : direct_run<true>(false, program, data, _stack, is, _map.dir(), _status, &_map));
     const stack_t ret = sp == _stack+STACK_GUARD+1 ? *sp-- : 0;
     check_final_stack(sp);
     return ret;
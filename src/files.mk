@@ -46,7 +46,9 @@ $(_NS)_SOURCES = \
     $($(_NS)_BASE)/src/gr_logging.cpp \
     $($(_NS)_BASE)/src/gr_segment.cpp \
     $($(_NS)_BASE)/src/gr_slot.cpp \
+    $($(_NS)_BASE)/src/jit_machine.cpp \
     $($(_NS)_BASE)/src/json.cpp \
+    $($(_NS)_BASE)/src/AxisBounds.cpp \
     $($(_NS)_BASE)/src/CachedFace.cpp \
     $($(_NS)_BASE)/src/CmapCache.cpp \
     $($(_NS)_BASE)/src/Code.cpp \
@@ -60,13 +62,18 @@ $(_NS)_SOURCES = \
     $($(_NS)_BASE)/src/GlyphFace.cpp \
     $($(_NS)_BASE)/src/Intervals.cpp \
     $($(_NS)_BASE)/src/Justifier.cpp \
+    $($(_NS)_BASE)/src/MemoryFace.cpp \
     $($(_NS)_BASE)/src/NameTable.cpp \
+    $($(_NS)_BASE)/src/Parallel.cpp \
     $($(_NS)_BASE)/src/Pass.cpp \
     $($(_NS)_BASE)/src/Position.cpp \
+    $($(_NS)_BASE)/src/SegCache.cpp \
     $($(_NS)_BASE)/src/Segment.cpp \
     $($(_NS)_BASE)/src/Silf.cpp \
+    $($(_NS)_BASE)/src/SliceEdges.cpp \
     $($(_NS)_BASE)/src/Slot.cpp \
     $($(_NS)_BASE)/src/Sparse.cpp \
+    $($(_NS)_BASE)/src/StateTable.cpp \
     $($(_NS)_BASE)/src/TtfUtil.cpp \
     $($(_NS)_BASE)/src/UtfCodec.cpp
 
@@ -74,6 +81,7 @@ $(_NS)_PRIVATE_HEADERS = \
     $($(_NS)_BASE)/src/inc/bits.h \
     $($(_NS)_BASE)/src/inc/debug.h \
     $($(_NS)_BASE)/src/inc/json.h \
+    $($(_NS)_BASE)/src/inc/AxisBounds.h \
     $($(_NS)_BASE)/src/inc/CachedFace.h \
     $($(_NS)_BASE)/src/inc/CharInfo.h \
     $($(_NS)_BASE)/src/inc/CmapCache.h \
@@ -89,22 +97,30 @@ $(_NS)_PRIVATE_HEADERS = \
     $($(_NS)_BASE)/src/inc/FileFace.h \
     $($(_NS)_BASE)/src/inc/Font.h \
     $($(_NS)_BASE)/src/inc/GlyphCache.h \
+    $($(_NS)_BASE)/src/inc/GlyphCoverage.h \
     $($(_NS)_BASE)/src/inc/GlyphFace.h \
     $($(_NS)_BASE)/src/inc/Intervals.h \
+    $($(_NS)_BASE)/src/inc/Jit.h \
     $($(_NS)_BASE)/src/inc/List.h \
     $($(_NS)_BASE)/src/inc/locale2lcid.h \
     $($(_NS)_BASE)/src/inc/Machine.h \
     $($(_NS)_BASE)/src/inc/Main.h \
+    $($(_NS)_BASE)/src/inc/MemoryFace.h \
     $($(_NS)_BASE)/src/inc/NameTable.h \
     $($(_NS)_BASE)/src/inc/opcode_table.h \
     $($(_NS)_BASE)/src/inc/opcodes.h \
+    $($(_NS)_BASE)/src/inc/Parallel.h \
     $($(_NS)_BASE)/src/inc/Pass.h \
     $($(_NS)_BASE)/src/inc/Position.h \
     $($(_NS)_BASE)/src/inc/Rule.h \
+    $($(_NS)_BASE)/src/inc/SegCache.h \
     $($(_NS)_BASE)/src/inc/Segment.h \
     $($(_NS)_BASE)/src/inc/Silf.h \
+    $($(_NS)_BASE)/src/inc/SliceEdges.h \
     $($(_NS)_BASE)/src/inc/Slot.h \
+    $($(_NS)_BASE)/src/inc/Snapshot.h \
     $($(_NS)_BASE)/src/inc/Sparse.h \
+    $($(_NS)_BASE)/src/inc/StateTable.h \
     $($(_NS)_BASE)/src/inc/TtfTypes.h \
     $($(_NS)_BASE)/src/inc/TtfUtil.h \
     $($(_NS)_BASE)/src/inc/UtfCodec.h
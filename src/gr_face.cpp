@@ -27,8 +27,10 @@ of the License or (at your option) any later version.
 #include "graphite2/Font.h"
 #include "inc/Face.h"
 #include "inc/FileFace.h"
+#include "inc/MemoryFace.h"
 #include "inc/GlyphCache.h"
 #include "inc/CmapCache.h"
+#include "inc/SegCache.h"
 #include "inc/Silf.h"
 #include "inc/json.h"
 
@@ -40,7 +42,7 @@ extern json *global_log;
 
 namespace
 {
-    bool load_face(Face & face, unsigned int options)
+    bool load_face(Face & face, unsigned int options, const void * image = 0, size_t image_len = 0)
     {
 #ifdef GRAPHITE2_TELEMETRY
         telemetry::category _misc_cat(face.tele.misc);
@@ -54,7 +56,8 @@ namespace
 
         if (silf)
         {
-            if (!face.readFeatures() || !face.readGraphite(silf))
+            if (!face.readFeatures()
+                || !(image ? face.readSnapshot(silf, image, image_len, options) : face.readGraphite(silf, options)))
             {
 #if !defined GRAPHITE2_NTRACING
                 if (global_log)
@@ -108,15 +111,47 @@ gr_face* gr_make_face(const void* appFaceHandle/*non-NULL*/, gr_get_table_fn tab
 }
 
 
-gr_face* gr_make_face_with_seg_cache_and_ops(const void* appFaceHandle/*non-NULL*/, const gr_face_ops *ops, unsigned int , unsigned int faceOptions)
+gr_face* gr_make_face_with_seg_cache_and_ops(const void* appFaceHandle/*non-NULL*/, const gr_face_ops *ops, unsigned int cacheSize, unsigned int faceOptions)
 {
-  return gr_make_face_with_ops(appFaceHandle, ops, faceOptions);
+  gr_face * res = gr_make_face_with_ops(appFaceHandle, ops, faceOptions);
+  if (res && !res->setupSegCache(cacheSize))
+  {
+    gr_face_destroy(res);
+    return 0;
+  }
+  return res;
 }
 
-gr_face* gr_make_face_with_seg_cache(const void* appFaceHandle/*non-NULL*/, gr_get_table_fn tablefn, unsigned int, unsigned int faceOptions)
+gr_face* gr_make_face_with_seg_cache(const void* appFaceHandle/*non-NULL*/, gr_get_table_fn tablefn, unsigned int cacheSize, unsigned int faceOptions)
 {
   const gr_face_ops ops = {sizeof(gr_face_ops), tablefn, NULL};
-  return gr_make_face_with_ops(appFaceHandle, &ops, faceOptions);
+  return gr_make_face_with_seg_cache_and_ops(appFaceHandle, &ops, cacheSize, faceOptions);
+}
+
+int gr_face_seg_cache_stats(const gr_face* pFace, size_t *hits, size_t *misses, size_t *entries)
+{
+    const SegCache * cache = pFace ? pFace->segCache() : 0;
+    if (hits)       *hits = cache ? cache->hits() : 0;
+    if (misses)     *misses = cache ? cache->misses() : 0;
+    if (entries)    *entries = cache ? cache->size() : 0;
+    return cache != 0;
+}
+
+size_t gr_face_snapshot(const gr_face* pFace, void *buf, size_t len)
+{
+    return pFace ? pFace->writeSnapshot(buf, len) : 0;
+}
+
+gr_face* gr_make_face_with_snapshot(const void* appFaceHandle/*non-NULL*/, const gr_face_ops *ops, const void *image, size_t len, unsigned int faceOptions)
+{
+    if (ops == 0 || image == 0)   return 0;
+
+    Face *res = new Face(appFaceHandle, *ops);
+    if (res && load_face(*res, faceOptions, image, len))
+        return static_cast<gr_face *>(res);
+
+    delete res;
+    return 0;
 }
 
 gr_uint32 gr_str_to_tag(const char *str)
@@ -226,6 +261,23 @@ int gr_face_is_char_supported(const gr_face* pFace, gr_uint32 usv, gr_uint32 scr
     return (gid != 0);
 }
 
+gr_face* gr_make_memory_face(const void *data, size_t len, unsigned int faceOptions)
+{
+    MemoryFace* pMemoryFace = new MemoryFace(data, len);
+    if (pMemoryFace && *pMemoryFace)
+    {
+      gr_face* pRes = gr_make_face_with_ops(pMemoryFace, &MemoryFace::ops, faceOptions);
+      if (pRes)
+      {
+        pRes->takeMemoryFace(pMemoryFace);    //takes ownership
+        return pRes;
+      }
+    }
+
+    delete pMemoryFace;
+    return NULL;
+}
+
 #ifndef GRAPHITE2_NFILEFACE
 gr_face* gr_make_file_face(const char *filename, unsigned int faceOptions)
 {
@@ -246,10 +298,33 @@ gr_face* gr_make_file_face(const char *filename, unsigned int faceOptions)
     return NULL;
 }
 
-gr_face* gr_make_file_face_with_seg_cache(const char* filename, unsigned int, unsigned int faceOptions)   //returns NULL on failure. //TBD better error handling
+gr_face* gr_make_file_face_with_seg_cache(const char* filename, unsigned int cacheSize, unsigned int faceOptions)   //returns NULL on failure. //TBD better error handling
                   //when finished with, call destroy_face
 {
-    return gr_make_file_face(filename, faceOptions);
+    gr_face * res = gr_make_file_face(filename, faceOptions);
+    if (res && !res->setupSegCache(cacheSize))
+    {
+        gr_face_destroy(res);
+        return 0;
+    }
+    return res;
+}
+
+gr_face* gr_make_file_face_with_snapshot(const char *filename, const void *image, size_t len, unsigned int faceOptions)
+{
+    FileFace* pFileFace = new FileFace(filename);
+    if (*pFileFace)
+    {
+      gr_face* pRes = gr_make_face_with_snapshot(pFileFace, &FileFace::ops, image, len, faceOptions);
+      if (pRes)
+      {
+        pRes->takeFileFace(pFileFace);        //takes ownership
+        return pRes;
+      }
+    }
+
+    delete pFileFace;
+    return NULL;
 }
 #endif      //!GRAPHITE2_NFILEFACE
 
@@ -112,6 +112,10 @@ void gr_stop_logging(GR_MAYBE_UNUSED gr_face * face)
 #if !defined GRAPHITE2_NTRACING
     if (face && face->logger())
     {
+#ifdef GRAPHITE2_TELEMETRY
+        // Again, now with the counts from shaping.
+        *face->logger() << face->tele;
+#endif
         FILE * log = face->logger()->stream();
         face->setLogger(0);
         fclose(log);
@@ -154,6 +158,10 @@ json & graphite2::operator << (json & j, const telemetry & t) throw()
             << "code"   << t.code
             << "misc"   << t.misc
             << "total"  << (t.silf + t.states + t.starts + t.transitions + t.glyph + t.code + t.misc)
+            << "collisions" << json::flat << json::object
+                << "passes"  << t.coll_passes
+                << "skipped" << t.coll_skipped
+                << json::close
         << json::close;
     return j;
 }
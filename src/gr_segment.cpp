@@ -26,32 +26,66 @@ of the License or (at your option) any later version.
 */
 #include "graphite2/Segment.h"
 #include "inc/UtfCodec.h"
+#include "inc/Font.h"
 #include "inc/Segment.h"
+#include "inc/SegCache.h"
 
 using namespace graphite2;
 
 namespace
 {
 
-  gr_segment* makeAndInitialize(const Font *font, const Face *face, uint32 script, const Features* pFeats/*must not be NULL*/, gr_encform enc, const void* pStart, size_t nChars, int dir)
+  uint32 normaliseScript(uint32 script)
   {
       if (script == 0x20202020) script = 0;
       else if ((script & 0x00FFFFFF) == 0x00202020) script = script & 0xFF000000;
       else if ((script & 0x0000FFFF) == 0x00002020) script = script & 0xFFFF0000;
       else if ((script & 0x000000FF) == 0x00000020) script = script & 0xFFFFFF00;
+      return script;
+  }
+
+  bool initialize(Segment *pRes, const Font *font, const Face *face, uint32 script, const Features* pFeats/*must not be NULL*/, gr_encform enc, const void* pStart, size_t nChars)
+  {
       // if (!font) return NULL;
-      Segment* pRes=new Segment(nChars, face, script, dir);
+      SegCache * const cache = face->segCache();
 
+      if (!pRes->read_text(face, pFeats, enc, pStart, nChars)
+          || !(cache && cache->suits(*pRes) ? cache->runGraphite(*pRes, script) : pRes->runGraphite()))
+        return false;
+      pRes->finalise(font, true);
+      return true;
+  }
 
-      if (!pRes->read_text(face, pFeats, enc, pStart, nChars) || !pRes->runGraphite())
+  // Slot indices record the order slots were in when characters were
+  // associated with them, which finalise may since have reversed. This maps
+  // them to positions in the slot list as it is now.
+  class SlotPositions
+  {
+  public:
+      SlotPositions(const Segment & seg, bool wanted = true)
       {
-        delete pRes;
-        return NULL;
+          uint32 p = 0, maxIndex = 0;
+          const Slot * s;
+          for (s = seg.first(); wanted && s && s->index() == p; s = s->next(), ++p) {}
+          if (!wanted || !s) return;
+
+          for (s = seg.first(); s; s = s->next())
+              maxIndex = max(maxIndex, s->index());
+          m_map.assign(maxIndex + 1, -1);
+          p = 0;
+          for (s = seg.first(); s; s = s->next(), ++p)
+              m_map[s->index()] = int(p);
       }
-      pRes->finalise(font, true);
 
-      return static_cast<gr_segment*>(pRes);
-  }
+      int operator () (int index) const
+      {
+          if (m_map.empty()) return index;
+          return index >= 0 && size_t(index) < m_map.size() ? m_map[index] : -1;
+      }
+
+  private:
+      Vector<int> m_map;
+  };
 
   template <typename utf_iter>
   inline size_t count_unicode_chars(utf_iter first, const utf_iter last, const void **error)
@@ -104,13 +138,15 @@ gr_segment* gr_make_seg(const gr_font *font, const gr_face *face, gr_uint32 scri
 {
     if (!face) return nullptr;
 
-    const gr_feature_val * tmp_feats = 0;
-    if (pFeats == 0)
-        pFeats = tmp_feats = static_cast<const gr_feature_val*>(face->theSill().cloneFeatures(0));
-    gr_segment * seg = makeAndInitialize(font, face, script, pFeats, enc, pStart, nChars, dir);
-    delete static_cast<const FeatureVal*>(tmp_feats);
-
-    return seg;
+    const Features * const feats = pFeats ? pFeats : &face->theSill().defaultFeatures();
+    script = normaliseScript(script);
+    Segment * const pRes = new Segment(nChars, face, script, dir);
+    if (pRes && !initialize(pRes, font, face, script, feats, enc, pStart, nChars))
+    {
+        delete pRes;
+        return nullptr;
+    }
+    return static_cast<gr_segment*>(pRes);
 }
 
 
@@ -120,6 +156,44 @@ void gr_seg_destroy(gr_segment* p)
 }
 
 
+gr_shape_context* gr_make_shape_context()
+{
+    return static_cast<gr_shape_context*>(new ShapeContext());
+}
+
+
+void gr_shape_context_destroy(gr_shape_context* ctx)
+{
+    delete static_cast<ShapeContext*>(ctx);
+}
+
+
+gr_segment* gr_make_seg_ctx(gr_shape_context* ctx, const gr_font *font, const gr_face *face, gr_uint32 script, const gr_feature_val* pFeats, gr_encform enc, const void* pStart, size_t nChars, int dir)
+{
+    if (!ctx) return gr_make_seg(font, face, script, pFeats, enc, pStart, nChars, dir);
+    if (!face) return nullptr;
+
+    const Features * const feats = pFeats ? pFeats : &face->theSill().defaultFeatures();
+    script = normaliseScript(script);
+    Segment * const pRes = ctx->acquire(nChars, face, script, dir);
+    if (pRes && !initialize(pRes, font, face, script, feats, enc, pStart, nChars))
+    {
+        ctx->release(pRes);
+        return nullptr;
+    }
+    return static_cast<gr_segment*>(pRes);
+}
+
+
+void gr_seg_reset(gr_shape_context* ctx, gr_segment* pSeg)
+{
+    if (!ctx)
+        gr_seg_destroy(pSeg);
+    else
+        ctx->release(pSeg);
+}
+
+
 float gr_seg_advance_X(const gr_segment* pSeg/*not NULL*/)
 {
     assert(pSeg);
@@ -165,6 +239,56 @@ const gr_slot* gr_seg_last_slot(gr_segment* pSeg/*not NULL*/)
     return static_cast<const gr_slot*>(pSeg->last());
 }
 
+size_t gr_seg_export_glyphs(const gr_segment* pSeg/*not NULL*/, const gr_font* font, size_t maxGlyphs,
+                            gr_uint16* gids, float* originsX, float* originsY, float* advances,
+                            int* charIndices, int* parents)
+{
+    assert(pSeg);
+    const GlyphCache & glyphs = pSeg->getFace()->glyphs();
+    const float scale = font ? font->scale() : 1.f;
+    const bool hinted = font && font->isHinted();
+    const SlotPositions positions(*pSeg, parents != 0);
+
+    size_t n = 0;
+    for (const Slot * s = pSeg->first(); s; s = s->next(), ++n)
+    {
+        if (n >= maxGlyphs) continue;
+        const uint16 gid = s->gid();
+        if (gids)       gids[n] = s->glyph();
+        if (originsX)   originsX[n] = s->origin().x;
+        if (originsY)   originsY[n] = s->origin().y;
+        if (advances)   advances[n] = hinted ? (s->advance() - glyphs.glyph(gid)->theAdvance().x) * scale + font->advance(gid)
+                                             : s->advance() * scale;
+        if (charIndices) charIndices[n] = s->before();
+        if (parents)    parents[n] = s->attachedTo() ? positions(s->attachedTo()->index()) : -1;
+    }
+    return n;
+}
+
+
+size_t gr_seg_export_clusters(const gr_segment* pSeg/*not NULL*/, size_t maxChars, int* firstGlyphs, int* lastGlyphs)
+{
+    assert(pSeg);
+    const SlotPositions positions(*pSeg);
+    const size_t n = pSeg->charInfoCount();
+    for (unsigned int i = 0; i < n && i < maxChars; ++i)
+    {
+        const CharInfo * const c = pSeg->charinfo(i);
+        int first = positions(c->before()),
+            last  = positions(c->after());
+        if (first > last && last >= 0)
+        {
+            const int t = first;
+            first = last;
+            last = t;
+        }
+        if (firstGlyphs)    firstGlyphs[i] = first;
+        if (lastGlyphs)     lastGlyphs[i] = last;
+    }
+    return n;
+}
+
+
 float gr_seg_justify(gr_segment* pSeg/*not NULL*/, const gr_slot* pSlot/*not NULL*/, const gr_font *pFont, double width, enum gr_justFlags flags, const gr_slot *pFirst, const gr_slot *pLast)
 {
     assert(pSeg);
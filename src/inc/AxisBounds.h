@@ -0,0 +1,79 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2015, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+// Where a neighbour's box lies on each of the four axes a ShiftCollider moves
+// its target along, worked out for all four at once.  The axes do the same
+// float operations on different projections of the same boxes, so they can
+// share vector registers a lane each.  Which instructions do it is chosen
+// once for the CPU, and every way gives the same floats to the bit.
+
+#pragma once
+
+#include "inc/Main.h"
+#include "inc/GlyphCache.h"
+
+namespace graphite2 {
+
+// A lane per axis: x, y, sum and difference.  The box keeps the target out of
+// vmin..vmax along the axis and spans omin..omax across it.
+struct AxisBounds
+{
+    float   vmin[4],
+            vmax[4],
+            omin[4],
+            omax[4];
+};
+
+// The target being bounded against, with its current shift as tx, ty.  set()
+// also lays out the target's side of each term for the vector paths, vmin's
+// lanes then vmax's, so that is done once per target not per neighbour.
+struct AxisTarget
+{
+    void set(const BBox & bb, const SlantBox & sb, float tx, float ty);
+
+    BBox        bb;
+    SlantBox    sb;
+    float       tx,
+                ty;
+    float       q1[8],
+                q2[8],  // but for lane 1, where the target's side comes first
+                q3[8],
+                u2[4],
+                u3[4];
+};
+
+// Bounds the neighbour's box bb, sb offset by sx, sy.  A sub-box's terms are
+// summed in a different order from the main box's, which sub selects.
+typedef void (*axis_bounds_fn)(const AxisTarget & t, const BBox & bb, const SlantBox & sb,
+                               float sx, float sy, bool sub, AxisBounds & res);
+
+enum axis_bounds_kind { AXIS_BOUNDS_SCALAR, AXIS_BOUNDS_SSE, AXIS_BOUNDS_AVX, AXIS_BOUNDS_BEST };
+
+// The given way of bounding, or 0 if this build or CPU can't do it that way.
+// AXIS_BOUNDS_BEST is the fastest there is, which ShiftCollider uses.
+axis_bounds_fn axis_bounds(axis_bounds_kind kind = AXIS_BOUNDS_BEST) throw();
+
+} // namespace graphite2
@@ -40,6 +40,10 @@ namespace graphite2 {
 
 class Silf;
 class Face;
+class FeatureMap;
+class FeatureVal;
+class SnapshotReader;
+class SnapshotWriter;
 
 enum passtype {
     PASS_TYPE_UNKNOWN = 0,
@@ -65,7 +69,8 @@ public:
         arguments_exhausted,
         missing_return,
         nested_context_item,
-        underfull_stack
+        underfull_stack,
+        overfull_stack
     };
 
 private:
@@ -73,13 +78,17 @@ private:
 
     instr *     _code;
     byte  *     _data;
+    native_t    _native;
     size_t      _data_size,
                 _instr_count;
     byte        _max_ref;
     mutable status_t _status;
     bool        _constraint,
                 _modify,
-                _delete;
+                _delete,
+                _verified,  // the stack is proven to stay in bounds
+                _own_glyph_only,
+                _sets_feats;
     mutable bool _own;
 
     void release_buffers() throw ();
@@ -103,8 +112,32 @@ public:
     size_t        instructionCount() const throw()  { return _instr_count; }
     bool          immutable() const throw()         { return !(_delete || _modify); }
     bool          deletes() const throw()           { return _delete; }
+    bool          verified() const throw()          { return _verified; }
+    // A constraint that only reads the glyph and features of the slot it is
+    // run on, so its result on a slot can be reused for the same glyph.
+    bool          ownGlyphOnly() const throw()      { return _own_glyph_only; }
+    bool          setsFeatures() const throw()      { return _sets_feats; }
     size_t        maxRef() const throw()            { return _max_ref; }
     void          externalProgramMoved(ptrdiff_t) throw();
+    const instr * program() const throw()           { return _code; }
+    const byte  * data() const throw()              { return _data; }
+    // The opcode of the i'th instruction, or -1 if it is not one.
+    int           opcodeOf(size_t i) const throw();
+    // Native code is owned by the Jit that compiled it, which must outlive
+    // this code.
+    void          native(native_t fn) throw()       { _native = fn; }
+    native_t      native() const throw()            { return _native; }
+    // Whether a constraint returns false on every slot when all characters
+    // use feats. Only feature tests and arithmetic on them are followed, any
+    // other code is taken to possibly pass.
+    bool          failsWith(const FeatureMap & fmap, const FeatureVal & feats) const throw();
+
+    // Snapshot images store opcode numbers, the threaded code is rebuilt on
+    // reading. Without _out the code owns its buffer, otherwise it is carved
+    // out of the program pool [*_out, out_end).
+    bool          writeImage(SnapshotWriter &) const;
+    bool          readImage(SnapshotReader &, byte * * const _out = 0, const byte * const out_end = 0);
+    size_t        imageProgramSize() const throw();
 
     int32 run(Machine &m, slotref * & map) const;
 
@@ -120,16 +153,24 @@ size_t  Machine::Code::estimateCodeDataOut(size_t n_bc, int nRules, int nSlots)
 }
 
 
+inline
+size_t Machine::Code::imageProgramSize() const throw()
+{
+    return _instr_count ? ((_instr_count+1) + (_data_size + sizeof(instr)-1)/sizeof(instr))*sizeof(instr) : 0;
+}
+
+
 inline Machine::Code::Code() throw()
-: _code(0), _data(0), _data_size(0), _instr_count(0), _max_ref(0),
+: _code(0), _data(0), _native(0), _data_size(0), _instr_count(0), _max_ref(0),
   _status(loaded), _constraint(false), _modify(false), _delete(false),
-  _own(false)
+  _verified(false), _own_glyph_only(false), _sets_feats(false), _own(false)
 {
 }
 
 inline Machine::Code::Code(const Machine::Code &obj) throw ()
  :  _code(obj._code),
     _data(obj._data),
+    _native(obj._native),
     _data_size(obj._data_size),
     _instr_count(obj._instr_count),
     _max_ref(obj._max_ref),
@@ -137,6 +178,9 @@ inline Machine::Code::Code(const Machine::Code &obj) throw ()
     _constraint(obj._constraint),
     _modify(obj._modify),
     _delete(obj._delete),
+    _verified(obj._verified),
+    _own_glyph_only(obj._own_glyph_only),
+    _sets_feats(obj._sets_feats),
     _own(obj._own)
 {
     obj._own = false;
@@ -147,12 +191,16 @@ inline Machine::Code & Machine::Code::operator=(const Machine::Code &rhs) throw(
         release_buffers();
     _code        = rhs._code;
     _data        = rhs._data;
+    _native      = rhs._native;
     _data_size   = rhs._data_size;
     _instr_count = rhs._instr_count;
     _status      = rhs._status;
     _constraint  = rhs._constraint;
     _modify      = rhs._modify;
     _delete      = rhs._delete;
+    _verified    = rhs._verified;
+    _own_glyph_only = rhs._own_glyph_only;
+    _sets_feats  = rhs._sets_feats;
     _own         = rhs._own;
     rhs._own = false;
     return *this;
@@ -27,8 +27,10 @@ of the License or (at your option) any later version.
 #pragma once
 
 #include "inc/List.h"
+#include "inc/AxisBounds.h"
 #include "inc/Position.h"
 #include "inc/Intervals.h"
+#include "inc/SliceEdges.h"
 #include "inc/debug.h"
 
 namespace graphite2 {
@@ -136,6 +138,8 @@ public:
     bool mergeSlot(Segment *seg, Slot *slot, const SlotCollision *cinfo, const Position &currShift, bool isAfter,
                 bool sameCluster, bool &hasCol, bool isExclusion, GR_MAYBE_UNUSED json * const dbgout);
     Position resolve(Segment *seg, bool &isCol, GR_MAYBE_UNUSED json * const dbgout);
+    void reach(Segment *seg, float &xmin, float &xmax) const;
+    bool hasSeqClass() const { return _seqClass != 0; }
     void addBox_slope(bool isx, const Rect &box, const BBox &bb, const SlantBox &sb, const Position &org, float weight, float m, bool minright, int mode);
     void removeBox(const Rect &box, const BBox &bb, const SlantBox &sb, const Position &org, int mode);
     const Position &origin() const { return _origin; }
@@ -164,6 +168,8 @@ protected:
     uint16  _seqClass;
 	uint16	_seqProxClass;
     uint16  _seqOrder;
+    AxisTarget _axisTarget; // the target as _bounds wants it
+    axis_bounds_fn _bounds; // works out vmin..vmax for all 4 directions
 
 	//bool _scraping[4];
 
@@ -176,7 +182,8 @@ ShiftCollider::ShiftCollider(GR_MAYBE_UNUSED json *dbgout)
   _marginWt(0.0),
   _seqClass(0),
   _seqProxClass(0),
-  _seqOrder(0)
+  _seqOrder(0),
+  _bounds(axis_bounds())
 {
 #if !defined GRAPHITE2_NTRACING
     for (int i = 0; i < 4; ++i)
@@ -184,6 +191,54 @@ ShiftCollider::ShiftCollider(GR_MAYBE_UNUSED json *dbgout)
 #endif
 }
 
+// The slots of one collision range kept in order of where they start in x,
+// so that the target a ShiftCollider is fixing only has to merge those within
+// its reach rather than every slot in the range.  Slots that could affect it
+// from anywhere, through an exclusion glyph or a sequence order, are always
+// merged.  A slot's shift, and the moves that give its attachments, must be
+// passed back through moved() to keep the order true.
+class CollisionIndex
+{
+public:
+    CollisionIndex() : _revFirst(0), _width(0), _usable(false) {}
+    ~CollisionIndex() throw() { }
+
+    // Index the range that starts at start, up to and including the next slot
+    // that ends a range.
+    void build(Segment *seg, Slot *start);
+    void moved(Segment *seg, const Slot *slot);
+    // The neighbours resolveCollisions should walk from start, in that order,
+    // or 0 if it should walk the whole range.
+    const Vector<Slot *> *neighbours(Segment *seg, const ShiftCollider &coll, Slot *start,
+                Slot *slotFix, Slot *base, bool isRev);
+
+    CLASS_NEW_DELETE;
+
+private:
+    struct entry
+    {
+        float   xmin, xmax;
+        Slot *  slot;
+    };
+    struct by_xmin;
+    enum { NOT_HERE = ~0U, MIN_INDEXED = 32 };
+
+    void place(Segment *seg, uint32 i);
+    void found(const Slot *s);
+    void foundCluster(const Slot *s);
+
+    Vector<entry>   _entries;   // in slot order from the start of the range
+    Vector<uint32>  _byX;       // entries ordered by xmin
+    Vector<uint32>  _rank;      // where each entry is in _byX
+    Vector<uint32>  _always;    // entries merged wherever they are
+    Vector<uint32>  _where;     // entry for each slot index, or NOT_HERE
+    Vector<uint32>  _found;
+    Vector<Slot *>  _walk;
+    uint32  _revFirst;          // where a backward walk from the end stops
+    float   _width;             // widest entry
+    bool    _usable;
+};  // end of class CollisionIndex
+
 class KernCollider
 {
 public:
@@ -195,6 +250,7 @@ public:
     bool mergeSlot(Segment *seg, Slot *slot, const Position &currShift, float currSpace, int dir, json * const dbgout);
     Position resolve(Segment *seg, Slot *slot, int dir, json * const dbgout);
     void shift(const Position &mv, int dir);
+    void sliceEdges(slice_edges_fn f) { _sliceEdges = f; }
 
     CLASS_NEW_DELETE;
 
@@ -211,6 +267,8 @@ private:
     float _mingap;
     float _xbound;        // max or min edge
     bool  _hit;
+    slice_edges_fn _sliceEdges;
+    Vector<float> _slices;  // a glyph's edges in the slices it spans
 
 #if !defined GRAPHITE2_NTRACING
     // Debugging
@@ -235,7 +293,8 @@ KernCollider::KernCollider(GR_MAYBE_UNUSED json *dbg)
   _sliceWidth(0.0f),
   _mingap(0.0f),
   _xbound(0.0),
-  _hit(false)
+  _hit(false),
+  _sliceEdges(slice_edges())
 {
 #if !defined GRAPHITE2_NTRACING
     _seg = 0;
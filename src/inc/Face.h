@@ -41,9 +41,13 @@ namespace graphite2 {
 class Cmap;
 class FileFace;
 class GlyphCache;
+class MemoryFace;
 class NameTable;
+class SegCache;
 class json;
 class Font;
+struct SnapshotHeader;
+class SnapshotWriter;
 
 
 using TtfUtil::Tag;
@@ -67,14 +71,19 @@ public:
 
 public:
     bool                readGlyphs(uint32 faceOptions);
-    bool                readGraphite(const Table & silf);
+    bool                readGraphite(const Table & silf, uint32 faceOptions = 0);
     bool                readFeatures();
+    bool                readSnapshot(const Table & silf, const void * image, size_t len, uint32 faceOptions = 0);
+    size_t              writeSnapshot(void * buf, size_t len) const;
     void                takeFileFace(FileFace* pFileFace/*takes ownership*/);
+    void                takeMemoryFace(MemoryFace* pMemoryFace/*takes ownership*/);
+    bool                setupSegCache(size_t maxSegments);
 
     const SillMap     & theSill() const;
     const GlyphCache  & glyphs() const;
     Cmap              & cmap() const;
     NameTable         * nameTable() const;
+    SegCache          * segCache() const;
     void                setLogger(FILE *log_file);
     json              * logger() const throw();
 
@@ -90,21 +99,29 @@ public:
     int32  getGlyphMetric(uint16 gid, uint8 metric) const;
     uint16 findPseudo(uint32 uid) const;
 
-    // Errors
-    unsigned int        error() const { return m_error; }
-    bool                error(Error e) { m_error = e.error(); return false; }
-    unsigned int        error_context() const { return m_error; }
-    void                error_context(unsigned int errcntxt) { m_errcntxt = errcntxt; }
+    // Errors, these may be set from several threads during a parallel load.
+    unsigned int        error() const { return atomic_relaxed_load(m_error); }
+    bool                error(Error e) { atomic_relaxed_store(m_error, unsigned(e.error())); return false; }
+    unsigned int        error_context() const { return atomic_relaxed_load(m_error); }
+    void                error_context(unsigned int errcntxt) { atomic_relaxed_store(m_errcntxt, errcntxt); }
 
     CLASS_NEW_DELETE;
 private:
+    void                snapshotKey(const Table & silf, SnapshotHeader & key) const;
+    bool                writeSilfImages(SnapshotWriter & w) const;
+    template <bool traced>
+    bool                runPasses(Segment *seg, const Silf *silf) const;
+
     SillMap                 m_Sill;
     gr_face_ops             m_ops;
     const void            * m_appFaceHandle;    // non-NULL
     FileFace              * m_pFileFace;        //owned
+    MemoryFace            * m_pMemoryFace;      //owned
     mutable GlyphCache    * m_pGlyphFaceCache;  // owned - never NULL
     mutable Cmap          * m_cmap;             // cmap cache if available
     mutable NameTable     * m_pNames;
+    SegCache              * m_segCache;         // owned, NULL unless asked for
+    Table                 * m_silfTable;        // owned, NULL unless passes are decoded lazily
     mutable json          * m_logger;
     unsigned int            m_error;
     unsigned int            m_errcntxt;
@@ -158,6 +175,12 @@ Cmap & Face::cmap() const
     return *m_cmap;
 };
 
+inline
+SegCache * Face::segCache() const
+{
+    return m_segCache;
+}
+
 inline
 json * Face::logger() const throw()
 {
@@ -187,6 +210,8 @@ public:
 
     size_t  size() const throw();
     Table & operator = (const Table && rhs) throw();
+
+    CLASS_NEW_DELETE;
 };
 
 inline
@@ -38,9 +38,15 @@ of the License or (at your option) any later version.
 #include "graphite2/Font.h"
 
 #include "inc/Main.h"
+#include "inc/MemoryFace.h"
 #include "inc/TtfTypes.h"
 #include "inc/TtfUtil.h"
 
+// Map font files into memory where we can, otherwise read tables as needed.
+#if defined(__unix__) || defined(__APPLE__)
+  #define HAVE_MMAP
+#endif
+
 namespace graphite2 {
 
 
@@ -65,6 +71,11 @@ private:        //defensive
     TtfUtil::Sfnt::OffsetSubTable         * _header_tbl;
     TtfUtil::Sfnt::OffsetSubTable::Entry  * _table_dir;
 
+    void          * _map;       // whole file if mapped, then tables come from _mapped
+    MemoryFace      _mapped;
+
+    bool map(const char *filename);
+
     FileFace(const FileFace&);
     FileFace& operator=(const FileFace&);
 };
@@ -72,7 +83,7 @@ private:        //defensive
 inline
 FileFace::operator bool() const throw()
 {
-    return _file && _header_tbl && _table_dir;
+    return _map ? bool(_mapped) : _file && _header_tbl && _table_dir;
 }
 
 } // namespace graphite2
@@ -62,9 +62,14 @@ private:
 inline
 float Font::advance(unsigned short glyphid) const
 {
-    if (m_advances[glyphid] == INVALID_ADVANCE)
-        m_advances[glyphid] = (*m_ops.glyph_advance_x)(m_appFontHandle, glyphid);
-    return m_advances[glyphid];
+    // Racing threads compute the same value, so a relaxed store is enough.
+    float adv = atomic_relaxed_load(m_advances[glyphid]);
+    if (adv == INVALID_ADVANCE)
+    {
+        adv = (*m_ops.glyph_advance_x)(m_appFontHandle, glyphid);
+        atomic_relaxed_store(m_advances[glyphid], adv);
+    }
+    return adv;
 }
 
 inline
@@ -101,12 +101,12 @@ public:
     unsigned short  numAttrs() const throw();
     unsigned short  unitsPerEm() const throw();
 
-    const GlyphFace *glyph(unsigned short glyphid) const;      //result may be changed by subsequent call with a different glyphid
+    const GlyphFace *glyph(unsigned short glyphid) const;      //safe to call concurrently on a shared face
     const GlyphFace *glyphSafe(unsigned short glyphid) const;
     float            getBoundingMetric(unsigned short glyphid, uint8 metric) const;
     uint8            numSubBounds(unsigned short glyphid) const;
     float            getSubBoundingMetric(unsigned short glyphid, uint8 subindex, uint8 metric) const;
-    const Rect &     slant(unsigned short glyphid) const { return _boxes[glyphid] ? _boxes[glyphid]->slant() : _empty_slant_box; }
+    const Rect &     slant(unsigned short glyphid) const { return box(glyphid) ? box(glyphid)->slant() : _empty_slant_box; }
     const SlantBox & getBoundingSlantBox(unsigned short glyphid) const;
     const BBox &     getBoundingBBox(unsigned short glyphid) const;
     const SlantBox & getSubBoundingSlantBox(unsigned short glyphid, uint8 subindex) const;
@@ -117,6 +117,15 @@ public:
     CLASS_NEW_DELETE;
 
 private:
+    // Boxes are published alongside their glyph by glyph(), see there.
+    GlyphBox *       box(unsigned short glyphid) const { return atomic_relaxed_load(_boxes[glyphid]); }
+
+    enum { PRELOAD_CHUNK = 256 };
+    struct Preload;
+    static void      preloadGlyphsJob(void * data, unsigned int chunk);
+    static void      preloadBoxesJob(void * data, unsigned int chunk);
+    bool             preloadParallel(GlyphFace * glyphs);
+
     const Rect            _empty_slant_box;
     const Loader        * _glyph_loader;
     const GlyphFace *   * _glyphs;
@@ -165,17 +174,17 @@ float GlyphCache::getBoundingMetric(unsigned short glyphid, uint8 metric) const
         case 1: return (float)(glyph(glyphid)->theBBox().bl.y);                          // y_min
         case 2: return (float)(glyph(glyphid)->theBBox().tr.x);                          // x_max
         case 3: return (float)(glyph(glyphid)->theBBox().tr.y);                          // y_max
-        case 4: return (float)(_boxes[glyphid] ? _boxes[glyphid]->slant().bl.x : 0.f);    // sum_min
-        case 5: return (float)(_boxes[glyphid] ? _boxes[glyphid]->slant().bl.y : 0.f);    // diff_min
-        case 6: return (float)(_boxes[glyphid] ? _boxes[glyphid]->slant().tr.x : 0.f);    // sum_max
-        case 7: return (float)(_boxes[glyphid] ? _boxes[glyphid]->slant().tr.y : 0.f);    // diff_max
+        case 4: return (float)(box(glyphid) ? box(glyphid)->slant().bl.x : 0.f);    // sum_min
+        case 5: return (float)(box(glyphid) ? box(glyphid)->slant().bl.y : 0.f);    // diff_min
+        case 6: return (float)(box(glyphid) ? box(glyphid)->slant().tr.x : 0.f);    // sum_max
+        case 7: return (float)(box(glyphid) ? box(glyphid)->slant().tr.y : 0.f);    // diff_max
         default: return 0.;
     }
 }
 
 inline const SlantBox &GlyphCache::getBoundingSlantBox(unsigned short glyphid) const
 {
-    return _boxes[glyphid] ? *(SlantBox *)(&(_boxes[glyphid]->slant())) : SlantBox::empty;
+    return box(glyphid) ? *(SlantBox *)(&(box(glyphid)->slant())) : SlantBox::empty;
 }
 
 inline const BBox &GlyphCache::getBoundingBBox(unsigned short glyphid) const
@@ -186,7 +195,7 @@ inline const BBox &GlyphCache::getBoundingBBox(unsigned short glyphid) const
 inline
 float GlyphCache::getSubBoundingMetric(unsigned short glyphid, uint8 subindex, uint8 metric) const
 {
-    GlyphBox *b = _boxes[glyphid];
+    GlyphBox *b = box(glyphid);
     if (b == NULL || subindex >= b->num()) return 0;
 
     switch (metric) {
@@ -204,20 +213,20 @@ float GlyphCache::getSubBoundingMetric(unsigned short glyphid, uint8 subindex, u
 
 inline const SlantBox &GlyphCache::getSubBoundingSlantBox(unsigned short glyphid, uint8 subindex) const
 {
-    GlyphBox *b = _boxes[glyphid];
+    GlyphBox *b = box(glyphid);
     return *(SlantBox *)(b->subs() + 2 * subindex + 1);
 }
 
 inline const BBox &GlyphCache::getSubBoundingBBox(unsigned short glyphid, uint8 subindex) const
 {
-    GlyphBox *b = _boxes[glyphid];
+    GlyphBox *b = box(glyphid);
     return *(BBox *)(b->subs() + 2 * subindex);
 }
 
 inline
 uint8 GlyphCache::numSubBounds(unsigned short glyphid) const
 {
-    return _boxes[glyphid] ? _boxes[glyphid]->num() : 0;
+    return box(glyphid) ? box(glyphid)->num() : 0;
 }
 
 } // namespace graphite2
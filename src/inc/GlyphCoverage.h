@@ -0,0 +1,82 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#pragma once
+
+#include <cstring>
+#include "inc/Main.h"
+
+namespace graphite2 {
+
+// A coarse set of glyph ids, with one bit standing for a run of consecutive
+// glyphs. Fonts keep a script's glyphs mostly together, so this is enough to
+// tell a pass for one script from text in another. It may hold glyphs that
+// were never added, never the other way round.
+class GlyphCoverage
+{
+public:
+    static const unsigned int BITS = 256;
+
+    GlyphCoverage() throw()                         { clear(); }
+
+    // How far to shift glyph ids so a font's glyphs fit in BITS buckets.
+    static uint8 shiftFor(size_t numGlyphs) throw()
+    {
+        uint8 shift = 0;
+        while (numGlyphs > 1 && ((numGlyphs - 1) >> shift) >= BITS) ++shift;
+        return shift;
+    }
+
+    void clear() throw()                            { memset(m_bits, 0, sizeof m_bits); }
+    void add(uint16 gid, uint8 shift) throw()       { set(bucket(gid, shift)); }
+    void add(uint16 first, uint16 last, uint8 shift) throw()
+    {
+        for (unsigned int b = bucket(first, shift), b_end = bucket(last, shift); b <= b_end; ++b)
+            set(b);
+    }
+    void merge(const GlyphCoverage & rhs) throw()
+    {
+        for (unsigned int i = 0; i != WORDS; ++i)
+            m_bits[i] |= rhs.m_bits[i];
+    }
+    bool intersects(const GlyphCoverage & rhs) const throw()
+    {
+        uint32 any = 0;
+        for (unsigned int i = 0; i != WORDS; ++i)
+            any |= m_bits[i] & rhs.m_bits[i];
+        return any != 0;
+    }
+
+private:
+    static const unsigned int WORDS = BITS / 32;
+
+    static unsigned int bucket(uint16 gid, uint8 shift) throw()   { return min(unsigned(gid >> shift), BITS - 1); }
+    void set(unsigned int b) throw()                { m_bits[b >> 5] |= uint32(1) << (b & 31); }
+
+    uint32  m_bits[WORDS];
+};
+
+} // namespace graphite2
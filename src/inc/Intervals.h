@@ -44,6 +44,10 @@ class Segment;
 
 enum zones_t {SD, XY};
 
+// The exclusions are kept in order of x, a column for each of their fields,
+// so that insert() and remove() can bisect the ends to find where they start
+// and closest() reads only the floats it costs.  A split moves each column
+// along once however many entries it adds.
 class Zones
 {
     struct Exclusion
@@ -60,31 +64,13 @@ class Zones
         bool    open;
 
         Exclusion(float x, float w, float smi, float smxi, float c);
-        Exclusion & operator += (Exclusion const & rhs);
         uint8 outcode(float p) const;
-
-        Exclusion   split_at(float p);
-        void        left_trim(float p);
-
-        bool        track_cost(float & cost, float & x, float origin) const;
-
-    private:
-        float test_position(float origin) const;
-        float cost(float x) const;
      };
 
-    typedef Vector<Exclusion>                   exclusions;
-
-    typedef exclusions::iterator                iterator;
-    typedef Exclusion *                         pointer;
-    typedef Exclusion &                         reference;
-    typedef std::reverse_iterator<iterator>     reverse_iterator;
+    enum { X, XM, C, SM, SMX, NUM_COLS };
 
 public:
-    typedef exclusions::const_iterator              const_iterator;
-    typedef Exclusion const *                       const_pointer;
-    typedef Exclusion const &                       const_reference;
-    typedef std::reverse_iterator<const_iterator>   const_reverse_iterator;
+    typedef Exclusion   value_type;
 
 #if !defined GRAPHITE2_NTRACING
     struct Debug
@@ -108,6 +94,7 @@ public:
 #endif
 
     Zones();
+    ~Zones();
     template<zones_t O>
     void initialise(float xmin, float xmax, float margin_len, float margin_weight, float ao);
 
@@ -120,11 +107,14 @@ public:
 
     float closest( float origin, float &cost) const;
 
-    const_iterator begin() const { return _exclusions.begin(); }
-    const_iterator end() const { return _exclusions.end(); }
+    size_t      size() const { return _size; }
+    value_type  operator [] (size_t i) const;
 
+    CLASS_NEW_DELETE;
 private:
-    exclusions  _exclusions;
+    float     * _cols;      // NUM_COLS columns of _capacity floats, then the open flags
+    size_t      _size,
+                _capacity;
 #if !defined GRAPHITE2_NTRACING
     json      * _dbg;
     debugs      _dbgs;
@@ -134,20 +124,39 @@ private:
                 _pos,
                 _posm;
 
-    void            insert(Exclusion e);
-    void            remove(float x, float xm);
-    const_iterator  find_exclusion_under(float x) const;
+    float     * col(int k) const    { return _cols + k * _capacity; }
+    uint8     * open() const        { return reinterpret_cast<uint8 *>(_cols + NUM_COLS * _capacity); }
+    void        reserve(size_t n);
+    void        make_room(size_t i, size_t n);
+    void        erase(size_t i);
+    void        split(size_t i, const float * at, size_t n);
+    void        set(size_t i, const Exclusion & e);
+    void        add(size_t i, const Exclusion & e);
+    void        insert(Exclusion e);
+    void        remove(float x, float xm);
+    size_t      first_reaching(float x) const;
+    size_t      find_exclusion_under(float x) const;
+    bool        track_cost(size_t i, float & best_cost, float & best_pos, float origin) const;
+
+    Zones(const Zones &);
+    Zones & operator = (const Zones &);
 };
 
 
 inline
 Zones::Zones()
-: _margin_len(0), _margin_weight(0), _pos(0), _posm(0)
+: _cols(0), _size(0), _capacity(0), _margin_len(0), _margin_weight(0), _pos(0), _posm(0)
 {
 #if !defined GRAPHITE2_NTRACING
     _dbg = 0;
 #endif
-    _exclusions.reserve(8);
+    reserve(8);
+}
+
+inline
+Zones::~Zones()
+{
+    free(_cols);
 }
 
 inline
@@ -164,9 +173,11 @@ void Zones::initialise(float xmin, float xmax, float margin_len,
     _margin_weight = margin_weight;
     _pos = xmin;
     _posm = xmax;
-    _exclusions.clear();
-    _exclusions.push_back(Exclusion::weighted<O>(xmin, xmax, 1, a0, 0, 0, 0, 0, false));
-    _exclusions.front().open = true;
+    _size = 0;
+    make_room(0, 1);
+    Exclusion e = Exclusion::weighted<O>(xmin, xmax, 1, a0, 0, 0, 0, 0, false);
+    e.open = true;
+    set(0, e);
 #if !defined GRAPHITE2_NTRACING
     _dbgs.clear();
 #endif
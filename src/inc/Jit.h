@@ -0,0 +1,67 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+// Compiles loaded stack machine code to native x86-64 code. Each program
+// becomes a straight line of instructions, simple stack operations inline and
+// everything else a call to the same opcode bodies the interpreters use.
+// Programs that are not compiled, and every program on other architectures,
+// keep running on the interpreter.
+
+#pragma once
+
+#include "inc/Main.h"
+#include "inc/Code.h"
+
+namespace graphite2 {
+namespace vm {
+
+class Jit
+{
+public:
+    Jit() throw() : _mem(0), _size(0) {}
+#ifdef GRAPHITE2_JIT
+    ~Jit() throw();
+
+    // Compile the n programs into one block of executable memory and hand
+    // each its native code. Returns false, leaving the programs on the
+    // interpreter, if executable memory cannot be had.
+    bool compile(Machine::Code * const * progs, size_t n) throw();
+#else
+    bool compile(Machine::Code * const *, size_t) throw()   { return false; }
+#endif
+
+    CLASS_NEW_DELETE;
+
+private:
+    byte  * _mem;
+    size_t  _size;
+
+    Jit(const Jit &);
+    Jit & operator = (const Jit &);
+};
+
+} // namespace vm
+} // namespace graphite2
@@ -57,6 +57,12 @@ of the License or (at your option) any later version.
 #define     REGPARM(n)
 #endif
 
+// Native code is only generated for the System V x86-64 calling convention.
+#if defined(GRAPHITE2_JIT) && !(defined(__x86_64__) && !defined(_WIN32) \
+                                && (defined(__GNUC__) || defined(__clang__)))
+#undef GRAPHITE2_JIT
+#endif
+
 #if defined(__MINGW32__)
 // MinGW's <limits> at some point includes winnt.h which #define's a
 // DELETE macro, which conflicts with enum opcode below, so we undefine
@@ -78,6 +84,7 @@ namespace vm
 
 typedef void * instr;
 typedef Slot * slotref;
+typedef void (* native_t)(void * registers);   // a program compiled by Jit
 
 enum {VARARGS = 0xff, MAX_NAME_LEN=32};
 
@@ -122,7 +129,14 @@ enum opcode {
     BITSET,                         SET_FEAT,
     MAX_OPCODE,
     // private opcodes for internal use only, comes after all other on disk opcodes
-    TEMP_COPY = MAX_OPCODE
+    TEMP_COPY = MAX_OPCODE,
+    // superinstructions the decoder fuses common pairs into, each taking
+    // the parameters of both halves in order
+    NEXT2,                          RET_BYTE,
+    PUT_GLYPH_NEXT,                 PUT_SUBS_NEXT,
+    ATTR_SET_BYTE,
+    EQUAL_BYTE,                     NOT_EQ_BYTE,        LESS_EQ_BYTE,
+    NUM_OPCODES
 };
 
 struct opcode_t
@@ -153,7 +167,9 @@ public:
     };
 
     Machine(SlotMap &) throw();
-    static const opcode_t *   getOpcodeTable() throw();
+    // Code whose stack depth is proven at load time is threaded through a
+    // table whose instructions skip the stack check after each one.
+    static const opcode_t *   getOpcodeTable(bool verified = false) throw();
 
     CLASS_NEW_DELETE;
 
@@ -164,7 +180,10 @@ public:
 private:
     void    check_final_stack(const stack_t * const sp);
     stack_t run(const instr * program, const byte * data,
-                slotref * & map) HOT;
+                slotref * & map, bool verified) HOT;
+#ifdef GRAPHITE2_JIT
+    stack_t run(native_t program, const byte * data, slotref * & map) HOT;
+#endif
 
     SlotMap       & _map;
     stack_t         _stack[STACK_MAX + 2*STACK_GUARD];
@@ -61,8 +61,11 @@ struct telemetry
             states,
             starts,
             transitions;
+    size_t  coll_passes,    // collision passes run over a segment
+            coll_skipped;   // of those, ones with nothing to move
 
-    telemetry() : misc(0), silf(0), glyph(0), code(0), states(0), starts(0), transitions(0) {}
+    telemetry() : misc(0), silf(0), glyph(0), code(0), states(0), starts(0), transitions(0),
+                  coll_passes(0), coll_skipped(0) {}
 };
 
 class telemetry::category
@@ -142,6 +145,115 @@ template <typename T> T * grzeroalloc(size_t n)
     return static_cast<T*>(calloc(n, sizeof(T)));
 }
 
+// Lock-free helpers for caches that are lazily filled in on a shared face or
+// font. Values are computed deterministically so any thread may fill a slot,
+// the first pointer published wins and later racers discard their copy.
+#if defined(__GNUC__) || defined(__clang__)
+template <typename T>
+inline T atomic_acquire(T const & v) throw()
+{
+    return __atomic_load_n(&v, __ATOMIC_ACQUIRE);
+}
+
+// Publish p into an empty slot and return whatever the slot ends up holding.
+template <typename T>
+inline T * atomic_publish(T * & slot, T * p) throw()
+{
+    T * expected = 0;
+    if (__atomic_compare_exchange_n(&slot, &expected, p, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return p;
+    return expected;
+}
+
+template <typename T>
+inline T atomic_relaxed_load(T const & v) throw()
+{
+    T r;
+    __atomic_load(&v, &r, __ATOMIC_RELAXED);
+    return r;
+}
+
+template <typename T>
+inline void atomic_relaxed_store(T & v, T x) throw()
+{
+    __atomic_store(&v, &x, __ATOMIC_RELAXED);
+}
+
+// Enough to build a spin lock around short critical sections.
+inline long atomic_acquire_exchange(long & v, long x) throw()
+{
+    return __atomic_exchange_n(&v, x, __ATOMIC_ACQUIRE);
+}
+
+inline void atomic_release_store(long & v, long x) throw()
+{
+    __atomic_store_n(&v, x, __ATOMIC_RELEASE);
+}
+
+// Hand out work items, returns the value before adding x.
+inline long atomic_fetch_add(long & v, long x) throw()
+{
+    return __atomic_fetch_add(&v, x, __ATOMIC_RELAXED);
+}
+#elif defined(_MSC_VER)
+} // namespace graphite2
+
+#include <intrin.h>
+
+namespace graphite2 {
+
+template <typename T>
+inline T atomic_acquire(T const & v) throw()
+{
+    T r = *static_cast<T const volatile *>(&v);
+    _ReadWriteBarrier();
+    return r;
+}
+
+template <typename T>
+inline T * atomic_publish(T * & slot, T * p) throw()
+{
+    void * prev = _InterlockedCompareExchangePointer((void * volatile *)&slot, (void *)p, 0);
+    return prev ? static_cast<T *>(prev) : p;
+}
+
+template <typename T>
+inline T atomic_relaxed_load(T const & v) throw()    { return *static_cast<T const volatile *>(&v); }
+
+template <typename T>
+inline void atomic_relaxed_store(T & v, T x) throw() { *static_cast<T volatile *>(&v) = x; }
+
+inline long atomic_acquire_exchange(long & v, long x) throw()   { return _InterlockedExchange(&v, x); }
+
+inline void atomic_release_store(long & v, long x) throw()
+{
+    _ReadWriteBarrier();
+    *static_cast<long volatile *>(&v) = x;
+}
+
+inline long atomic_fetch_add(long & v, long x) throw() { return _InterlockedExchangeAdd(&v, x); }
+#else
+// No known atomics: fall back to plain accesses, sharing a face between
+// threads is then not supported.
+template <typename T>
+inline T atomic_acquire(T const & v) throw()            { return v; }
+
+template <typename T>
+inline T * atomic_publish(T * & slot, T * p) throw()    { return slot ? slot : (slot = p); }
+
+template <typename T>
+inline T atomic_relaxed_load(T const & v) throw()       { return v; }
+
+template <typename T>
+inline void atomic_relaxed_store(T & v, T x) throw()    { v = x; }
+
+inline long atomic_acquire_exchange(long & v, long x) throw()   { long r = v; v = x; return r; }
+
+inline void atomic_release_store(long & v, long x) throw()      { v = x; }
+
+inline long atomic_fetch_add(long & v, long x) throw()          { long r = v; v += x; return r; }
+#endif
+
 template <typename T>
 inline T min(const T a, const T b)
 {
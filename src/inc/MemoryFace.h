@@ -0,0 +1,68 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#pragma once
+
+#include "graphite2/Font.h"
+
+#include "inc/Main.h"
+#include "inc/TtfTypes.h"
+#include "inc/TtfUtil.h"
+
+namespace graphite2 {
+
+
+// Serves the tables of a font that is already in memory, such as a blob
+// handed to us or a mapped file, by pointing into it rather than copying.
+class MemoryFace
+{
+    static const void * get_table_fn(const void* appFaceHandle, unsigned int name, size_t *len);
+
+public:
+    static const gr_face_ops ops;
+
+    MemoryFace(const void *data, size_t len);
+
+    const void * table(unsigned int name, size_t *len) const;
+
+    operator bool () const throw();
+    CLASS_NEW_DELETE;
+
+private:
+    const byte    * _data;
+    size_t          _data_len;
+
+    const TtfUtil::Sfnt::OffsetSubTable         * _header_tbl;
+    const TtfUtil::Sfnt::OffsetSubTable::Entry  * _table_dir;
+};
+
+inline
+MemoryFace::operator bool() const throw()
+{
+    return _header_tbl && _table_dir;
+}
+
+} // namespace graphite2
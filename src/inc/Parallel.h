@@ -0,0 +1,42 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+// A minimal fork/join helper for spreading face loading over a few threads.
+// Without thread support everything simply runs on the calling thread.
+
+#pragma once
+
+#include "inc/Main.h"
+
+namespace graphite2 {
+
+typedef void (*parallel_job)(void * data, unsigned int item);
+
+// Calls job(data, i) once for every i in [0, n), in no particular order and
+// possibly concurrently. Returns when every call has completed.
+void parallel_for(unsigned int n, parallel_job job, void * data) throw();
+
+} // namespace graphite2
@@ -28,6 +28,9 @@ of the License or (at your option) any later version.
 
 #include <cstdlib>
 #include "inc/Code.h"
+#include "inc/GlyphCoverage.h"
+#include "inc/Jit.h"
+#include "inc/StateTable.h"
 
 namespace graphite2 {
 
@@ -39,9 +42,14 @@ struct RuleEntry;
 struct State;
 class FiniteStateMachine;
 class Error;
+class FeatureMap;
+class FeatureVal;
 class ShiftCollider;
+class CollisionIndex;
 class KernCollider;
 class json;
+class SnapshotReader;
+class SnapshotWriter;
 
 enum passtype;
 
@@ -53,43 +61,114 @@ public:
 
     bool readPass(const byte * pPass, size_t pass_length, size_t subtable_base, Face & face,
         enum passtype pt, uint32 version, Error &e);
+    bool writeImage(SnapshotWriter & w) const;
+    bool readImage(SnapshotReader & r);
+    // Compile the rules to native code, those that cannot be stay interpreted.
+    void compile() throw();
+    // Built with and without tracing to fsm.dbgout.
+    template <bool traced>
     bool runGraphite(vm::Machine & m, FiniteStateMachine & fsm, bool reverse) const;
-    void init(Silf *silf) { m_silf = silf; }
+    void init(const Silf *silf) { m_silf = silf; }
     byte collisionLoops() const { return m_numCollRuns; }
+    // Whether running the pass could change a segment holding these glyphs.
+    bool mayChange(const GlyphCoverage & glyphs) const { return m_numCollRuns || m_kernColls || m_coverage.intersects(glyphs); }
     bool reverseDir() const { return m_isReverseDir; }
+    // The rules' action and constraint programs, two per rule.
+    const vm::Machine::Code * programs() const { return m_codes; }
+    size_t numPrograms() const { return m_numRules*2u; }
+    const Rule * rules() const { return m_rules; }
+    size_t numRules() const { return m_numRules; }
+    // The FSM's tables, in whichever form they were kept.
+    const ColumnMap & columns() const { return m_cols; }
+    const StateTable & transitions() const { return m_transitions; }
+
+    // Grows a set of glyphs for as long as no rule in the pass can match a
+    // run made only of them, by tracking the FSM states such runs reach.
+    class InertGlyphs
+    {
+    public:
+        InertGlyphs(const Pass & pass, const FeatureMap & fmap, const FeatureVal & feats);
+        ~InertGlyphs();
+        operator bool () const throw()  { return m_reached || !m_liveRules; }
+        // Whether gid is already known to let a rule match.
+        bool refuses(uint16 gid) const;
+        // Tentatively add gid, false if a rule could then match.
+        bool admit(uint16 gid);
+        // Keep or drop everything admitted since the last call.
+        void settle(bool keep);
+
+        CLASS_NEW_DELETE
+    private:
+        enum { UNSEEN, KEPT, TENTATIVE, REFUSED };
+        bool    visit(uint16 state);
+        bool    reach(uint16 state);
+
+        const Pass & m_pass;
+        byte       * m_cols,            // per column
+                   * m_reached,         // per state
+                   * m_liveRules;       // rules whose constraint may pass
+        uint16     * m_pendingStates,   // tentatively reached
+                     m_pendingCol;      // tentatively admitted, 0xFFFF if none
+        size_t       m_numPending;
+
+        InertGlyphs(const InertGlyphs &);
+        InertGlyphs & operator = (const InertGlyphs &);
+    };
 
     CLASS_NEW_DELETE
 private:
+    // The rule loop is built for each combination of what a pass may need,
+    // and the one that fits chosen when the pass is loaded. Each comes with
+    // and without tracing, picked per segment.
+    enum
+    {
+        HAS_PRECONTEXT  = 1,
+        HAS_CONSTRAINTS = 2,
+        HAS_DELETES     = 4,
+        TRACED          = 8,
+        NUM_KERNELS     = 16
+    };
+    typedef bool (Pass::*rule_runner)(Slot *, vm::Machine &, FiniteStateMachine &) const;
+
+    void    chooseKernel() throw();
+    template <int kernel>
+    bool    runRules(Slot * s, vm::Machine &, FiniteStateMachine & fsm) const;
+    template <int kernel>
     void    findNDoRule(Slot* & iSlot, vm::Machine &, FiniteStateMachine& fsm) const;
     int     doAction(const vm::Machine::Code* codeptr, Slot * & slot_out, vm::Machine &) const;
-    bool    testPassConstraint(vm::Machine & m) const;
-    bool    testConstraint(const Rule & r, vm::Machine &) const;
+    bool    testPassConstraint(vm::Machine & m, json * const dbgout) const;
+    template <int kernel>
+    bool    testConstraint(const Rule & r, vm::Machine &, FiniteStateMachine & fsm) const;
     bool    readRules(const byte * rule_map, const size_t num_entries,
                      const byte *precontext, const uint16 * sort_key,
                      const uint16 * o_constraint, const byte *constraint_data,
                      const uint16 * o_action, const byte * action_data,
                      Face &, enum passtype pt, Error &e);
     bool    readStates(const byte * starts, const byte * states, const byte * o_rule_map, Face &, Error &e);
-    bool    readRanges(const byte * ranges, size_t num_ranges, Error &e);
+    bool    readRanges(const byte * ranges, size_t num_ranges, uint8 coverage_shift, Error &e);
     uint16  glyphToCol(const uint16 gid) const;
+    template <int kernel>
     bool    runFSM(FiniteStateMachine & fsm, Slot * slot) const;
     void    dumpRuleEventConsidered(const FiniteStateMachine & fsm, const RuleEntry & re) const;
     void    dumpRuleEventOutput(const FiniteStateMachine & fsm, const Rule & r, Slot * os) const;
     void    adjustSlot(int delta, Slot * & slot_out, SlotMap &) const;
+    template <bool traced>
     bool    collisionShift(Segment *seg, int dir, json * const dbgout) const;
+    template <bool traced>
     bool    collisionKern(Segment *seg, int dir, json * const dbgout) const;
+    template <bool traced>
     bool    collisionFinish(Segment *seg, GR_MAYBE_UNUSED json * const dbgout) const;
-    bool    resolveCollisions(Segment *seg, Slot *slot, Slot *start, ShiftCollider &coll, bool isRev,
+    template <bool traced>
+    bool    resolveCollisions(Segment *seg, Slot *slot, Slot *start, ShiftCollider &coll, CollisionIndex &index, bool isRev,
                      int dir, bool &moved, bool &hasCol, json * const dbgout) const;
+    template <bool traced>
     float   resolveKern(Segment *seg, Slot *slot, Slot *start, int dir,
                      float &ymin, float &ymax, json *const dbgout) const;
 
     const Silf        * m_silf;
-    uint16            * m_cols;
     Rule              * m_rules; // rules
     RuleEntry         * m_ruleMap;
     uint16            * m_startStates; // prectxt length
-    uint16            * m_transitions;
     State             * m_states;
     vm::Machine::Code * m_codes;
     byte              * m_progs;
@@ -108,7 +187,13 @@ private:
     byte m_maxPreCtxt;
     byte m_colThreshold;
     bool m_isReverseDir;
+    bool m_setsFeats;       // some action changes a feature value
+    rule_runner       m_runRules[2];  // untraced and traced
     vm::Machine::Code m_cPConstraint;
+    GlyphCoverage     m_coverage;    // glyphs with a column, that a rule could match
+    ColumnMap         m_cols;
+    StateTable        m_transitions;
+    vm::Jit           m_jit;         // native code for m_codes and m_cPConstraint
 
 private:        //defensive
     Pass(const Pass&);
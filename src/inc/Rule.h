@@ -27,6 +27,7 @@ of the License or (at your option) any later version.
 
 #pragma once
 
+#include <cstring>
 #include "inc/Code.h"
 #include "inc/Slot.h"
 
@@ -159,10 +160,39 @@ private:
   };
 
 public:
+  // Results of constraints that only read the glyph they are run on, by
+  // rule, place in the rule, glyph and feature set. A clash overwrites.
+  class Memo
+  {
+  public:
+      enum { UNKNOWN = -1 };
+      Memo();
+      int   find(const Rule & r, uint8 pos, uint16 gid, uint8 fid) const;
+      void  store(const Rule & r, uint8 pos, uint16 gid, uint8 fid, bool passes);
+
+  private:
+      enum { SIZE = 256 };
+      struct entry
+      {
+          const Rule  * rule;
+          uint16        gid;
+          uint8         pos,
+                        fid;
+          bool          passes;
+      };
+      static size_t index(const Rule & r, uint8 pos, uint16 gid, uint8 fid);
+
+      // Only entries marked used are filled in, so there is little to clear
+      // for each segment.
+      uint32  m_used[SIZE/32];
+      entry   m_entries[SIZE];
+  };
+
   FiniteStateMachine(SlotMap & map, json * logger);
   void      reset(Slot * & slot, const short unsigned int max_pre_ctxt);
 
   Rules     rules;
+  Memo      memo;
   SlotMap   & slots;
   json    * const dbgout;
 };
@@ -243,6 +273,40 @@ void FiniteStateMachine::Rules::accumulate_rules(const State &state)
   m_end = out;
 }
 
+inline
+FiniteStateMachine::Memo::Memo()
+{
+  memset(m_used, 0, sizeof m_used);
+}
+
+inline
+size_t FiniteStateMachine::Memo::index(const Rule & r, uint8 pos, uint16 gid, uint8 fid)
+{
+  const size_t h = (reinterpret_cast<size_t>(&r) >> 3) ^ (size_t(gid) * 0x9E5) ^ (size_t(pos) << 5) ^ fid;
+  return (h ^ (h >> 8)) & (SIZE - 1);
+}
+
+inline
+int FiniteStateMachine::Memo::find(const Rule & r, uint8 pos, uint16 gid, uint8 fid) const
+{
+  const size_t i = index(r, pos, gid, fid);
+  const entry & e = m_entries[i];
+  return (m_used[i >> 5] & (1u << (i & 31))) && e.rule == &r && e.gid == gid && e.pos == pos && e.fid == fid ? int(e.passes) : int(UNKNOWN);
+}
+
+inline
+void FiniteStateMachine::Memo::store(const Rule & r, uint8 pos, uint16 gid, uint8 fid, bool passes)
+{
+  const size_t i = index(r, pos, gid, fid);
+  entry & e = m_entries[i];
+  m_used[i >> 5] |= 1u << (i & 31);
+  e.rule = &r;
+  e.gid = gid;
+  e.pos = pos;
+  e.fid = fid;
+  e.passes = passes;
+}
+
 inline
 SlotMap::SlotMap(Segment & seg, uint8 direction, size_t maxSize)
 : segment(seg), m_size(0), m_precontext(0), m_highwater(0),
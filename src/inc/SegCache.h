@@ -0,0 +1,83 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+#pragma once
+
+#include "inc/Main.h"
+#include "inc/FeatureVal.h"
+
+namespace graphite2 {
+
+class Face;
+class Segment;
+class Silf;
+
+// A bounded, least recently used cache of shaped sub-segments. Segments are
+// split into runs of whitespace and non-whitespace characters, each run is
+// looked up by its code points, features, script, direction and Silf, and the
+// cached slots are spliced into the segment instead of running the passes.
+class SegCache
+{
+    SegCache(const SegCache &);
+    SegCache & operator = (const SegCache &);
+
+    struct Entry;
+    struct Key;
+
+public:
+    SegCache(const Face & face, size_t maxSegments);
+    ~SegCache();
+
+    bool    suits(const Segment & seg) const;
+    bool    runGraphite(Segment & seg, uint32 script);
+
+    size_t  hits() const    { return m_hits; }
+    size_t  misses() const  { return m_misses; }
+    size_t  size() const    { return m_size; }
+
+    CLASS_NEW_DELETE;
+
+private:
+    bool    shapeRun(Segment & seg, uint32 script, int8 dir, int start, size_t length, const uint32 * usv);
+    Entry * find(const Key & key);
+    void    insert(Entry * e);
+    void    unlink(Entry * e);
+    void    lock() const;
+    void    unlock() const;
+
+    const Face    & m_face;
+    Entry        ** m_buckets;
+    Entry         * m_newest,
+                  * m_oldest;
+    size_t          m_maxSize,
+                    m_size,
+                    m_mask,
+                    m_hits,
+                    m_misses;
+    mutable long    m_lock;
+};
+
+} // namespace graphite2
@@ -34,6 +34,7 @@ of the License or (at your option) any later version.
 #include "inc/Face.h"
 #include "inc/FeatureVal.h"
 #include "inc/GlyphCache.h"
+#include "inc/GlyphCoverage.h"
 #include "inc/GlyphFace.h"
 #include "inc/Slot.h"
 #include "inc/Position.h"
@@ -41,12 +42,12 @@ of the License or (at your option) any later version.
 #include "inc/Collider.h"
 
 #define MAX_SEG_GROWTH_FACTOR  64
+#define SLOT_ALIGN             64      // slots are allocated on cache lines
 
 namespace graphite2 {
 
 typedef Vector<Features>        FeatureList;
-typedef Vector<Slot *>          SlotRope;
-typedef Vector<int16 *>         AttributeRope;
+typedef Vector<byte *>          SlotRope;
 typedef Vector<SlotJustify *>   JustifyRope;
 
 class Font;
@@ -85,7 +86,8 @@ public:
 
     enum {
         SEG_INITCOLLISIONS = 1,
-        SEG_HASCOLLISIONS = 2
+        SEG_HASCOLLISIONS = 2,
+        SEG_TRACED = 4          // made while the face was logging
     };
 
     size_t slotCount() const { return m_numGlyphs; }      //one slot per glyph
@@ -100,9 +102,11 @@ public:
 
     Segment(size_t numchars, const Face* face, uint32 script, int dir);
     ~Segment();
+    void reset(size_t numchars, const Face* face, uint32 script, int dir);
     uint8 flags() const { return m_flags; }
     void flags(uint8 f) { m_flags = f; }
     Slot *first() { return m_first; }
+    const Slot *first() const { return m_first; }
     void first(Slot *p) { m_first = p; }
     Slot *last() { return m_last; }
     void last(Slot *p) { m_last = p; }
@@ -113,10 +117,15 @@ public:
     void freeJustify(SlotJustify *aJustify);
     Position positionSlots(const Font *font=0, Slot *first=0, Slot *last=0, bool isRtl = false, bool isFinal = true);
     void associateChars(int offset, size_t num);
+    bool splice(const Segment & sub, int charOffset);
     void linkClusters(Slot *first, Slot *last);
     uint16 getClassGlyph(uint16 cid, uint16 offset) const { return m_silf->getClassGlyph(cid, offset); }
     uint16 findClassIndex(uint16 cid, uint16 gid) const { return m_silf->findClassIndex(cid, gid); }
-    int addFeatures(const Features& feats) { m_feats.push_back(feats); return int(m_feats.size()) - 1; }
+    int addFeatures(const Features& feats) {
+        // A reset segment refills its old feature storage rather than reallocating it.
+        if (m_numFeats < m_feats.size()) m_feats[m_numFeats] = feats;
+        else                             m_feats.push_back(feats);
+        return int(m_numFeats++); }
     uint32 getFeature(int index, uint8 findex) const { const FeatureRef* pFR=m_face->theSill().theFeatureMap().featureRef(findex); if (!pFR) return 0; else return pFR->getFeatureVal(m_feats[index]); }
     void setFeature(int index, uint8 findex, uint32 val) {
         const FeatureRef* pFR=m_face->theSill().theFeatureMap().featureRef(findex);
@@ -130,6 +139,8 @@ public:
     bool currdir() const { return ((m_dir >> 6) ^ m_dir) & 1; }
     uint8 passBits() const { return m_passBits; }
     void mergePassBits(const uint8 val) { m_passBits &= val; }
+    const GlyphCoverage & coverage() const { return m_coverage; }
+    void addCoverage(uint16 gid) { m_coverage.add(gid, m_coverageShift); }
     int16 glyphAttr(uint16 gid, uint16 gattr) const { const GlyphFace * p = m_face->glyphs().glyphSafe(gid); return p ? p->attrs()[gattr] : 0; }
     int32 getGlyphMetric(Slot *iSlot, uint8 metric, uint8 attrLevel, bool rtl) const;
     float glyphAdvance(uint16 gid) const { return m_face->glyphs().glyph(gid)->theAdvance().x; }
@@ -138,7 +149,8 @@ public:
     int numAttrs() const { return m_silf->numUser(); }
     int defaultOriginal() const { return m_defaultOriginal; }
     const Face * getFace() const { return m_face; }
-    const Features & getFeatures(unsigned int /*charIndex*/) { assert(m_feats.size() == 1); return m_feats[0]; }
+    const Features & getFeatures(unsigned int /*charIndex*/) { assert(m_numFeats == 1); return m_feats[0]; }
+    bool allFeaturesAre(const Features & feats) const { return m_numFeats == 1 && m_feats[0] == feats; }
     void bidiPass(int paradir, uint8 aMirror);
     int8 getSlotBidiClass(Slot *s) const;
     void doMirror(uint16 aMirror);
@@ -160,14 +172,16 @@ public:       //only used by: GrSegment* makeAndInitialize(const GrFont *font, c
 
 private:
     Position        m_advance;          // whole segment advance
-    SlotRope        m_slots;            // Vector of slot buffers
-    AttributeRope   m_userAttrs;        // Vector of userAttrs buffers
+    SlotRope        m_slots;            // Vector of slot buffers, each with its slots' userAttrs
     JustifyRope     m_justifies;        // Slot justification info buffers
     FeatureList     m_feats;            // feature settings referenced by charinfos in this segment
     Slot          * m_freeSlots;        // linked list of free slots
     SlotJustify   * m_freeJustifies;    // Slot justification blocks free list
     CharInfo      * m_charinfo;         // character info, one per input character
     SlotCollision * m_collisions;
+    size_t          m_charinfoSize,     // allocated lengths of m_charinfo and m_collisions
+                    m_collisionsSize,
+                    m_numFeats;         // feature sets in use, m_feats may hold more from before a reset
     const Face    * m_face;             // GrFace
     const Silf    * m_silf;
     Slot          * m_first;            // first slot in segment
@@ -178,7 +192,9 @@ private:
     int             m_defaultOriginal;  // number of whitespace chars in the string
     int8            m_dir;
     uint8           m_flags,            // General purpose flags
-                    m_passBits;         // if bit set then skip pass
+                    m_passBits,         // if bit set then skip pass
+                    m_coverageShift;
+    GlyphCoverage   m_coverage;         // every glyph that has been in the segment
 };
 
 inline
@@ -231,6 +247,27 @@ bool Segment::isWhitespace(const int cid) const
          + (cid == 0x3000)) != 0;
 }
 
+
+// Holds on to segments the caller has finished with so the next one can be
+// shaped in their buffers.
+class ShapeContext
+{
+public:
+    ShapeContext() {}
+    ~ShapeContext();
+
+    Segment * acquire(size_t numchars, const Face * face, uint32 script, int dir);
+    void release(Segment * seg);
+
+    CLASS_NEW_DELETE
+private:
+    Vector<Segment *>   m_spares;
+
+    ShapeContext(const ShapeContext &);
+    ShapeContext & operator = (const ShapeContext &);
+};
+
 } // namespace graphite2
 
 struct gr_segment : public graphite2::Segment {};
+struct gr_shape_context : public graphite2::ShapeContext {};
@@ -37,6 +37,8 @@ class Segment;
 class FeatureVal;
 class VMScratch;
 class Error;
+class SnapshotReader;
+class SnapshotWriter;
 
 class Pseudo
 {
@@ -74,8 +76,14 @@ public:
     Silf() throw();
     ~Silf() throw();
 
-    bool readGraphite(const byte * const pSilf, size_t lSilf, Face &face, uint32 version);
+    bool readGraphite(const byte * const pSilf, size_t lSilf, Face &face, uint32 version, uint32 faceOptions = 0);
+    bool writeImage(SnapshotWriter & w) const;
+    bool readImage(SnapshotReader & r, const Face & face, uint32 faceOptions = 0);
     bool runGraphite(Segment *seg, uint8 firstPass=0, uint8 lastPass=0, int dobidi = 0) const;
+    // As above, built with or without tracing to the face's logger.
+    template <bool traced>
+    bool runGraphite(Segment *seg, uint8 firstPass, uint8 lastPass, int dobidi) const;
+    bool bypasses(const Segment & seg) const;
     uint16 findClassIndex(uint16 cid, uint16 gid) const;
     uint16 getClassGlyph(uint16 cid, unsigned int index) const;
     uint16 findPseudo(uint32 uid) const;
@@ -91,6 +99,7 @@ public:
     uint8 justificationPass() const { return m_jPass; }
     uint8 bidiPass() const { return m_bPass; }
     uint8 numPasses() const { return m_numPasses; }
+    const Pass * pass(size_t i) const;
     uint8 maxCompPerLig() const { return m_iMaxComp; }
     uint16 numClasses() const { return m_nClass; }
     byte  flags() const { return m_flags; }
@@ -105,12 +114,52 @@ public:
 private:
     size_t readClassMap(const byte *p, size_t data_len, uint32 version, Error &e);
     template<typename T> inline uint32 readClassOffsets(const byte *&p, size_t data_len, Error &e);
+    bool buildClassIndex() throw();
+    void fillSilfInfo(const Face & face) throw();
+    void findInertGlyphs(const Face & face) throw();
+    bool readPass(Pass & pass, size_t i, const byte * const silf_start, size_t lSilf, size_t passes_start,
+                  const byte * const o_passes, Face & face, uint32 version) const;
+    bool readPassesParallel(const byte * const silf_start, size_t lSilf, size_t passes_start,
+                            const byte * const o_passes, Face & face, uint32 version);
+
+    const Pass * decodePass(size_t i) const;
+
+    struct PassLoad;
+    static void readPassJob(void * data, unsigned int i);
+
+    // Where to find a glyph's index in a lookup class without searching it:
+    // a table over the span of its glyphs when they are close together,
+    // otherwise a hash table of (glyph, index) pairs.
+    struct ClassLookup
+    {
+        uint32  offset;     // into m_classIndex, ~0U to search the class
+        uint16  base,       // first glyph in a dense table
+                mask;       // dense: span - 1, hashed: slots - 1
+        bool    hashed;
+    };
+
+    // Where to find each pass when they are decoded on first use.
+    struct LazyPasses
+    {
+        Face          * face;
+        const byte    * silf_start,
+                      * o_passes;
+        size_t          lSilf,
+                        passes_start;
+        uint32          version;
+        Pass        * * passes;     // published as each one is decoded
+    };
 
     Pass          * m_passes;
+    LazyPasses    * m_lazy;
     Pseudo        * m_pseudos;
     uint32        * m_classOffsets;
     uint16        * m_classData;
+    ClassLookup   * m_classLookups;     // per lookup class, built as classes are read
+    uint16        * m_classIndex;
     Justinfo      * m_justs;
+    uint32        * m_inertGlyphs;      // glyphs no rule can match a run of, 0 if unknown
+    uint16          m_numInertGlyphs;
     uint8           m_numPasses;
     uint8           m_numJusts;
     uint8           m_sPass, m_pPass, m_jPass, m_bPass,
@@ -120,9 +169,18 @@ private:
                 m_iMaxComp, m_aCollision;
     uint16      m_aLig, m_numPseudo, m_nClass, m_nLinear,
                 m_gEndLine;
+    bool        m_compile;          // compile passes to native code as they are read
     gr_faceinfo m_silfinfo;
 
     void releaseBuffers() throw();
 };
 
+inline
+const Pass * Silf::pass(size_t i) const
+{
+    if (m_passes)   return m_passes + i;
+    const Pass * const p = atomic_acquire(m_lazy->passes[i]);
+    return p ? p : decodePass(i);
+}
+
 } // namespace graphite2
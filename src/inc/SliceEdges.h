@@ -0,0 +1,63 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2015, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+// How far a glyph reaches across each of the horizontal slices KernCollider
+// cuts the target's cluster into.  A neighbour usually spans a handful of
+// slices, and each slice is worked out the same way from the same box, so
+// they can be done a vector lane each.  Every way gives the same floats to
+// the bit.
+
+#pragma once
+
+#include "inc/Main.h"
+#include "inc/GlyphCache.h"
+
+namespace graphite2 {
+
+// Slice i is centred on base + (i + .5) * width.  A box's edge is pushed out
+// by margin, and counts in any slice it comes within margin of.
+struct SliceRun
+{
+    float   base,
+            width,
+            margin;
+    bool    right;  // the right hand edge, else the left
+};
+
+// Takes slices first..first+n-1 of the glyph at sx, sy out to the edge of
+// the box bb, sb where it reaches further than edges[0..n) already does.
+// A glyph with no sub-boxes has just its main box, which sets the edge in
+// any slice it is in, and sub says which this is.
+typedef void (*slice_edges_fn)(const SliceRun & run, int first, int n,
+                               const BBox & bb, const SlantBox & sb, bool sub,
+                               float sx, float sy, float * edges);
+
+enum slice_edges_kind { SLICE_EDGES_SCALAR, SLICE_EDGES_SSE, SLICE_EDGES_BEST };
+
+// The given way of finding edges, or 0 if this build can't do it that way.
+slice_edges_fn slice_edges(slice_edges_kind kind = SLICE_EDGES_BEST) throw();
+
+} // namespace graphite2
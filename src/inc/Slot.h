@@ -69,6 +69,9 @@ class Slot
 public:
     struct iterator;
 
+    // column() until a pass has classified the slot's glyph
+    enum { UNCLASSIFIED = 0xFFFE };
+
     unsigned short gid() const { return m_glyphid; }
     Position origin() const { return m_position; }
     float advance() const { return m_advance.x; }
@@ -78,6 +81,8 @@ public:
     int after() const { return m_after; }
     uint32 index() const { return m_index; }
     void index(uint32 val) { m_index = val; }
+    uint16 column() const { return m_col; }
+    void column(uint16 col) { m_col = col; }
 
     Slot(int16 *m_userAttr = NULL);
     void set(const Slot & slot, int charOffset, size_t numUserAttr, size_t justLevels, size_t numChars);
@@ -138,28 +143,33 @@ public:
     CLASS_NEW_DELETE
 
 private:
+    // Segment allocates slots on cache line boundaries. Everything rule
+    // matching and the VM look at is kept in the first line, positioning
+    // and justification state in the second.
     Slot *m_next;           // linked list of slots
     Slot *m_prev;
-    unsigned short m_glyphid;        // glyph id
-    uint16 m_realglyphid;
-    uint32 m_original;      // charinfo that originated this slot (e.g. for feature values)
-    uint32 m_before;        // charinfo index of before association
-    uint32 m_after;         // charinfo index of after association
-    uint32 m_index;         // slot index given to this slot during finalising
     Slot *m_parent;         // index to parent we are attached to
     Slot *m_child;          // index to first child slot that attaches to us
     Slot *m_sibling;        // index to next child that attaches to our parent
+    int16   *m_userAttr;    // pointer to user attributes
+    unsigned short m_glyphid;        // glyph id
+    uint16 m_realglyphid;
+    uint8    m_flags;       // holds bit flags
+    byte     m_attLevel;    // attachment level
+    int8     m_bidiCls;     // bidirectional class
+    byte     m_bidiLevel;   // bidirectional level
+    uint32 m_original;      // charinfo that originated this slot (e.g. for feature values)
+    uint16 m_col;           // FSM column of the glyph in the running pass
+
     Position m_position;    // absolute position of glyph
     Position m_shift;       // .shift slot attribute
     Position m_advance;     // .advance slot attribute
     Position m_attach;      // attachment point on us
     Position m_with;        // attachment point position on parent
+    uint32 m_before;        // charinfo index of before association
+    uint32 m_after;         // charinfo index of after association
     float    m_just;        // Justification inserted space
-    uint8    m_flags;       // holds bit flags
-    byte     m_attLevel;    // attachment level
-    int8     m_bidiCls;     // bidirectional class
-    byte     m_bidiLevel;   // bidirectional level
-    int16   *m_userAttr;    // pointer to user attributes
+    uint32 m_index;         // slot index given to this slot during finalising
     SlotJustify *m_justs;   // pointer to justification parameters
 
     friend class Segment;
@@ -0,0 +1,147 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+// Readers and writers for face snapshot images.  A snapshot holds the decoded
+// Silf subtables of a face (passes, state machines, rules, classes and
+// compiled code) in native byte order with every pointer replaced by an
+// index, so an image can be written once and mapped into any process.
+
+#pragma once
+
+#include <cstring>
+
+#include "inc/Main.h"
+
+namespace graphite2 {
+
+// Bump this whenever the layout of anything written to an image changes,
+// including the decoded form of the stack machine code.
+enum { SNAPSHOT_MAGIC = 0x53327247, SNAPSHOT_VERSION = 2 };
+
+struct SnapshotHeader
+{
+    uint32  magic,
+            version,
+            byte_order,
+            head_checksum,
+            silf_checksum,
+            silf_size;
+    uint16  num_glyphs,
+            num_attrs,
+            num_features,
+            num_opcodes;
+    uint32  body_size,
+            body_checksum;
+};
+
+// The same sum of 32 bit words that sfnt table directories use.
+inline
+uint32 snapshotChecksum(const void * data, size_t n)
+{
+    const byte * p = static_cast<const byte *>(data);
+    uint32 sum = uint32(n), w;
+    for (; n >= sizeof w; n -= sizeof w, p += sizeof w)
+    {
+        memcpy(&w, p, sizeof w);
+        sum += w;
+    }
+    w = 0;
+    if (n) memcpy(&w, p, n);
+    return sum + w;
+}
+
+
+// Counts everything it is given but only writes what fits, so a first pass
+// with no buffer sizes the image.
+class SnapshotWriter
+{
+    byte      * _p;
+    byte      * const _end;
+    size_t      _size;
+
+public:
+    SnapshotWriter(void * buf, size_t len) throw()
+    : _p(static_cast<byte *>(buf)), _end(_p + (buf ? len : 0)), _size(0) {}
+
+    void write(const void * data, size_t n) throw()
+    {
+        _size += n;
+        if (!_p || size_t(_end - _p) < n)  { _p = 0; return; }
+        if (n) memcpy(_p, data, n);
+        _p += n;
+    }
+
+    template <typename T>
+    void write(const T v) throw()    { write(&v, sizeof v); }
+
+    size_t  size() const throw()    { return _size; }
+    bool    complete() const throw(){ return _p != 0; }
+};
+
+
+// Every read is bounds checked, once a read fails all following reads return
+// zero and the reader stays false.
+class SnapshotReader
+{
+    const byte    * _p;
+    const byte    * const _end;
+
+public:
+    SnapshotReader(const void * data, size_t len) throw()
+    : _p(static_cast<const byte *>(data)), _end(_p + len) {}
+
+    bool read(void * data, size_t n) throw()
+    {
+        if (!_p || size_t(_end - _p) < n)   { _p = 0; memset(data, 0, n); return false; }
+        if (n) memcpy(data, _p, n);
+        _p += n;
+        return true;
+    }
+
+    template <typename T>
+    T read() throw()                { T v; read(&v, sizeof v); return v; }
+
+    // Read n items of T into a fresh gralloc'd array.
+    template <typename T>
+    T * readArray(size_t n) throw()
+    {
+        size_t bytes;
+        if (!_p || checked_mul(n, sizeof(T), bytes) || size_t(_end - _p) < bytes) { _p = 0; return 0; }
+        T * const a = gralloc<T>(n ? n : 1);
+        if (a && n) memcpy(a, _p, bytes);
+        _p = a ? _p + bytes : 0;
+        return a;
+    }
+
+    // A bad index or count is as fatal as running off the end.
+    bool test(bool fail) throw()    { if (fail) _p = 0; return _p != 0; }
+
+    size_t remaining() const throw(){ return _p ? size_t(_end - _p) : 0; }
+    operator bool () const throw()  { return _p != 0; }
+    bool atEnd() const throw()      { return _p == _end; }
+};
+
+} // namespace graphite2
@@ -0,0 +1,116 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+// The tables a pass's FSM steps through: which column each glyph is in, and
+// which state each state goes to on each column.  Both are read from the
+// font as dense arrays and kept in a smaller form when that saves memory.
+
+#pragma once
+
+#include "inc/Main.h"
+
+namespace graphite2 {
+
+// Glyph id to FSM column, 0xFFFF for glyphs no rule mentions.  When it saves
+// a quarter of the dense map, it is kept in pages of consecutive glyphs with
+// each distinct page stored once, so that the long runs of glyphs from other
+// scripts share a single page.
+class ColumnMap
+{
+public:
+    static const unsigned int PAGE_BITS = 6,
+                              PAGE_SIZE = 1 << PAGE_BITS;
+
+    ColumnMap() throw() : m_pages(0), m_cols(0), m_numGlyphs(0), m_numPages(0) {}
+    ~ColumnMap() throw();
+
+    // Takes over cols, a column for each of num_glyphs glyphs.
+    bool    build(uint16 * cols, uint16 num_glyphs) throw();
+
+    uint16  operator [] (uint16 gid) const throw()
+    {
+        if (gid >= m_numGlyphs) return 0xffffU;
+        return m_pages ? m_cols[m_pages[gid >> PAGE_BITS] << PAGE_BITS | (gid & (PAGE_SIZE - 1))] : m_cols[gid];
+    }
+    bool    compact() const throw()     { return m_pages != 0; }
+    uint16  numGlyphs() const throw()   { return m_numGlyphs; }
+    size_t  size() const throw();       // bytes held
+
+    CLASS_NEW_DELETE;
+private:
+    uint16    * m_pages,        // page number for each page of glyphs, 0 if dense
+              * m_cols;         // the distinct pages or the dense map
+    uint16      m_numGlyphs,
+                m_numPages;     // distinct
+
+    ColumnMap(const ColumnMap &);
+    ColumnMap & operator = (const ColumnMap &);
+};
+
+// The transition matrix, a row of next states per transition state with 0
+// where the FSM stops.  Most rows are mostly 0, so when it is smaller they
+// are overlaid in one array by row displacement: each row starts at its own
+// offset, where its non-zero entries fall on slots no other row uses, and
+// every slot records which row owns it.
+class StateTable
+{
+public:
+    StateTable() throw() : m_dense(0), m_base(0), m_slots(0), m_numRows(0), m_numColumns(0), m_numSlots(0) {}
+    ~StateTable() throw();
+
+    // Takes over trans, rows * columns next states.  Unless compact is false
+    // it is overlaid if that is smaller.
+    bool    build(uint16 * trans, uint16 rows, uint16 columns, bool compact = true) throw();
+
+    uint16  operator () (uint16 state, uint16 col) const throw()
+    {
+        if (!m_base)    return m_dense[state*m_numColumns + col];
+        const slot & s = m_slots[m_base[state] + col];
+        return s.row == state ? s.next : 0;
+    }
+    bool    compact() const throw()     { return m_base != 0; }
+    uint16  numRows() const throw()     { return m_numRows; }
+    uint16  numColumns() const throw()  { return m_numColumns; }
+    size_t  size() const throw();       // bytes held
+
+    CLASS_NEW_DELETE;
+private:
+    struct slot { uint16 row, next; };
+
+    bool    overlay() throw();
+
+    uint16    * m_dense;
+    uint32    * m_base;         // per row, where its columns start in m_slots
+    slot      * m_slots;
+    uint16      m_numRows,
+                m_numColumns;
+    uint32      m_numSlots;
+
+    StateTable(const StateTable &);
+    StateTable & operator = (const StateTable &);
+};
+
+} // namespace graphite2
@@ -120,5 +120,13 @@ static const opcode_t opcode_table[] =
     {{do2(setbits)},                                4, "BITSET"},
     {{do_(set_feat), NILOP},                        2, "SET_FEAT"},                 // featidx slot
     // private opcodes for internal use only, comes after all other on disk opcodes.
-    {{do_(temp_copy), NILOP},                       0, "TEMP_COPY"}
+    {{do_(temp_copy), NILOP},                       0, "TEMP_COPY"},
+    {{do_(next2), NILOP},                           0, "NEXT2"},
+    {{do2(ret_byte)},                               1, "RET_BYTE"},                 // number
+    {{do_(put_glyph_next), NILOP},                  2, "PUT_GLYPH_NEXT"},           // output_class output_class
+    {{do_(put_subs_next), NILOP},                   5, "PUT_SUBS_NEXT"},            // slot input_class input_class output_class output_class
+    {{do_(attr_set_byte), NILOP},                   2, "ATTR_SET_BYTE"},            // number sattrnum
+    {{do2(equal_byte)},                             1, "EQUAL_BYTE"},               // number
+    {{do2(not_eq_byte)},                            1, "NOT_EQ_BYTE"},              // number
+    {{do2(less_eq_byte)},                           1, "LESS_EQ_BYTE"}              // number
 };
@@ -78,6 +78,14 @@ of the License or (at your option) any later version.
 #define pop()               (*sp--)
 #define slotat(x)           (map[(x)])
 #define DIE                 { is=seg.last(); status = Machine::died_early; EXIT(1); }
+#define next_slot()         { if (map - &smap[0] >= int(smap.size())) DIE \
+                              if (is) \
+                              { \
+                                  if (is == smap.highwater()) \
+                                      smap.highpassed(true); \
+                                  is = is->next(); \
+                              } \
+                              ++map; }
 #define POSITIONED          1
 
 STARTOP(nop)
@@ -200,14 +208,7 @@ STARTOP(gtr_eq)
 ENDOP
 
 STARTOP(next)
-    if (map - &smap[0] >= int(smap.size())) DIE
-    if (is)
-    {
-        if (is == smap.highwater())
-            smap.highpassed(true);
-        is = is->next();
-    }
-    ++map;
+    next_slot();
 ENDOP
 
 //STARTOP(next_n)
@@ -689,3 +690,62 @@ STARTOP(set_feat)
         seg.setFeature(fid, feat, pop());
     }
 ENDOP
+
+// Superinstructions, each does the work of the pair of opcodes it was fused
+// from by the decoder.
+
+STARTOP(next2)
+    next_slot();
+    next_slot();
+ENDOP
+
+STARTOP(ret_byte)
+    declare_params(1);
+    EXIT(int8(*param));
+ENDOP
+
+STARTOP(put_glyph_next)
+    declare_params(2);
+    const unsigned int output_class  = uint8(param[0]) << 8
+                                     | uint8(param[1]);
+    is->setGlyph(&seg, seg.getClassGlyph(output_class, 0));
+    next_slot();
+ENDOP
+
+STARTOP(put_subs_next)
+    declare_params(5);
+    const int        slot_ref     = int8(param[0]);
+    const unsigned int  input_class  = uint8(param[1]) << 8
+                                     | uint8(param[2]);
+    const unsigned int  output_class = uint8(param[3]) << 8
+                                     | uint8(param[4]);
+    slotref slot = slotat(slot_ref);
+    if (slot)
+    {
+        int index = seg.findClassIndex(input_class, slot->gid());
+        is->setGlyph(&seg, seg.getClassGlyph(output_class, index));
+    }
+    next_slot();
+ENDOP
+
+STARTOP(attr_set_byte)
+    declare_params(2);
+    const          int  val  = int8(param[0]);
+    const attrCode      slat = attrCode(uint8(param[1]));
+    is->setAttr(&seg, slat, 0, val, smap);
+ENDOP
+
+STARTOP(equal_byte)
+    declare_params(1);
+    *sp = uint32(*sp) == uint32(int8(*param));
+ENDOP
+
+STARTOP(not_eq_byte)
+    declare_params(1);
+    *sp = uint32(*sp) != uint32(int8(*param));
+ENDOP
+
+STARTOP(less_eq_byte)
+    declare_params(1);
+    *sp = int32(*sp) <= int32(int8(*param));
+ENDOP
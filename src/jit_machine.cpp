@@ -0,0 +1,600 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+
+Alternatively, the contents of this file may be used under the terms of the
+Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
+License, as published by the Free Software Foundation, either version 2
+of the License or (at your option) any later version.
+*/
+// This native code generator for machine.h
+//
+// Each program is compiled to a straight line of x86-64 code following the
+// System V calling convention, with these registers live throughout:
+//      rbx     the regbank
+//      r12     the program's data
+//      r15     the stack pointer
+// Opcodes that only shuffle values on the stack, and the context item jump,
+// are generated inline. The rest call the opcode bodies from opcodes.h, built
+// here as plain functions taking the stack pointer and their parameters in
+// registers and handing back the new stack pointer. Where each instruction's
+// parameters start is known when compiling, so unlike the interpreters
+// nothing needs to track dp or ip at run time.
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <graphite2/Segment.h>
+#include "inc/Jit.h"
+#include "inc/Machine.h"
+#include "inc/Segment.h"
+#include "inc/Slot.h"
+#include "inc/Rule.h"
+
+#ifdef GRAPHITE2_JIT
+
+#include <sys/mman.h>
+
+// Disable the unused parameter warning as th compiler is mistaken since dp
+// is always updated (even if by 0) on every opcode.
+#ifdef __GNUC__
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#endif
+
+#define registers           vm::Machine::stack_t * sp, const byte * dp, regbank & reg
+
+// These are required by opcodes.h and should not be changed. A stack pointer
+// handed back with its lowest bit set stops the program.
+#define STARTOP(name)       Machine::stack_t * name(registers) {
+#define ENDOP                   return (sp - reg.sb)/Machine::STACK_MAX==0 ? sp : stopped(sp); \
+                            }
+
+#define EXIT(status)        { push(status); return stopped(sp); }
+
+// This is required by opcode_table.h
+#define do_(name)           instr(name)
+
+
+using namespace graphite2;
+using namespace vm;
+
+namespace {
+
+// Generated code reaches into this by offset so it only holds plain pointers.
+struct regbank  {
+    const byte        * dp;         // the data on entry
+    Machine::stack_t  * sp;         // the stack pointer on exit
+    Machine::stack_t  * sb;
+    slotref             is;
+    slotref           * map;
+    slotref           * map_base;
+    SlotMap           * smap;
+    Machine::status_t * status;
+    const instr       * ip;         // context items are generated inline
+    uint8               direction;
+    int8                flags;
+};
+
+enum {
+    REG_DP = offsetof(regbank, dp),
+    REG_SP = offsetof(regbank, sp),
+    REG_MAP = offsetof(regbank, map),
+    REG_MAPB = offsetof(regbank, map_base)
+};
+
+inline Machine::stack_t * stopped(Machine::stack_t * sp) throw()
+{
+    return reinterpret_cast<Machine::stack_t *>(reinterpret_cast<uintptr>(sp) | 1);
+}
+
+// Pull in the opcode definitions
+#define smap    (*reg.smap)
+#define seg     smap.segment
+#define is      reg.is
+#define ip      reg.ip
+#define map     reg.map
+#define mapb    reg.map_base
+#define flags   reg.flags
+#define dir     reg.direction
+#define status  (*reg.status)
+
+#include "inc/opcodes.h"
+
+#undef smap
+#undef seg
+#undef is
+#undef ip
+#undef map
+#undef mapb
+#undef flags
+#undef dir
+#undef status
+
+// Pull in the opcode table
+#include "inc/opcode_table.h"
+
+// Programs hold the interpreter's instrs, this finds the opcode behind each.
+class opcode_index
+{
+    struct entry
+    {
+        uintptr impl;
+        uint8   opc;
+    };
+
+    entry   _entries[4*NUM_OPCODES];
+    size_t  _size;
+
+    void build() throw();
+
+public:
+    static const opcode_index & get() throw();
+    int find(const instr i) const throw();
+};
+
+// The tables never change, so the index is built once, by whichever face
+// is compiled first.  It has no constructor, so needs no guard variable
+// from the C++ runtime, and is locked as SegCache is instead.
+const opcode_index & opcode_index::get() throw()
+{
+    static opcode_index index;
+    static long         built, lock;
+
+    if (!atomic_acquire(built))
+    {
+        while (atomic_acquire_exchange(lock, 1L)) {}
+        if (!built)
+        {
+            index.build();
+            atomic_release_store(built, 1L);
+        }
+        atomic_release_store(lock, 0L);
+    }
+    return index;
+}
+
+// Programs are threaded through either of the interpreter's tables.
+void opcode_index::build() throw()
+{
+    _size = 0;
+    for (int verified = 0; verified != 2; ++verified)
+    for (uint8 opc = 0; opc != NUM_OPCODES; ++opc)
+        for (int c = 0; c != 2; ++c)
+        {
+            const opcode_t * const table = Machine::getOpcodeTable(verified);
+            const uintptr impl = reinterpret_cast<uintptr>(table[opc].impl[c]);
+            if (!impl) continue;
+            size_t n = _size;
+            while (n && _entries[n-1].impl > impl) --n;
+            if (n && _entries[n-1].impl == impl) continue;
+            memmove(_entries + n + 1, _entries + n, (_size - n) * sizeof(entry));
+            const entry e = { impl, opc };
+            _entries[n] = e;
+            ++_size;
+        }
+}
+
+int opcode_index::find(const instr ins) const throw()
+{
+    const uintptr i = reinterpret_cast<uintptr>(ins);
+    size_t lo = 0, hi = _size;
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (_entries[mid].impl < i)     lo = mid + 1;
+        else                            hi = mid;
+    }
+    return lo < _size && _entries[lo].impl == i ? _entries[lo].opc : -1;
+}
+
+// Writes code to out, or just counts it when out is null so the same
+// translation can size the buffer first.
+class assembler
+{
+    byte  * const   _out;
+    size_t          _pos;
+
+public:
+    explicit assembler(byte * out) throw() : _out(out), _pos(0) {}
+
+    size_t  pos() const throw()     { return _pos; }
+
+    void    emit(const byte * code, size_t n) throw()
+    {
+        if (_out) memcpy(_out + _pos, code, n);
+        _pos += n;
+    }
+
+    void    imm32(uint32 v) throw()
+    {
+        const byte b[4] = { byte(v), byte(v >> 8), byte(v >> 16), byte(v >> 24) };
+        emit(b, sizeof b);
+    }
+
+    void    imm64(uintptr v) throw()
+    {
+        imm32(uint32(v));
+        imm32(uint32(v >> 32));
+    }
+
+    // Fill in a 32 bit relative jump displacement ending at 'at'.
+    void    patch(size_t at, size_t target) throw()
+    {
+        if (!_out) return;
+        const uint32 rel = uint32(int32(target) - int32(at));
+        const byte b[4] = { byte(rel), byte(rel >> 8), byte(rel >> 16), byte(rel >> 24) };
+        memcpy(_out + at - 4, b, sizeof b);
+    }
+
+    template <size_t N>
+    void    operator () (const byte (&code)[N]) throw()  { emit(code, N); }
+};
+
+#define asm_(...)   { const byte code_[] = { __VA_ARGS__ }; a(code_); }
+
+// Every program starts with its way out, stopped programs come in at the
+// top to untag their stack pointer. The entry point follows.
+const size_t    STOP  = 0,
+                EXIT  = 4,
+                ENTRY = 14;
+
+void emit_exit(assembler & a) throw()
+{
+    asm_(0x49, 0x83, 0xE7, 0xFE);           // and r15, -2
+    asm_(0x4C, 0x89, 0x7B, REG_SP);         // mov [rbx+sp], r15
+    asm_(0x41, 0x5F, 0x41, 0x5C, 0x5B);     // pop r15, r12, rbx
+    asm_(0xC3);                             // ret
+}
+
+void emit_entry(assembler & a) throw()
+{
+    asm_(0x53, 0x41, 0x54, 0x41, 0x57);     // push rbx, r12, r15
+    asm_(0x48, 0x89, 0xFB);                 // mov rbx, rdi
+    asm_(0x4C, 0x8B, 0x63, REG_DP);         // mov r12, [rbx+dp]
+    asm_(0x4C, 0x8B, 0x7B, REG_SP);         // mov r15, [rbx+sp]
+}
+
+void emit_push(assembler & a, uint32 v) throw()
+{
+    asm_(0x49, 0x83, 0xC7, 0x04);           // add r15, 4
+    asm_(0x41, 0xC7, 0x07);                 // mov dword [r15], v
+    a.imm32(v);
+}
+
+void emit_pop_eax(assembler & a) throw()
+{
+    asm_(0x41, 0x8B, 0x07);                 // mov eax, [r15]
+    asm_(0x49, 0x83, 0xEF, 0x04);           // sub r15, 4
+}
+
+void emit_jump(assembler & a, byte cc, size_t target) throw()
+{
+    if (cc)     asm_(0x0F, cc)              // jcc rel32
+    else        asm_(0xE9)                  // jmp rel32
+    a.imm32(0);
+    a.patch(a.pos(), target);
+}
+
+// Set the top of stack from a condition code, setcc is 0x0F, cc.
+void emit_set_top(assembler & a, byte cc) throw()
+{
+    asm_(0x0F, cc, 0xC0);                   // setcc al
+    asm_(0x0F, 0xB6, 0xC0);                 // movzx eax, al
+    asm_(0x41, 0x89, 0x07);                 // mov [r15], eax
+}
+
+void emit_compare(assembler & a, byte cc) throw()
+{
+    emit_pop_eax(a);
+    asm_(0x41, 0x39, 0x07);                 // cmp [r15], eax
+    emit_set_top(a, cc);
+}
+
+// Compare the top of stack with a byte sized immediate.
+void emit_compare_byte(assembler & a, byte cc, byte v) throw()
+{
+    asm_(0x41, 0x83, 0x3F, v);              // cmp dword [r15], v
+    emit_set_top(a, cc);
+}
+
+void emit_logical(assembler & a, byte op) throw()
+{
+    emit_pop_eax(a);
+    asm_(0x85, 0xC0);                       // test eax, eax
+    asm_(0x0F, 0x95, 0xC0);                 // setne al
+    asm_(0x41, 0x83, 0x3F, 0x00);           // cmp dword [r15], 0
+    asm_(0x0F, 0x95, 0xC1);                 // setne cl
+    asm_(op, 0xC8);                         // and/or al, cl
+    asm_(0x0F, 0xB6, 0xC0);                 // movzx eax, al
+    asm_(0x41, 0x89, 0x07);                 // mov [r15], eax
+}
+
+void emit_select(assembler & a, byte cc) throw()
+{
+    emit_pop_eax(a);
+    asm_(0x41, 0x8B, 0x0F);                 // mov ecx, [r15]
+    asm_(0x39, 0xC8);                       // cmp eax, ecx
+    asm_(0x0F, cc, 0xC8);                   // cmovcc ecx, eax
+    asm_(0x41, 0x89, 0x0F);                 // mov [r15], ecx
+}
+
+void emit_call(assembler & a, instr fn, size_t data_offset) throw()
+{
+    asm_(0x4C, 0x89, 0xFF);                 // mov rdi, r15
+    asm_(0x49, 0x8D, 0xB4, 0x24);           // lea rsi, [r12+offset]
+    a.imm32(uint32(data_offset));
+    asm_(0x48, 0x89, 0xDA);                 // mov rdx, rbx
+    asm_(0x48, 0xB8);                       // mov rax, fn
+    a.imm64(reinterpret_cast<uintptr>(fn));
+    asm_(0xFF, 0xD0);                       // call rax
+    asm_(0x49, 0x89, 0xC7);                 // mov r15, rax
+    asm_(0xA8, 0x01);                       // test al, 1
+    emit_jump(a, 0x85, STOP);               // jnz stop
+}
+
+// Programs this short cannot move the stack pointer far enough for the
+// interpreter's per instruction range check to stop them, so inline
+// operations can leave it out.
+const size_t MAX_INSTRS = Machine::STACK_MAX/2;
+
+// Returns the size of the code for prog, or 0 if it cannot be compiled.
+size_t translate(const Machine::Code & prog, const opcode_index & index, byte * out) throw()
+{
+    const size_t n = prog.instructionCount();
+    if (!prog || n >= MAX_INSTRS) return 0;
+
+    assembler a(out);
+    emit_exit(a);
+    assert(a.pos() == ENTRY);
+    emit_entry(a);
+
+    const instr * const code = prog.program();
+    const byte  * const data = prog.data();
+    size_t  offset = 0,                 // of the next instruction's parameters
+            ctxt_end = 0,               // instruction after a context item
+            ctxt_offset = 0,
+            ctxt_jump = 0;
+
+    // The last instruction is the RET_ZERO every program is terminated with.
+    for (size_t i = 0; i <= n; ++i)
+    {
+        if (ctxt_end && i == ctxt_end)
+        {
+            if (offset != ctxt_offset)  return 0;
+            a.patch(ctxt_jump, a.pos());
+            ctxt_end = 0;
+        }
+
+        const int opc = i < n ? index.find(code[i]) : RET_ZERO;
+        if (opc < 0)    return 0;
+        const byte * const param = data + offset;
+        size_t param_sz = opcode_table[opc].param_sz;
+        if (param_sz == VARARGS)    param_sz = offset < prog.dataSize() ? param[0] + 1 : 1;
+        if (opc == CNTXT_ITEM)      param_sz = 3;       // plus the data skip
+        if (offset + param_sz > prog.dataSize())    return 0;
+
+        switch (opc)
+        {
+        case NOP :          break;
+        case PUSH_BYTE :    emit_push(a, uint32(int32(int8(param[0]))));   break;
+        case PUSH_BYTEU :   emit_push(a, uint8(param[0]));  break;
+        case PUSH_SHORT :
+        {
+            const int16 r   = int16(param[0]) << 8
+                            | uint8(param[1]);
+            emit_push(a, uint32(int32(r)));
+            break;
+        }
+        case PUSH_SHORTU :
+        {
+            const uint16 r  = uint16(param[0]) << 8
+                            | uint8(param[1]);
+            emit_push(a, r);
+            break;
+        }
+        case PUSH_LONG :
+        {
+            const  int32 r  = int32(param[0]) << 24
+                            | uint32(param[1]) << 16
+                            | uint32(param[2]) << 8
+                            | uint8(param[3]);
+            emit_push(a, uint32(r));
+            break;
+        }
+        case PUSH_PROC_STATE :  emit_push(a, 1);            break;
+        case PUSH_VERSION :     emit_push(a, 0x00030000);   break;
+        case ADD :
+            emit_pop_eax(a);
+            asm_(0x41, 0x01, 0x07);         // add [r15], eax
+            break;
+        case SUB :
+            emit_pop_eax(a);
+            asm_(0x41, 0x29, 0x07);         // sub [r15], eax
+            break;
+        case MUL :
+            emit_pop_eax(a);
+            asm_(0x41, 0x8B, 0x0F);         // mov ecx, [r15]
+            asm_(0x0F, 0xAF, 0xC8);         // imul ecx, eax
+            asm_(0x41, 0x89, 0x0F);         // mov [r15], ecx
+            break;
+        case BITAND :
+            emit_pop_eax(a);
+            asm_(0x41, 0x21, 0x07);         // and [r15], eax
+            break;
+        case BITOR :
+            emit_pop_eax(a);
+            asm_(0x41, 0x09, 0x07);         // or [r15], eax
+            break;
+        case MIN_ :         emit_select(a, 0x4C);   break;      // cmovl
+        case MAX_ :         emit_select(a, 0x4F);   break;      // cmovg
+        case NEG :          asm_(0x41, 0xF7, 0x1F);     break;  // neg dword [r15]
+        case BITNOT :       asm_(0x41, 0xF7, 0x17);     break;  // not dword [r15]
+        case TRUNC8 :
+            asm_(0x41, 0x0F, 0xB6, 0x07);   // movzx eax, byte [r15]
+            asm_(0x41, 0x89, 0x07);         // mov [r15], eax
+            break;
+        case TRUNC16 :
+            asm_(0x41, 0x0F, 0xB7, 0x07);   // movzx eax, word [r15]
+            asm_(0x41, 0x89, 0x07);         // mov [r15], eax
+            break;
+        case BITSET :
+        {
+            const uint16 m  = uint16(param[0]) << 8
+                            | uint8(param[1]);
+            const uint16 v  = uint16(param[2]) << 8
+                            | uint8(param[3]);
+            asm_(0x41, 0x81, 0x27);         // and dword [r15], ~m
+            a.imm32(~uint32(m));
+            asm_(0x41, 0x81, 0x0F);         // or dword [r15], v
+            a.imm32(v);
+            break;
+        }
+        case COND :
+            asm_(0x41, 0x8B, 0x07);         // mov eax, [r15]
+            asm_(0x41, 0x8B, 0x4F, 0xFC);   // mov ecx, [r15-4]
+            asm_(0x49, 0x83, 0xEF, 0x08);   // sub r15, 8
+            asm_(0x41, 0x83, 0x3F, 0x00);   // cmp dword [r15], 0
+            asm_(0x0F, 0x45, 0xC1);         // cmovne eax, ecx
+            asm_(0x41, 0x89, 0x07);         // mov [r15], eax
+            break;
+        case AND :          emit_logical(a, 0x20);  break;      // and al, cl
+        case OR :           emit_logical(a, 0x08);  break;      // or al, cl
+        case NOT :
+            asm_(0x41, 0x83, 0x3F, 0x00);   // cmp dword [r15], 0
+            emit_set_top(a, 0x94);          // sete
+            break;
+        case EQUAL :        emit_compare(a, 0x94);  break;      // sete
+        case NOT_EQ :       emit_compare(a, 0x95);  break;      // setne
+        case LESS :         emit_compare(a, 0x9C);  break;      // setl
+        case GTR :          emit_compare(a, 0x9F);  break;      // setg
+        case LESS_EQ :      emit_compare(a, 0x9E);  break;      // setle
+        case GTR_EQ :       emit_compare(a, 0x9D);  break;      // setge
+        case EQUAL_BYTE :   emit_compare_byte(a, 0x94, param[0]);  break;  // sete
+        case NOT_EQ_BYTE :  emit_compare_byte(a, 0x95, param[0]);  break;  // setne
+        case LESS_EQ_BYTE : emit_compare_byte(a, 0x9E, param[0]);  break;  // setle
+        case POP_RET :      emit_jump(a, 0, EXIT);  break;      // the result is already on top
+        case RET_BYTE :
+            emit_push(a, uint32(int32(int8(param[0]))));
+            emit_jump(a, 0, EXIT);
+            break;
+        case RET_ZERO :     emit_push(a, 0); emit_jump(a, 0, EXIT); break;
+        case RET_TRUE :     emit_push(a, 1); emit_jump(a, 0, EXIT); break;
+        case CNTXT_ITEM :
+        {
+            // Skip to the end of the item, leaving true, unless the current
+            // slot is the one it tests.
+            const int       is_arg = int8(param[0]);
+            const size_t    iskip  = uint8(param[1]),
+                            dskip  = uint8(param[2]);
+            if (ctxt_end || i + 1 + iskip > n)  return 0;
+            asm_(0x48, 0x8B, 0x43, REG_MAPB);   // mov rax, [rbx+map_base]
+            asm_(0x48, 0x05);                   // add rax, is_arg*sizeof(slotref)
+            a.imm32(uint32(is_arg * int(sizeof(slotref))));
+            asm_(0x48, 0x3B, 0x43, REG_MAP);    // cmp rax, [rbx+map]
+            asm_(0x74, 16);                     // je past the skip
+            emit_push(a, 1);
+            emit_jump(a, 0, 0);
+            ctxt_jump   = a.pos();
+            ctxt_end    = i + 1 + iskip;
+            ctxt_offset = offset + param_sz + dskip;
+            break;
+        }
+        default :
+            emit_call(a, opcode_table[opc].impl[prog.constraint()], offset);
+            break;
+        }
+        offset += param_sz;
+    }
+
+    return ctxt_end ? 0 : a.pos();
+}
+
+} // namespace
+
+Jit::~Jit() throw()
+{
+    if (_mem)   munmap(_mem, _size);
+}
+
+bool Jit::compile(Machine::Code * const * progs, size_t n) throw()
+{
+    assert(!_mem);
+    const opcode_index & index = opcode_index::get();
+
+    // Size everything first so it can all go in one mapping, each program
+    // starting on a 16 byte boundary.
+    size_t * const starts = gralloc<size_t>(n);
+    if (!starts)    return false;
+    size_t total = 0;
+    for (size_t i = 0; i != n; ++i)
+    {
+        const size_t sz = translate(*progs[i], index, 0);
+        starts[i] = sz ? total : ~size_t(0);
+        total += (sz + 15) & ~size_t(15);
+    }
+
+    void * const mem = total ? mmap(0, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                             : MAP_FAILED;
+    if (mem == MAP_FAILED)
+    {
+        free(starts);
+        return false;
+    }
+    memset(mem, 0xCC, total);       // int3 between programs
+    for (size_t i = 0; i != n; ++i)
+        if (starts[i] != ~size_t(0))
+            translate(*progs[i], index, static_cast<byte *>(mem) + starts[i]);
+
+    if (mprotect(mem, total, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(mem, total);
+        free(starts);
+        return false;
+    }
+    _mem  = static_cast<byte *>(mem);
+    _size = total;
+
+    for (size_t i = 0; i != n; ++i)
+        if (starts[i] != ~size_t(0))
+            progs[i]->native(reinterpret_cast<native_t>(_mem + starts[i] + ENTRY));
+    free(starts);
+    return true;
+}
+
+
+Machine::stack_t  Machine::run(native_t program, const byte * data, slotref * & map)
+{
+    assert(program != 0);
+
+    stack_t * const sb = _stack + Machine::STACK_GUARD;
+    regbank reg = {data, sb, sb, *map, map, _map.begin()+_map.context(), &_map, &_status, 0, _map.dir(), 0};
+
+    // Run the program
+    program(&reg);
+    const stack_t * sp = reg.sp;
+    const stack_t ret = sp == _stack+STACK_GUARD+1 ? *sp-- : 0;
+
+    check_final_stack(sp);
+    map = reg.map;
+    *map = reg.is;
+    return ret;
+}
+
+#endif // GRAPHITE2_JIT
@@ -0,0 +1,234 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2015, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Checks that every way of bounding this build and CPU have gives the
+// scalar way's floats to the bit, for boxes on the grid fonts use, for any
+// finite floats at all, and for signed zeros and infinities.  Also times
+// each way on typical boxes.  Only a mismatch fails, the timings are just
+// reported.
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+
+#include "inc/AxisBounds.h"
+
+using namespace graphite2;
+
+namespace
+{
+
+typedef std::chrono::steady_clock steady;
+
+const size_t CASES = 200000,
+             TIMED = 2000000;
+
+const char * const names[] = { "scalar", "sse", "avx" };
+
+uint32 rand_state = 1;
+uint32 next_rand() { rand_state = rand_state * 1103515245U + 12345U; return rand_state >> 8; }
+
+enum inputs { GRID, ANY, SPECIAL };
+
+// A float as a font's bounding box or a shift might hold one.
+float grid_value()  { return float(int(next_rand() % 8192) - 4096) / 4; }
+
+// Any finite float at all.
+float any_value()
+{
+    float f;
+    do
+    {
+        const uint32 bits = (next_rand() << 16) ^ next_rand();
+        std::memcpy(&f, &bits, sizeof f);
+    } while (!std::isfinite(f));
+    return f;
+}
+
+float special_value()
+{
+    static const float special[] = { 0.f, -0.f, 1.f, -1.f, 0.5f, -2.f,
+            std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+            std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+            std::numeric_limits<float>::denorm_min(), -std::numeric_limits<float>::min() };
+    return special[next_rand() % (sizeof special / sizeof *special)];
+}
+
+float value(inputs kind)
+{
+    switch (kind)
+    {
+    case GRID:  return grid_value();
+    case ANY:   return any_value();
+    default:    return next_rand() % 2 ? special_value() : grid_value();
+    }
+}
+
+void fill(float * v, size_t n, inputs kind)
+{
+    for (size_t i = 0; i != n; ++i)
+        v[i] = value(kind);
+}
+
+struct bounds_case
+{
+    AxisTarget  t;
+    BBox        bb;
+    SlantBox    sb;
+    float       sx,
+                sy;
+    bool        sub;
+};
+
+bounds_case make_case(inputs kind)
+{
+    bounds_case c;
+    BBox tbb;
+    SlantBox tsb;
+    fill(&tbb.xi, 4, kind);
+    fill(&tsb.si, 4, kind);
+    const float tx = value(kind), ty = value(kind);
+    c.t.set(tbb, tsb, tx, ty);
+    fill(&c.bb.xi, 4, kind);
+    fill(&c.sb.si, 4, kind);
+    c.sx = value(kind);
+    c.sy = value(kind);
+    c.sub = next_rand() % 2;
+    return c;
+}
+
+// Bitwise, except that a NaN need only meet a NaN: which NaN comes out of
+// an operation on two of them is not something any of the ways promise.
+bool same(const AxisBounds & a, const AxisBounds & b)
+{
+    const float * x = a.vmin, * y = b.vmin;
+    for (size_t i = 0; i != sizeof a / sizeof *x; ++i)
+    {
+        if (std::isnan(x[i]) && std::isnan(y[i]))
+            continue;
+        if (std::memcmp(x + i, y + i, sizeof *x))
+            return false;
+    }
+    return true;
+}
+
+void show(const char * name, const AxisBounds & r)
+{
+    const float * x = r.vmin;
+    std::cerr << "  " << std::setw(6) << name << ":" << std::hexfloat;
+    for (size_t i = 0; i != sizeof r / sizeof *x; ++i)
+        std::cerr << ' ' << x[i];
+    std::cerr << std::defaultfloat << '\n';
+}
+
+int check(axis_bounds_kind kind, axis_bounds_fn f)
+{
+    const axis_bounds_fn ref = axis_bounds(AXIS_BOUNDS_SCALAR);
+    const char * const input_names[] = { "grid", "any", "special" };
+    int failures = 0;
+
+    rand_state = 1;
+    for (int in = GRID; in <= SPECIAL; ++in)
+    {
+        for (size_t n = 0; n != CASES; ++n)
+        {
+            const bounds_case c = make_case(inputs(in));
+            AxisBounds expected, got;
+            ref(c.t, c.bb, c.sb, c.sx, c.sy, c.sub, expected);
+            f(c.t, c.bb, c.sb, c.sx, c.sy, c.sub, got);
+            if (!same(expected, got) && ++failures <= 5)
+            {
+                std::cerr << names[kind] << " differs on " << input_names[in] << " case " << n
+                          << (c.sub ? " (sub-box)" : " (main box)") << '\n';
+                show("scalar", expected);
+                show(names[kind], got);
+            }
+        }
+    }
+    return failures;
+}
+
+double time_bounds(axis_bounds_fn f, const bounds_case * cases, size_t n, float & sink)
+{
+    AxisBounds r;
+    float sum = 0;
+    const steady::time_point start = steady::now();
+    for (size_t i = 0; i != TIMED; ++i)
+    {
+        const bounds_case & c = cases[i % n];
+        f(c.t, c.bb, c.sb, c.sx, c.sy, c.sub, r);
+        sum += r.vmin[i & 3] + r.omax[i & 3];
+    }
+    sink += sum;
+    return std::chrono::duration<double, std::milli>(steady::now() - start).count();
+}
+
+} // namespace
+
+
+int main()
+{
+    int failures = 0;
+    size_t checked = 0;
+    for (int k = AXIS_BOUNDS_SCALAR; k != AXIS_BOUNDS_BEST; ++k)
+    {
+        const axis_bounds_fn f = axis_bounds(axis_bounds_kind(k));
+        if (!f)
+        {
+            std::cout << names[k] << ": not available\n";
+            continue;
+        }
+        failures += check(axis_bounds_kind(k), f);
+        ++checked;
+    }
+    if (!axis_bounds())
+    {
+        std::cerr << "no way of bounding chosen\n";
+        ++failures;
+    }
+
+    enum { NUM_TIMED = 1024 };
+    static bounds_case cases[NUM_TIMED];
+    rand_state = 7;
+    for (size_t i = 0; i != NUM_TIMED; ++i)
+        cases[i] = make_case(GRID);
+
+    float sink = 0;
+    for (int k = AXIS_BOUNDS_SCALAR; k != AXIS_BOUNDS_BEST; ++k)
+    {
+        const axis_bounds_fn f = axis_bounds(axis_bounds_kind(k));
+        if (!f) continue;
+        double best = time_bounds(f, cases, NUM_TIMED, sink);
+        for (int round = 0; round != 4; ++round)
+            best = std::min(best, time_bounds(f, cases, NUM_TIMED, sink));
+        std::cout << std::setw(6) << names[k] << ": " << std::fixed << std::setprecision(2)
+                  << best << " ms for " << TIMED << " boxes"
+                  << (f == axis_bounds() ? " (chosen)" : "") << '\n';
+    }
+
+    volatile float keep = sink;   // so the timed calls aren't optimised away
+    (void)keep;
+
+    std::cout << checked << " ways checked, " << failures << " mismatches\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Check the bulk glyph and cluster export gives what walking the slots with
+// the per slot API gives.
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+namespace
+{
+
+int check(gr_font * font, gr_face * face, const std::string & line, int rtl)
+{
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, line.data(), line.data() + line.size(), 0);
+    gr_segment * seg = gr_make_seg(font, face, 0, 0, gr_utf8, line.data(), nchars, rtl);
+    if (!seg) return 1;
+
+    const size_t n = gr_seg_export_glyphs(seg, font, 0, 0, 0, 0, 0, 0, 0);
+    std::vector<gr_uint16> gids(n);
+    std::vector<float> xs(n), ys(n), advs(n);
+    std::vector<int> chars(n), parents(n);
+    int errors = gr_seg_export_glyphs(seg, font, n, gids.data(), xs.data(), ys.data(), advs.data(),
+                                      chars.data(), parents.data()) != n;
+
+    std::map<const gr_slot *, int> position;
+    std::map<unsigned int, int> index_position;
+    size_t i = 0;
+    for (const gr_slot * s = gr_seg_first_slot(seg); s; s = gr_slot_next_in_segment(s), ++i)
+    {
+        position[s] = int(i);
+        index_position[gr_slot_index(s)] = int(i);
+    }
+    errors += i != n;
+
+    i = 0;
+    for (const gr_slot * s = gr_seg_first_slot(seg); s && i < n; s = gr_slot_next_in_segment(s), ++i)
+    {
+        const gr_slot * p = gr_slot_attached_to(s);
+        errors += gids[i] != gr_slot_gid(s)
+                || xs[i] != gr_slot_origin_X(s)
+                || ys[i] != gr_slot_origin_Y(s)
+                || advs[i] != gr_slot_advance_X(s, face, font)
+                || chars[i] != gr_slot_before(s)
+                || parents[i] != (p ? position[p] : -1);
+    }
+
+    const size_t nc = gr_seg_n_cinfo(seg);
+    std::vector<int> first(nc), last(nc);
+    errors += gr_seg_export_clusters(seg, nc, first.data(), last.data()) != nc;
+    for (size_t c = 0; c != nc; ++c)
+    {
+        const gr_char_info * ci = gr_seg_cinfo(seg, unsigned(c));
+        int b = gr_cinfo_before(ci) < 0 ? -1 : index_position[gr_cinfo_before(ci)],
+            a = gr_cinfo_after(ci) < 0 ? -1 : index_position[gr_cinfo_after(ci)];
+        if (b > a && a >= 0) std::swap(a, b);
+        errors += first[c] != b || last[c] != a;
+    }
+
+    gr_seg_destroy(seg);
+    return errors;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r]\n";
+        return 1;
+    }
+    const int rtl = argc > 3 && !strcmp(argv[3], "-r");
+
+    gr_face * face = gr_make_file_face(argv[1], 0);
+    gr_font * font = face ? gr_make_font(12, face) : 0;
+    if (!font)
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    int failures = 0, l = 0;
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+    {
+        ++l;
+        if (line.empty()) continue;
+        if (check(font, face, line, rtl) || check(0, face, line, rtl))
+        {
+            std::cerr << "export differs on line " << l << std::endl;
+            ++failures;
+        }
+    }
+
+    gr_font_destroy(font);
+    gr_face_destroy(face);
+    return failures ? 3 : 0;
+}
@@ -0,0 +1,193 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Checks that the column maps and transition tables each pass keeps answer
+// exactly as the dense tables read from the font would, and times stepping
+// through them against the dense form.  Only a mismatch fails, the timings
+// are just reported.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+#include "inc/Face.h"
+#include "inc/FileFace.h"
+#include "inc/Pass.h"
+#include "inc/Silf.h"
+#include "inc/StateTable.h"
+
+using namespace graphite2;
+
+namespace
+{
+
+typedef std::chrono::steady_clock steady;
+
+const size_t STEPS = 1000000;
+
+struct table_totals
+{
+    size_t  dense_bytes,
+            kept_bytes;
+    double  dense_ms,
+            kept_ms;
+};
+
+uint32 rand_state = 1;
+uint16 next_rand() { rand_state = rand_state * 1103515245U + 12345U; return uint16(rand_state >> 16); }
+
+// Steps the FSM on pseudo random columns, back to a random row whenever it
+// stops, as a pass does at each slot.
+template <typename T>
+double time_steps(const T & table, uint16 rows, uint16 cols, unsigned long & sink)
+{
+    rand_state = 1;
+    uint16 state = 0;
+    unsigned long sum = 0;
+    const steady::time_point start = steady::now();
+    for (size_t i = 0; i != STEPS; ++i)
+    {
+        state = table(state, next_rand() % cols);
+        if (state == 0 || state >= rows)
+            state = next_rand() % rows;
+        sum += state;
+    }
+    sink += sum;
+    return std::chrono::duration<double, std::milli>(steady::now() - start).count();
+}
+
+template <typename T>
+double time_columns(const T & map, uint16 num_glyphs, unsigned long & sink)
+{
+    rand_state = 1;
+    unsigned long sum = 0;
+    const steady::time_point start = steady::now();
+    for (size_t i = 0; i != STEPS; ++i)
+        sum += map[next_rand() % num_glyphs];
+    sink += sum;
+    return std::chrono::duration<double, std::milli>(steady::now() - start).count();
+}
+
+struct dense_columns
+{
+    const uint16 * cols;
+    uint16 operator [] (uint16 gid) const { return cols[gid]; }
+};
+
+bool check_pass(const Pass & pass, table_totals & trans, table_totals & cols, unsigned long & sink)
+{
+    const StateTable & kept = pass.transitions();
+    const uint16 rows = kept.numRows(), ncols = kept.numColumns();
+    uint16 * const dense = gralloc<uint16>(size_t(rows) * ncols + 1);
+    for (uint16 s = 0; s != rows; ++s)
+        for (uint16 c = 0; c != ncols; ++c)
+            dense[s*ncols + c] = kept(s, c);
+
+    // Rebuild both forms from the same dense table, the compact one only as
+    // the pass would have chosen it.
+    uint16 * const copy = gralloc<uint16>(size_t(rows) * ncols + 1);
+    std::copy(dense, dense + size_t(rows) * ncols, copy);
+    StateTable plain, overlaid;
+    plain.build(dense, rows, ncols, false);
+    overlaid.build(copy, rows, ncols);
+    if (overlaid.compact() != kept.compact())   return false;
+    for (uint16 s = 0; s != rows; ++s)
+        for (uint16 c = 0; c != ncols; ++c)
+            if (overlaid(s, c) != plain(s, c))  return false;
+
+    if (kept.compact() && rows && ncols)
+    {
+        trans.dense_bytes += plain.size();
+        trans.kept_bytes  += overlaid.size();
+        trans.dense_ms    += time_steps(plain, rows, ncols, sink);
+        trans.kept_ms     += time_steps(overlaid, rows, ncols, sink);
+    }
+
+    const ColumnMap & map = pass.columns();
+    const uint16 num_glyphs = map.numGlyphs();
+    if (!num_glyphs)    return true;
+    uint16 * const gcols = gralloc<uint16>(num_glyphs);
+    for (uint16 g = 0; g != num_glyphs; ++g)
+        gcols[g] = map[g];
+    ColumnMap rebuilt;
+    uint16 * const gcopy = gralloc<uint16>(num_glyphs);
+    std::copy(gcols, gcols + num_glyphs, gcopy);
+    rebuilt.build(gcopy, num_glyphs);
+    bool ok = rebuilt.compact() == map.compact() && rebuilt[num_glyphs] == 0xFFFF;
+    for (uint16 g = 0; ok && g != num_glyphs; ++g)
+        ok = rebuilt[g] == gcols[g];
+
+    if (map.compact())
+    {
+        const dense_columns plain_cols = { gcols };
+        cols.dense_bytes += num_glyphs * sizeof(uint16);
+        cols.kept_bytes  += map.size();
+        cols.dense_ms    += time_columns(plain_cols, num_glyphs, sink);
+        cols.kept_ms     += time_columns(map, num_glyphs, sink);
+    }
+    free(gcols);
+    return ok;
+}
+
+void report(const char * what, const table_totals & t)
+{
+    std::cout << std::setw(14) << what << ": " << t.dense_bytes << " -> " << t.kept_bytes << " bytes, "
+              << std::fixed << std::setprecision(1) << t.dense_ms << " -> " << t.kept_ms << " ms" << std::endl;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << argv[0] << ": FONT..." << std::endl;
+        return 1;
+    }
+
+    unsigned long sink = 0;
+    for (int i = 1; i != argc; ++i)
+    {
+        FileFace file(argv[i]);
+        Face face(&file, FileFace::ops);
+        const Face::Table silf(face, TtfUtil::Tag::Silf, 0x00050000);
+        if (!file || !silf || !face.readGlyphs(0) || !face.readFeatures() || !face.readGraphite(silf))
+        {
+            std::cerr << argv[0] << ": failed to load " << argv[i] << std::endl;
+            return 2;
+        }
+
+        table_totals trans = {0, 0, 0, 0},
+                     cols  = {0, 0, 0, 0};
+        const Silf * const s = face.chooseSilf(0);
+        for (size_t p = 0; p != s->numPasses(); ++p)
+            if (!check_pass(*s->pass(p), trans, cols, sink))
+            {
+                std::cerr << argv[0] << ": " << argv[i] << " pass " << p << " tables differ" << std::endl;
+                return 3;
+            }
+        std::cout << argv[i] << std::endl;
+        report("transitions", trans);
+        report("columns", cols);
+    }
+    return sink == 0;
+}
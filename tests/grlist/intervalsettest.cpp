@@ -24,54 +24,43 @@ Mozilla Public License (http://mozilla.org/MPL) or the GNU General Public
 License, as published by the Free Software Foundation, either version 2
 of the License or (at your option) any later version.
 */
-#include "inc/Intervals.h"
+// Checks Zones on a few worked cases, then that it splits, trims and costs
+// its exclusions exactly as the Vector of whole exclusions it replaced did
+// over a long run of pseudo random calls.
 #include <utility>
 #include <vector>
 #include <cstdio>
-#include <cstddef>
-#include <cassert>
+#include <cstring>
+
+#include "inc/Intervals.h"
+#include "oldzones.h"
+#include "zonesruns.h"
 
 namespace gr2 = graphite2;
 
 typedef std::pair<float, float> fpair;
 typedef std::vector<fpair> fvector;
-typedef fvector::iterator ifvector;
 
 static int testCount = 0;
 
-void printRanges(const char *pref, gr2::IntervalSet &is)
+void printRanges(const char *pref, const gr2::Zones &z)
 {
     printf ("%s: [ ", pref);
-    for (gr2::IntervalSet::ivtpair s = is.begin(), end = is.end(); s != end; ++s)
-        printf("(%.1f, %.1f) ", s->first, s->second);
+    for (size_t i = 0; i != z.size(); ++i)
+        printf("(%.1f, %.1f) ", z[i].x, z[i].xm);
     printf ("]\n");
 }
 
-int doTest(const char *pref, gr2::IntervalSet &is, fvector &fv)
+int doTest(const char *pref, const gr2::Zones &z, const fvector &fv)
 {
-    bool pass = true;
-    gr2::IntervalSet::ivtpair s = is.begin(), e = is.end();
-    ifvector bs = fv.begin(), be = fv.end();
-    for ( ; s != e && bs != be; ++s, ++bs)
-    {
-        if (*s != *bs)
-        {
-            pass = false;
-            break;
-        }
-    }
-    if (bs != be || s != e)
-        pass = false;
+    bool pass = z.size() == fv.size();
+    for (size_t i = 0; pass && i != z.size(); ++i)
+        pass = z[i].x == fv[i].first && z[i].xm == fv[i].second;
     printf("%d %s) ", ++testCount, pass ? "pass" : "FAIL");
-    printRanges(pref, is);
+    printRanges(pref, z);
     return pass ? 0 : 1;
 }
 
-void printFloat(const char *pref, float val)
-{
-    printf ("%s: [ %.1f ]\n", pref, val);
-}
-
 int doFloatTest(const char *pref, float test, float base)
 {
     bool pass = (test == base);
@@ -79,174 +68,105 @@ int doFloatTest(const char *pref, float test, float base)
     return (pass ? 0 : 1);
 }
 
+static bool same(float a, float b) { return memcmp(&a, &b, sizeof(float)) == 0; }
+
+// Every field of every exclusion, to the bit.
+bool sameZones(const gr2::Zones &z, const gr2::OldZones &oz)
+{
+    if (z.size() != oz.size())  return false;
+    size_t n = 0;
+    for (gr2::OldZones::const_iterator e = oz.begin(); e != oz.end(); ++e, ++n)
+    {
+        const gr2::Zones::value_type s = z[n];
+        if (!same(s.x, e->x) || !same(s.xm, e->xm) || !same(s.c, e->c)
+            || !same(s.sm, e->sm) || !same(s.smx, e->smx) || s.open != e->open)
+            return false;
+    }
+    return true;
+}
+
+int doRandomTest(int runs, int ops_per_run)
+{
+    const gr2::zones_runs ops(runs, ops_per_run);
+    gr2::Zones z;
+    gr2::OldZones oz;
+    size_t n = 0;
+    for (const gr2::zones_op *o = ops.begin(); o != ops.end(); ++o, ++n)
+    {
+        const float r = gr2::apply(z, *o),
+                    old_r = gr2::apply(oz, *o);
+        if (!same(r, old_r) || !sameZones(z, oz))
+        {
+            printf("%d FAIL) random call %zu, kind %d on axis %d, differs\n", ++testCount, n, o->kind, o->axis);
+            printRanges("  now", z);
+            return 1;
+        }
+    }
+    printf("%d pass) %d random runs of %d calls\n", ++testCount, runs, ops_per_run);
+    return 0;
+}
+
 int main(int /*argc*/, char ** /*argv*/)
 {
     int res = 0;
     fvector base;
-    float fres;
-    gr2::IntervalSet test, test2, testl;
+    float cost;
+    gr2::Zones test;
 
-    test.clear();
-    base.clear();
-    test.add(fpair(10., 100.));
+    test.initialise<gr2::XY>(10., 100., 0., 0., 0.);
     base.push_back(fpair(10., 100.));
     res += doTest("Init test", test, base);
 
-    test.remove(fpair(30., 50.));
+    test.exclude(30., 50.);
     base.clear();
     base.push_back(fpair(10., 30.));
     base.push_back(fpair(50., 100.));
-    res += doTest("remove(30,50)", test, base);
+    res += doTest("exclude(30,50)", test, base);
 
-    test.remove(fpair(45., 60.));
+    test.exclude(45., 60.);
     base.back() = fpair(60., 100.);
-    res += doTest("remove(45,60)", test, base);
+    res += doTest("exclude(45,60)", test, base);
 
-    test.remove(fpair(80., 90.));
+    test.exclude(80., 90.);
     base.clear();
     base.push_back(fpair(10., 30.));
     base.push_back(fpair(60., 80.));
     base.push_back(fpair(90., 100.));
-    res += doTest("remove(80,90)", test, base);
+    res += doTest("exclude(80,90)", test, base);
 
-    test2.clear();
-    test2.add(fpair(10., 100.));
-    test2.remove(fpair(20., 40.));
-    test2.remove(fpair(45., 50.));
-    test2.remove(fpair(55., 85.));
+    test.exclude(20., 85.);
     base.clear();
     base.push_back(fpair(10., 20.));
-    base.push_back(fpair(40., 45.));
-    base.push_back(fpair(50., 55.));
-    base.push_back(fpair(85., 100.));
-    res += doTest("Init test2", test2, base);
-    base.clear();
-    base.push_back(fpair(20., 30.));
-    base.push_back(fpair(60., 80));
-    test.remove(test2);
-    res += doTest("test - test2", test, base);
-
-    test.clear();
-    test.add(fpair(10., 85.));
-    test.remove(fpair(30., 40.));
-    base.clear();
-    base.push_back(fpair(10., 30.));
-    base.push_back(fpair(40., 85.));
-    res += doTest("Init test3", test, base);
-    test2.clear();
-    test2.add(fpair(20., 90.));
-    test2.remove(fpair(50., 60.));
-    test2.remove(fpair(70., 80.));
+    base.push_back(fpair(90., 100.));
+    res += doTest("exclude spans", test, base);
+
+    test.initialise<gr2::XY>(1332., 1433., 0., 0., 0.);
+    test.exclude(1356., 1627.);
     base.clear();
-    base.push_back(fpair(20., 50.));
-    base.push_back(fpair(60., 70.));
-    base.push_back(fpair(80., 90.));
-    res += doTest("Init test4", test2, base);
-    test.remove(test2);
+    base.push_back(fpair(1332., 1356.));
+    res += doTest("right overlap exclusion", test, base);
+
+    test.initialise<gr2::XY>(10., 100., 0., 0., 0.);
+    test.exclude(0., 50.);
+    res += doFloatTest("closest(0) past an exclusion", test.closest(0., cost), 50.);
+    res += doFloatTest("  costs", cost, 2500.);
+
+    test.weighted<gr2::XY>(60., 70., 0., 0., 1., 65., 0., 0., false);
     base.clear();
-    base.push_back(fpair(10., 20.));
     base.push_back(fpair(50., 60.));
-    base.push_back(fpair(70., 80.));
-    res += doTest("test3 - test4", test, base);
-    testl = test.locate(fpair(30., 35.));
-    base.clear();
-    base.push_back(fpair(-20., -15.));
-    base.push_back(fpair(20., 25.));
-    base.push_back(fpair(40., 45.));
-    res += doTest("locate(30,35)", testl, base);
-    fres = testl.findClosestCoverage(0.);
-    res += doFloatTest("Cover(0)", fres, -15.);
-    fres = testl.findClosestCoverage(23.);
-    res += doFloatTest("Cover(23)", fres, 23.);
-
-    test.clear();
-    test.remove(fpair(10., 20.));
-    base.clear();
-    res += doTest("Removing from empty", test, base);
-
-    test.clear();
-    test.add(fpair(10., 50.));
-    test.add(fpair(20., 30.));
-    test.add(fpair(40., 60.));
-    test.add(fpair(60., 80.));
-    test.add(fpair(90., 90.));
-    test.add(fpair(80., 100.));
-    base.clear();
-    base.push_back(fpair(10., 100.));
-    res += doTest("Slow add 10-100", test, base);
-
-    test.clear();
-    test.add(fpair(-447.149, 121.39));
-    testl = test.locate(fpair(-487.753, -106.255));
-    printRanges("          locate(-487,-186) in (-447,121)", testl);
-    fres = testl.findClosestCoverage(0.);
-    printFloat("          bestfit(0)", fres);
-
-    test.clear();
-    test.add(fpair(10., 90.));
-    test2.clear();
-    test2.add(fpair(50., 60.));
-    test.remove(test2);
-    test2.clear();
-    test2.add(fpair(30., 40.));
-    test.remove(test2);
-    base.clear();
-    base.push_back(fpair(10., 30.));
-    base.push_back(fpair(40., 50.));
-    base.push_back(fpair(60., 90.));
-    res += doTest("(10,90)-[(50,60)]-[(30,40)]", test, base);
-
-    test.clear();
-    test.add(fpair(10., 90.));
-    test2.clear();
-    test2.add(fpair(20., 30.));
-    test2.add(fpair(25., 40.));
-    test.remove(test2);
-    base.clear();
-    base.push_back(fpair(10., 20.));
-    base.push_back(fpair(40., 90.));
-    res += doTest("(10,90)-[(20,30),(25,40)]", test, base);
-
-    test.clear();
-    test.add(fpair(10., 30.));
-    test.add(fpair(40., 50.));
-    test.add(fpair(60., 90.));
-    test2.clear();
-    test2.add(fpair(20., 80.));
-    test.remove(test2);
-    base.clear();
-    base.push_back(fpair(10., 20.));
-    base.push_back(fpair(80., 90.));
-    res += doTest("Test 4 remove spans", test, base);
-    test.clear();
-    test.add(fpair(10., 30.));
-    test.add(fpair(40., 50.));
-    test.add(fpair(60., 90.));
-    test.remove(fpair(20., 80.));
-    res += doTest("Test 5 remove pair", test, base);
-
-    test.clear();
-    test.add(fpair(10., 30.));
-    test.add(fpair(40., 50.));
-    test.add(fpair(60., 90.));
-    test2.clear();
-    test2.add(15., 45.);
-    test2.add(65., 70.);
-    test2.add(75., 80.);
-    test.intersect(test2);
-    base.clear();
-    base.push_back(fpair(15., 30.));
-    base.push_back(fpair(40., 45.));
-    base.push_back(fpair(65., 70.));
-    base.push_back(fpair(75., 80.));
-    res += doTest("Test 6 intersection", test, base);
-
-    test.clear();
-    test.add(1332, 1433);
-    test.remove(1356, 1627);
+    base.push_back(fpair(60., 70.));
+    base.push_back(fpair(70., 100.));
+    res += doTest("weighted(60,70)", test, base);
+    res += doFloatTest("closest(65) beside the weight", test.closest(65., cost), 70.);
+    res += doFloatTest("  costs", cost, 25.);
+
+    test.exclude(0., 200.);
     base.clear();
-    base.push_back(fpair(1332, 1356));
-    res += doTest("Test 7 right overlap removal", test, base);
+    res += doTest("exclude everything", test, base);
+    test.closest(0., cost);
+    res += doFloatTest("  closest costs", cost, -1.);
+
+    res += doRandomTest(20000, 24);
 
     return res;
 }
@@ -0,0 +1,137 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Zones as it was kept before its exclusions went into columns: a Vector of
+// whole exclusions, split and costed one at a time.  The tests hold the
+// library's Zones to giving exactly the same answers as this, and its work is
+// split between here and oldzones.cpp as it was between Intervals.h and
+// Intervals.cpp, so that timing the two is fair.
+#pragma once
+
+#include "inc/Main.h"
+#include "inc/List.h"
+#include "inc/Intervals.h"
+
+namespace graphite2 {
+
+class OldZones
+{
+public:
+    struct Exclusion
+    {
+        template<zones_t O>
+        static Exclusion weighted(float xmin, float xmax, float f, float a0,
+                float m, float xi, float ai, float c, bool nega);
+
+        float   x, xm, c, sm, smx;
+        bool    open;
+
+        Exclusion(float x_, float xm_, float smi, float smxi, float c_)
+        : x(x_), xm(xm_), c(c_), sm(smi), smx(smxi), open(false) {}
+
+        Exclusion & operator += (Exclusion const & rhs)
+        {
+            c += rhs.c; sm += rhs.sm; smx += rhs.smx; open = false;
+            return *this;
+        }
+
+        uint8 outcode(float p) const    { return ((p - xm >= 0.f) << 1) | (x - p > 0.f); }
+
+        Exclusion split_at(float p)     { Exclusion r(*this); r.xm = x = p; return r; }
+        void left_trim(float p)         { x = p; }
+
+        bool track_cost(float & best_cost, float & best_pos, float origin) const;
+        float test_position(float origin) const;
+        float cost(float p) const       { return (sm * p - 2 * smx) * p + c; }
+    };
+
+    typedef Vector<Exclusion>::iterator         iterator;
+    typedef Vector<Exclusion>::const_iterator   const_iterator;
+
+    OldZones() : _margin_len(0), _margin_weight(0), _pos(0), _posm(0) { _exclusions.reserve(8); }
+
+    template<zones_t O>
+    void initialise(float xmin, float xmax, float margin_len, float margin_weight, float a0)
+    {
+        _margin_len = margin_len;
+        _margin_weight = margin_weight;
+        _pos = xmin;
+        _posm = xmax;
+        _exclusions.clear();
+        _exclusions.push_back(Exclusion::weighted<O>(xmin, xmax, 1, a0, 0, 0, 0, 0, false));
+        _exclusions.front().open = true;
+    }
+
+    void exclude(float xmin, float xmax)    { remove(xmin, xmax); }
+
+    void exclude_with_margins(float xmin, float xmax, int axis);
+
+    template<zones_t O>
+    void weighted(float xmin, float xmax, float f, float a0, float m, float xi, float ai, float c, bool nega)
+    {
+        insert(Exclusion::weighted<O>(xmin, xmax, f, a0, m, xi, ai, c, nega));
+    }
+
+    void weightedAxis(int axis, float xmin, float xmax, float f, float a0, float m, float xi, float ai, float c, bool nega)
+    {
+        if (axis < 2)
+            weighted<XY>(xmin, xmax, f, a0, m, xi, ai, c, nega);
+        else
+            weighted<SD>(xmin, xmax, f, a0, m, xi, ai, c, nega);
+    }
+
+    float closest(float origin, float & cost) const;
+
+    const_iterator begin() const    { return _exclusions.begin(); }
+    const_iterator end() const      { return _exclusions.end(); }
+    size_t size() const             { return _exclusions.size(); }
+
+private:
+    Vector<Exclusion>   _exclusions;
+    float   _margin_len,
+            _margin_weight,
+            _pos,
+            _posm;
+
+    void insert(Exclusion e);
+    void remove(float x, float xm);
+    const_iterator find_exclusion_under(float x) const;
+};
+
+template<>
+inline
+OldZones::Exclusion OldZones::Exclusion::weighted<XY>(float xmin, float xmax, float f, float a0,
+        float m, float xi, float, float c, bool) {
+    return Exclusion(xmin, xmax, m + f, m * xi, m * xi * xi + f * a0 * a0 + c);
+}
+
+template<>
+inline
+OldZones::Exclusion OldZones::Exclusion::weighted<SD>(float xmin, float xmax, float f, float a0,
+        float m, float xi, float ai, float c, bool nega) {
+    float xia = nega ? xi - ai : xi + ai;
+    return Exclusion(xmin, xmax,
+            0.25f * (m + 2.f * f),
+            0.25f * m * xia,
+            0.25f * (m * xia * xia + 2.f * f * a0 * a0) + c);
+}
+
+} // namespace graphite2
@@ -0,0 +1,79 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Times the calls ShiftCollider makes on a Zones against the same calls on
+// the Vector of whole exclusions it replaced, taking the best of several
+// rounds of each in turn.  Only answers that differ fail, the timings are just
+// reported.
+#include <chrono>
+#include <cstdio>
+
+#include "inc/Intervals.h"
+#include "oldzones.h"
+#include "zonesruns.h"
+
+using namespace graphite2;
+
+namespace
+{
+
+typedef std::chrono::steady_clock steady;
+
+// Few enough runs to stay in cache, replayed so there is something to time.
+const int RUNS = 500,
+          OPS_PER_RUN = 8,
+          REPLAYS = 200,
+          ROUNDS = 9;
+
+template <typename Z>
+double time_runs(const zones_runs & ops, double & sink)
+{
+    Z z;
+    double sum = 0;
+    const steady::time_point start = steady::now();
+    for (int r = 0; r != REPLAYS; ++r)
+        for (const zones_op * o = ops.begin(); o != ops.end(); ++o)
+            sum += apply(z, *o);
+    const double ms = std::chrono::duration<double, std::milli>(steady::now() - start).count();
+    sink = sum;
+    return ms;
+}
+
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    const zones_runs ops(RUNS, OPS_PER_RUN);
+    double best = 1e30, old_best = 1e30,
+           sink = 0, old_sink = 0;
+    for (int r = 0; r != ROUNDS; ++r)
+    {
+        best = min(best, time_runs<Zones>(ops, sink));
+        old_best = min(old_best, time_runs<OldZones>(ops, old_sink));
+        if (sink != old_sink)
+        {
+            printf("zonesbench: round %d answers differ, %g not %g\n", r, sink, old_sink);
+            return 1;
+        }
+    }
+    printf("%d runs of %d calls %d times: %.2f ms, was %.2f ms\n", RUNS, OPS_PER_RUN, REPLAYS, best, old_best);
+    return 0;
+}
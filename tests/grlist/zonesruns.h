@@ -0,0 +1,114 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Pseudo random runs of the calls ShiftCollider makes on a Zones, shared by
+// the check against OldZones and the timing of the two.
+#pragma once
+
+#include "inc/Intervals.h"
+#include "oldzones.h"
+
+namespace graphite2 {
+
+struct zones_op
+{
+    int     kind;   // 0 exclude, 1 exclude with margins, 2 weight, 3 find the closest
+    int     axis;
+    float   a[9];
+};
+
+// Each run initialises on a random axis and then makes ops_per_run calls, in
+// about the mix shaping Awami gives: mostly weighting and excluding with
+// margins, and one in six or so finding the closest.
+// Coordinates are on a coarse grid so that edges often meet exactly, which is
+// where the split and trim cases differ.
+class zones_runs
+{
+public:
+    zones_runs(int runs, int ops_per_run);
+    ~zones_runs() { free(_ops); }
+
+    const zones_op * begin() const  { return _ops; }
+    const zones_op * end() const    { return _ops + _num; }
+
+    CLASS_NEW_DELETE;
+private:
+    zones_op  * _ops;
+    size_t      _num;
+    int         _per_run;
+    uint32      _rand;
+
+    uint16 next_rand() { _rand = _rand * 1103515245U + 12345U; return uint16(_rand >> 16); }
+    float coord()   { return float(int(next_rand() % 64) - 16) * 8.f; }
+    float weight()  { return float(next_rand() % 9) * 0.5f - 1.f; }
+
+    zones_runs(const zones_runs &);
+    zones_runs & operator = (const zones_runs &);
+};
+
+inline
+zones_runs::zones_runs(int runs, int ops_per_run)
+: _ops(gralloc<zones_op>(size_t(runs) * (ops_per_run + 1))), _num(0), _per_run(ops_per_run), _rand(1)
+{
+    if (!_ops)  std::abort();
+    for (int r = 0; r != runs; ++r)
+    {
+        zones_op & s = _ops[_num++];
+        s.kind = -1;
+        s.axis = next_rand() % 4;
+        s.a[0] = coord(); s.a[1] = s.a[0] + 8.f * (next_rand() % 40);
+        s.a[2] = float(next_rand() % 4) * 8.f; s.a[3] = weight(); s.a[4] = coord();
+        for (int i = 0; i != ops_per_run; ++i)
+        {
+            zones_op & o = _ops[_num++];
+            const int k = next_rand() % 25;
+            o.kind = k < 11 ? 2 : k < 21 ? 1 : k < 22 ? 0 : 3;
+            o.axis = s.axis;
+            o.a[0] = coord(); o.a[1] = o.a[0] + 8.f * (next_rand() % 12);
+            for (int k = 2; k != 8; ++k)
+                o.a[k] = k & 1 ? coord() : weight();
+            o.a[8] = float(next_rand() % 2);
+        }
+    }
+}
+
+// Applies o to either kind of Zones, giving back the closest position and its
+// cost summed for a find and 0 for anything else.
+template <typename Z>
+inline
+float apply(Z & z, const zones_op & o)
+{
+    float cost = 0;
+    switch (o.kind)
+    {
+    case -1:
+        if (o.axis < 2) z.template initialise<XY>(o.a[0], o.a[1], o.a[2], o.a[3], o.a[4]);
+        else            z.template initialise<SD>(o.a[0], o.a[1], o.a[2], o.a[3], o.a[4]);
+        break;
+    case 0: z.exclude(o.a[0], o.a[1]); break;
+    case 1: z.exclude_with_margins(o.a[0], o.a[1], o.axis); break;
+    case 2: z.weightedAxis(o.axis, o.a[0], o.a[1], o.a[2], o.a[3], o.a[4], o.a[5], o.a[6], o.a[7], o.a[8] > 0); break;
+    default: return z.closest(o.a[0], cost) + cost;
+    }
+    return 0;
+}
+
+} // namespace graphite2
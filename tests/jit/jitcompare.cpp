@@ -0,0 +1,164 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Differential test of the rule compiler: shape a corpus, whole lines and
+// word by word, on a face made with gr_face_jit and on one left on the
+// interpreter, then again with every value of every feature set in turn so
+// rules gated on features run too. The slot state after shaping must match.
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+namespace
+{
+
+typedef std::vector<float> shaping;
+
+struct engine
+{
+    gr_face * face;
+    gr_font * font;
+};
+
+shaping shape(const engine & e, const gr_feature_val * feats, const std::string & text, int rtl)
+{
+    shaping res;
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, text.data(), text.data() + text.size(), 0);
+    gr_segment * seg = gr_make_seg(e.font, e.face, 0, feats, gr_utf8, text.data(), nchars, rtl);
+    if (!seg) return res;
+
+    res.push_back(gr_seg_advance_X(seg));
+    res.push_back(gr_seg_advance_Y(seg));
+    for (const gr_slot * s = gr_seg_first_slot(seg); s; s = gr_slot_next_in_segment(s))
+    {
+        res.push_back(gr_slot_gid(s));
+        res.push_back(gr_slot_origin_X(s));
+        res.push_back(gr_slot_origin_Y(s));
+        res.push_back(gr_slot_advance_X(s, e.face, e.font));
+        res.push_back(gr_slot_before(s));
+        res.push_back(gr_slot_after(s));
+        res.push_back(gr_slot_attached_to(s) != 0);
+        res.push_back(gr_slot_can_insert_before(s));
+        for (int a = gr_slatAdvX; a <= gr_slatJWidth; ++a)
+            res.push_back(gr_slot_attr(s, seg, gr_attrCode(a), 0));
+        res.push_back(gr_slot_attr(s, seg, gr_slatColFlags, 0));
+        res.push_back(gr_slot_attr(s, seg, gr_slatColShiftx, 0));
+        res.push_back(gr_slot_attr(s, seg, gr_slatColShifty, 0));
+    }
+    for (unsigned int i = 0; i < gr_seg_n_cinfo(seg); ++i)
+    {
+        const gr_char_info * ci = gr_seg_cinfo(seg, i);
+        res.push_back(gr_cinfo_before(ci));
+        res.push_back(gr_cinfo_after(ci));
+        res.push_back(gr_cinfo_base(ci));
+        res.push_back(gr_cinfo_break_weight(ci));
+    }
+    gr_seg_destroy(seg);
+    return res;
+}
+
+bool make_engine(engine & e, const char * font_file, unsigned int options)
+{
+    e.face = gr_make_file_face(font_file, options);
+    e.font = e.face ? gr_make_font(12, e.face) : 0;
+    return e.font != 0;
+}
+
+// Set one feature to a value, leaving the rest at their defaults.
+gr_feature_val * feature_setting(const engine & e, gr_uint16 f, gr_int16 value)
+{
+    gr_feature_val * feats = gr_face_featureval_for_lang(e.face, 0);
+    if (feats)
+        gr_fref_set_feature_value(gr_face_fref(e.face, f), value, feats);
+    return feats;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r]\n";
+        return 1;
+    }
+    const int rtl = argc > 3 && !strcmp(argv[3], "-r");
+
+    std::vector<std::string> lines, runs;
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+    {
+        if (line.empty()) continue;
+        lines.push_back(line);
+        runs.push_back(line);
+        std::istringstream words(line);
+        for (std::string word; words >> word;)
+            runs.push_back(word);
+    }
+
+    engine jit, ref;
+    if (!make_engine(jit, argv[1], gr_face_jit) || !make_engine(ref, argv[1], 0))
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    int failures = 0;
+    for (size_t r = 0; r != runs.size(); ++r)
+        if (shape(jit, 0, runs[r], rtl) != shape(ref, 0, runs[r], rtl))
+        {
+            std::cerr << "\"" << runs[r] << "\" shapes differently when compiled" << std::endl;
+            ++failures;
+        }
+
+    for (gr_uint16 f = 0; f != gr_face_n_fref(ref.face); ++f)
+    {
+        const gr_feature_ref * fref = gr_face_fref(ref.face, f);
+        for (gr_uint16 v = 0; v != gr_fref_n_values(fref); ++v)
+        {
+            const gr_int16 value = gr_fref_value(fref, v);
+            gr_feature_val * jit_feats = feature_setting(jit, f, value),
+                           * ref_feats = feature_setting(ref, f, value);
+            for (size_t l = 0; l != lines.size(); ++l)
+                if (shape(jit, jit_feats, lines[l], rtl) != shape(ref, ref_feats, lines[l], rtl))
+                {
+                    std::cerr << "\"" << lines[l] << "\" shapes differently when compiled with feature "
+                              << gr_fref_id(fref) << " = " << value << std::endl;
+                    ++failures;
+                }
+            gr_featureval_destroy(jit_feats);
+            gr_featureval_destroy(ref_feats);
+        }
+    }
+
+    gr_font_destroy(ref.font);
+    gr_font_destroy(jit.font);
+    gr_face_destroy(ref.face);
+    gr_face_destroy(jit.face);
+    return failures ? 3 : 0;
+}
@@ -0,0 +1,285 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2012, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Differential test of the rule compiler one rule at a time: each rule the
+// compiler took is run at every slot of each shaped line as though the FSM
+// had matched it there, its constraint on each of its slots and then, if
+// that passes, its action.  The rule runs natively on a face made with
+// gr_face_jit and by the interpreter on a face made without, each on its
+// own copy of the line.  The values returned, the machine's status and
+// every slot of the line must match after each run.  Actions change the
+// lines as they go, so later rules start from whatever earlier ones left.
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "inc/Code.h"
+#include "inc/Face.h"
+#include "inc/FileFace.h"
+#include "inc/Pass.h"
+#include "inc/Rule.h"
+#include "inc/Segment.h"
+#include "inc/Silf.h"
+#include "inc/Slot.h"
+
+using namespace graphite2;
+
+// Machine.h leaves GRAPHITE2_JIT undefined where no code can be compiled.
+#ifdef GRAPHITE2_JIT
+namespace
+{
+
+typedef vm::Machine::Code   Code;
+
+bool load(Face & face, uint32 options)
+{
+    const Face::Table silf(face, TtfUtil::Tag::Silf, 0x00050000);
+    return silf && face.readGlyphs(0) && face.readFeatures()
+        && face.readGraphite(silf, options) && face.chooseSilf(0);
+}
+
+size_t count_chars(const std::string & utf8)
+{
+    size_t n = 0;
+    for (std::string::const_iterator c = utf8.begin(); c != utf8.end(); ++c)
+        n += (*c & 0xC0) != 0x80;
+    return n;
+}
+
+Segment * shape(const Face & face, const std::string & text, int rtl)
+{
+    const size_t nchars = count_chars(text);
+    Segment * seg = new Segment(nchars, &face, 0, rtl);
+    if (!seg->read_text(&face, &face.theSill().defaultFeatures(), gr_utf8, text.data(), nchars)
+        || !seg->runGraphite())
+    {
+        delete seg;
+        return 0;
+    }
+    return seg;
+}
+
+// Maps the slots around s as the FSM does for a rule matched there, or
+// returns false if the line has too few.
+bool match(const Rule & r, SlotMap & map, Slot * s)
+{
+    if (r.sort >= SlotMap::MAX_SLOTS)   return false;
+    for (int n = r.preContext; n; --n)
+        if (!(s = s->prev()))   return false;
+
+    map.reset(*s, r.preContext);
+    for (int n = r.sort; n; --n, s = s->next())
+    {
+        if (!s) return false;
+        map.pushSlot(s);
+    }
+    map.pushSlot(s);
+    return true;
+}
+
+// Runs the rule as Pass::findNDoRule would, noting what each program
+// returned and how the machine finished.  Returns whether the action ran.
+bool run(const Rule & r, SlotMap & map, std::vector<int32> & results)
+{
+    results.clear();
+    bool passed = true;
+    vm::slotref * const first = map.begin();
+    for (int n = 0; passed && n != r.sort && *r.constraint; ++n)
+    {
+        vm::Machine m(map);
+        vm::slotref * is = first + n;
+        results.push_back(r.constraint->run(m, is));
+        results.push_back(m.status());
+        passed = results[results.size()-2] && m.status() == vm::Machine::finished;
+    }
+    if (passed && *r.action)
+    {
+        vm::Machine m(map);
+        vm::slotref * is = &map[map.context()];
+        results.push_back(r.action->run(m, is));
+        results.push_back(m.status());
+        return true;
+    }
+    return false;
+}
+
+bool same_slot(const Segment & a, const Slot & x, const Segment & b, const Slot & y)
+{
+    if (x.gid() != y.gid() || x.before() != y.before() || x.after() != y.after()
+        || x.isDeleted() != y.isDeleted() || x.isInsertBefore() != y.isInsertBefore()
+        || x.origin().x != y.origin().x || x.origin().y != y.origin().y
+        || x.advance() != y.advance()
+        || !x.attachedTo() != !y.attachedTo()
+        || (x.attachedTo() && x.attachedTo()->gid() != y.attachedTo()->gid()))
+        return false;
+    for (int attr = gr_slatAdvX; attr <= gr_slatJWidth; ++attr)
+        if (x.getAttr(&a, attrCode(attr), 0) != y.getAttr(&b, attrCode(attr), 0))
+            return false;
+    for (int attr = gr_slatColFlags; attr <= gr_slatColShifty; ++attr)
+        if (x.getAttr(&a, attrCode(attr), 0) != y.getAttr(&b, attrCode(attr), 0))
+            return false;
+    for (int i = 0; i != a.numAttrs(); ++i)
+        if (x.getAttr(&a, gr_slatUserDefn, uint8(i)) != y.getAttr(&b, gr_slatUserDefn, uint8(i)))
+            return false;
+    return true;
+}
+
+bool same(const Segment & a, const Segment & b)
+{
+    const Slot * x = a.first(), * y = b.first();
+    for (; x && y; x = x->next(), y = y->next())
+        if (!same_slot(a, *x, b, *y))
+            return false;
+    return !x && !y;
+}
+
+// Only the slots a rule was given can have changed, besides any it added
+// between them, which are in its map too.
+bool same(const SlotMap & a, const SlotMap & b)
+{
+    if (a.size() != b.size() || a.segment.slotCount() != b.segment.slotCount())
+        return false;
+    for (int n = -1; n != int(a.size()); ++n)
+    {
+        const Slot * const x = a[n], * const y = b[n];
+        if (!x != !y || (x && !same_slot(a.segment, *x, b.segment, *y)))
+            return false;
+    }
+    return true;
+}
+
+struct counts
+{
+    long    compiled,
+            runs,
+            failures;
+};
+
+bool compiled(const Rule & r)
+{
+    return r.constraint->native() || r.action->native();
+}
+
+// Runs every compiled rule of pass p at every slot of the shaped line.  The
+// line may grow by no more than its own length, so a rule that inserts at
+// every slot soon dies instead of swamping the rest.
+bool compare_pass(Segment & a, Segment & b, size_t p, counts & c)
+{
+    const Pass & pass_a = *a.silf()->pass(p),
+               & pass_b = *b.silf()->pass(p);
+    SlotMap map_a(a, a.silf()->dir(), a.slotCount()),
+            map_b(b, b.silf()->dir(), b.slotCount());
+    std::vector<int32> results_a, results_b;
+
+    Slot * s_a = a.first(),
+         * s_b = b.first();
+    for (size_t n = 0; s_a && s_b; ++n, s_a = s_a->next(), s_b = s_b->next())
+        for (size_t i = 0; i != pass_a.numRules(); ++i)
+        {
+            const Rule & r_a = pass_a.rules()[i],
+                       & r_b = pass_b.rules()[i];
+            if (!compiled(r_a) || !match(r_a, map_a, s_a) || !match(r_b, map_b, s_b))
+                continue;
+
+            const bool acted = run(r_a, map_a, results_a);
+            run(r_b, map_b, results_b);
+            ++c.runs;
+            if (results_a != results_b || (acted && !same(map_a, map_b)))
+            {
+                std::cerr << "pass " << p << " rule " << i << " at slot " << n
+                          << " runs differently when compiled" << std::endl;
+                return false;
+            }
+        }
+    return same(a, b);
+}
+
+// Gives each pass a fresh copy of the shaped line.
+void compare_line(const Face & jit, const Face & ref, const std::string & text, int rtl, counts & c)
+{
+    for (size_t p = 0; p != jit.chooseSilf(0)->numPasses(); ++p)
+    {
+        Segment * const a = shape(jit, text, rtl),
+                * const b = shape(ref, text, rtl);
+        const bool ok = a && b && same(*a, *b) && compare_pass(*a, *b, p, c);
+        delete a;
+        delete b;
+        if (!ok)
+        {
+            std::cerr << "\"" << text << "\" runs differently when compiled" << std::endl;
+            ++c.failures;
+            return;
+        }
+    }
+}
+
+} // namespace
+#endif
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r] [lines]\n";
+        return 1;
+    }
+#ifndef GRAPHITE2_JIT
+    std::cout << "no rule compiler in this build" << std::endl;
+    return 0;
+#else
+    int rtl = 0;
+    size_t lines = ~size_t(0);
+    for (int i = 3; i != argc; ++i)
+    {
+        if (!strcmp(argv[i], "-r")) rtl = 1;
+        else                        lines = strtoul(argv[i], 0, 10);
+    }
+
+    FileFace file(argv[1]);
+    Face jit(&file, FileFace::ops),
+         ref(&file, FileFace::ops);
+    if (!load(jit, gr_face_jit) || !load(ref, 0))
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    counts c = {0, 0, 0};
+    const Silf & silf = *jit.chooseSilf(0);
+    for (size_t p = 0; p != silf.numPasses(); ++p)
+        for (size_t i = 0; i != silf.pass(p)->numRules(); ++i)
+            c.compiled += compiled(silf.pass(p)->rules()[i]);
+
+    std::ifstream input(argv[2]);
+    for (std::string line; lines && std::getline(input, line);)
+        if (!line.empty())
+        {
+            compare_line(jit, ref, line, rtl, c);
+            --lines;
+        }
+
+    std::cout << c.runs << " runs of " << c.compiled << " compiled rules, "
+              << c.failures << " mismatches" << std::endl;
+    return c.failures || !c.compiled ? 3 : 0;
+#endif
+}
@@ -0,0 +1,289 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2015, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Checks that every way of finding slice edges this build has gives the
+// scalar way's floats to the bit, first on random boxes and then by kerning
+// every segment of a corpus with each.  The kerning is collisionKern's loop
+// over resolveKern replayed on the shaped segments, without moving anything,
+// and each way is timed on it.  Only a mismatch fails, the timings are just
+// reported.
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "inc/Collider.h"
+#include "inc/Face.h"
+#include "inc/FileFace.h"
+#include "inc/Segment.h"
+#include "inc/Silf.h"
+#include "inc/Slot.h"
+
+using namespace graphite2;
+
+namespace
+{
+
+typedef std::chrono::steady_clock steady;
+
+const size_t CASES = 200000;
+
+const char * const names[] = { "scalar", "sse" };
+
+uint32 rand_state = 1;
+uint32 next_rand() { rand_state = rand_state * 1103515245U + 12345U; return rand_state >> 8; }
+
+// A float as a font's bounding box or a shift might hold one.
+float grid_value()  { return float(int(next_rand() % 8192) - 4096) / 4; }
+
+bool same(float a, float b)   { return std::memcmp(&a, &b, sizeof a) == 0; }
+
+// Runs of up to 11 slices, so every vector width leaves every tail, on the
+// slice widths and margins KernCollider uses.
+int check_random(slice_edges_kind kind, slice_edges_fn f)
+{
+    const slice_edges_fn ref = slice_edges(SLICE_EDGES_SCALAR);
+    int failures = 0;
+    rand_state = 1;
+    for (size_t c = 0; c != CASES; ++c)
+    {
+        const float margin = float(10 + next_rand() % 300);
+        SliceRun run = { grid_value(), margin / 1.5f, next_rand() % 2 ? margin : 0.f, next_rand() % 2 == 0 };
+        const int first = next_rand() % 40, n = next_rand() % 12;
+        BBox bb;
+        SlantBox sb;
+        float * v = &bb.xi;
+        for (int i = 0; i != 4; ++i) v[i] = grid_value();
+        v = &sb.si;
+        for (int i = 0; i != 4; ++i) v[i] = grid_value();
+        const float sx = grid_value(), sy = grid_value() / 8;
+        const bool sub = next_rand() % 2;
+
+        float expected[12], got[12];
+        for (int i = 0; i != n; ++i)
+            expected[i] = got[i] = next_rand() % 4 ? (run.right ? -1e38f : 1e38f) : grid_value();
+        ref(run, first, n, bb, sb, sub, sx, sy, expected);
+        f(run, first, n, bb, sb, sub, sx, sy, got);
+        for (int i = 0; i != n; ++i)
+        {
+            if (same(expected[i], got[i])) continue;
+            if (++failures <= 5)
+                std::cerr << names[kind] << " differs on case " << c << " slice " << first + i
+                          << (sub ? " (sub-box)" : " (main box)") << ": " << std::hexfloat
+                          << expected[i] << " != " << got[i] << std::defaultfloat << '\n';
+            break;
+        }
+    }
+    return failures;
+}
+
+// The body of Pass::resolveKern up to the move, which is returned instead of
+// made so that every replay sees the same segment.  Spaces never end the
+// run, whatever the pass says.
+float kern(Segment & seg, Slot * slotFix, int dir, float & ymin, float & ymax, slice_edges_fn f)
+{
+    float currSpace = 0.;
+    bool collides = false;
+    unsigned int space_count = 0;
+    Slot * base = slotFix;
+    while (base->attachedTo())
+        base = base->attachedTo();
+    SlotCollision * cFix = seg.collisionInfo(base);
+    const GlyphCache & gc = seg.getFace()->glyphs();
+    const Rect & bbb = seg.theGlyphBBoxTemporary(slotFix->gid());
+    const float by = slotFix->origin().y + cFix->shift().y;
+    if (base != slotFix)
+        return 0.;
+    bool seenEnd = (cFix->flags() & SlotCollision::COLL_END) != 0;
+    bool isInit = false;
+    KernCollider coll(0);
+    coll.sliceEdges(f);
+
+    ymax = max(by + bbb.tr.y, ymax);
+    ymin = min(by + bbb.bl.y, ymin);
+    for (Slot * nbor = slotFix->next(); nbor; nbor = nbor->next())
+    {
+        if (nbor->isChildOf(base))
+            continue;
+        if (!gc.check(nbor->gid()))
+            return 0.;
+        const Rect & bb = seg.theGlyphBBoxTemporary(nbor->gid());
+        SlotCollision * cNbor = seg.collisionInfo(nbor);
+        if ((bb.bl.y == 0.f && bb.tr.y == 0.f) || (cNbor->flags() & SlotCollision::COLL_ISSPACE))
+        {
+            currSpace += nbor->advance();
+            ++space_count;
+        }
+        else
+        {
+            space_count = 0;
+            if (nbor != slotFix && !cNbor->ignore())
+            {
+                seenEnd = true;
+                if (!isInit)
+                {
+                    if (!coll.initSlot(&seg, slotFix, cFix->limit(), cFix->margin(),
+                                    cFix->shift(), cFix->offset(), dir, ymin, ymax, 0))
+                        return 0.;
+                    isInit = true;
+                }
+                collides |= coll.mergeSlot(&seg, nbor, cNbor->shift(), currSpace, dir, 0);
+            }
+        }
+        if (cNbor->flags() & SlotCollision::COLL_END)
+        {
+            if (seenEnd && space_count < 2)
+                break;
+            else
+                seenEnd = true;
+        }
+    }
+    return collides ? coll.resolve(&seg, slotFix, dir, 0).x : 0.f;
+}
+
+// Pass::collisionKern's walk, noting each kern.
+void kern_segment(Segment & seg, slice_edges_fn f, std::vector<float> & kerns)
+{
+    const int dir = seg.silf()->dir();
+    const GlyphCache & gc = seg.getFace()->glyphs();
+    Slot * start = seg.first();
+    float ymin = 1e38f, ymax = -1e38f;
+    for (Slot * s = seg.first(); s; s = s->next())
+    {
+        if (!gc.check(s->gid()))
+            return;
+        const SlotCollision * c = seg.collisionInfo(s);
+        const Rect & bbox = seg.theGlyphBBoxTemporary(s->gid());
+        const float y = s->origin().y + c->shift().y;
+        if (!(c->flags() & SlotCollision::COLL_ISSPACE))
+        {
+            ymax = max(y + bbox.tr.y, ymax);
+            ymin = min(y + bbox.bl.y, ymin);
+        }
+        if (start && (c->flags() & (SlotCollision::COLL_KERN | SlotCollision::COLL_FIX))
+                        == (SlotCollision::COLL_KERN | SlotCollision::COLL_FIX))
+            kerns.push_back(kern(seg, s, dir, ymin, ymax, f));
+        if (c->flags() & SlotCollision::COLL_END)
+            start = NULL;
+        if (c->flags() & SlotCollision::COLL_START)
+            start = s;
+    }
+}
+
+double time_corpus(std::vector<Segment *> & segs, slice_edges_fn f, std::vector<float> & kerns)
+{
+    kerns.clear();
+    const steady::time_point start = steady::now();
+    for (std::vector<Segment *>::iterator s = segs.begin(); s != segs.end(); ++s)
+        kern_segment(**s, f, kerns);
+    return std::chrono::duration<double, std::milli>(steady::now() - start).count();
+}
+
+size_t count_chars(const std::string & utf8)
+{
+    size_t n = 0;
+    for (std::string::const_iterator c = utf8.begin(); c != utf8.end(); ++c)
+        n += (*c & 0xC0) != 0x80;
+    return n;
+}
+
+} // namespace
+
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r]\n";
+        return 1;
+    }
+    const int rtl = argc > 3 && !std::strcmp(argv[3], "-r");
+
+    int failures = 0;
+    for (int k = SLICE_EDGES_SCALAR; k != SLICE_EDGES_BEST; ++k)
+    {
+        const slice_edges_fn f = slice_edges(slice_edges_kind(k));
+        if (!f)
+            std::cout << names[k] << ": not available\n";
+        else
+            failures += check_random(slice_edges_kind(k), f);
+    }
+
+    FileFace file(argv[1]);
+    Face face(&file, FileFace::ops);
+    const Face::Table silf(face, TtfUtil::Tag::Silf, 0x00050000);
+    if (!silf || !face.readGlyphs(0) || !face.readFeatures() || !face.readGraphite(silf))
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    std::vector<std::string> lines;
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+        if (!line.empty()) lines.push_back(line);
+
+    std::vector<Segment *> segs;
+    for (size_t l = 0; l != lines.size(); ++l)
+    {
+        const size_t nchars = count_chars(lines[l]);
+        Segment * seg = new Segment(nchars, &face, 0, rtl);
+        if (!seg->read_text(&face, &face.theSill().defaultFeatures(), gr_utf8, lines[l].data(), nchars)
+            || !seg->runGraphite())
+        {
+            std::cerr << "failed to shape line " << l + 1 << std::endl;
+            return 3;
+        }
+        if (seg->hasCollisionInfo())
+            segs.push_back(seg);
+        else
+            delete seg;
+    }
+
+    std::vector<float> expected, got;
+    time_corpus(segs, slice_edges(SLICE_EDGES_SCALAR), expected);
+    for (int k = SLICE_EDGES_SCALAR; k != SLICE_EDGES_BEST; ++k)
+    {
+        const slice_edges_fn f = slice_edges(slice_edges_kind(k));
+        if (!f) continue;
+        double best = time_corpus(segs, f, got);
+        for (int round = 0; round != 4; ++round)
+            best = std::min(best, time_corpus(segs, f, got));
+        for (size_t i = 0; i != got.size() && i != expected.size(); ++i)
+            if (!same(expected[i], got[i]) && ++failures <= 5)
+                std::cerr << names[k] << " kerns glyph " << i << " by " << got[i]
+                          << " not " << expected[i] << '\n';
+        if (got.size() != expected.size())
+            ++failures;
+        std::cout << std::setw(6) << names[k] << ": " << std::fixed << std::setprecision(2)
+                  << best << " ms kerning " << expected.size() << " glyphs in "
+                  << segs.size() << " segments" << (f == slice_edges() ? " (chosen)" : "") << '\n';
+    }
+
+    for (std::vector<Segment *>::iterator s = segs.begin(); s != segs.end(); ++s)
+        delete *s;
+
+    std::cout << failures << " mismatches\n";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Check a face loaded with gr_face_lazyPasses shapes a text corpus the same
+// way as one decoded up front, and that the passes it decodes on demand are
+// exactly the ones an eager load produces.
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+namespace
+{
+
+typedef std::vector<float> shaping;
+typedef std::vector<unsigned char> image;
+
+shaping shape(gr_face * face, const std::string & line, int rtl)
+{
+    shaping res;
+    gr_font * font = gr_make_font(12, face);
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, line.data(), line.data() + line.size(), 0);
+    gr_segment * seg = font ? gr_make_seg(font, face, 0, 0, gr_utf8, line.data(), nchars, rtl) : 0;
+    if (seg)
+    {
+        res.push_back(gr_seg_advance_X(seg));
+        for (const gr_slot * s = gr_seg_first_slot(seg); s; s = gr_slot_next_in_segment(s))
+        {
+            res.push_back(gr_slot_gid(s));
+            res.push_back(gr_slot_origin_X(s));
+            res.push_back(gr_slot_origin_Y(s));
+        }
+        gr_seg_destroy(seg);
+    }
+    gr_font_destroy(font);
+    return res;
+}
+
+// Taking a snapshot decodes any passes not yet used.
+image snapshot(const gr_face * face)
+{
+    image res(gr_face_snapshot(face, 0, 0));
+    if (!res.empty())
+        gr_face_snapshot(face, res.data(), res.size());
+    return res;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r]\n";
+        return 1;
+    }
+    const int rtl = argc > 3 && !strcmp(argv[3], "-r");
+
+    std::vector<std::string> lines;
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+        lines.push_back(line);
+
+    gr_face * eager = gr_make_file_face(argv[1], 0);
+    const image expected = eager ? snapshot(eager) : image();
+    if (expected.empty())
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    int failures = 0;
+    gr_face * lazy = gr_make_file_face(argv[1], gr_face_lazyPasses);
+    if (!lazy)
+    {
+        std::cerr << "lazy load failed" << std::endl;
+        return 2;
+    }
+    for (size_t l = 0; l != lines.size(); ++l)
+    {
+        if (lines[l].empty()) continue;
+        if (shape(lazy, lines[l], rtl) != shape(eager, lines[l], rtl))
+        {
+            std::cerr << "lazily loaded face differs on line " << l + 1 << std::endl;
+            ++failures;
+        }
+    }
+    if (snapshot(lazy) != expected)
+    {
+        std::cerr << "lazily decoded passes differ from an eager load" << std::endl;
+        ++failures;
+    }
+    gr_face_destroy(lazy);
+
+    // A snapshot of a face that has not shaped anything yet decodes every pass.
+    lazy = gr_make_file_face(argv[1], gr_face_lazyPasses | gr_face_parallelLoad);
+    if (!lazy || snapshot(lazy) != expected)
+    {
+        std::cerr << "unused lazy face snapshots differently" << std::endl;
+        ++failures;
+    }
+    gr_face_destroy(lazy);
+    gr_face_destroy(eager);
+
+    return failures ? 3 : 0;
+}
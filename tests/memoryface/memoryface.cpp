@@ -0,0 +1,114 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Check a face made from a font held in memory shapes the same as one made
+// from the font file, and that truncated font data is refused or survived.
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+namespace
+{
+
+typedef std::vector<float> shaping;
+
+shaping shape(gr_face * face, const std::string & line, int rtl)
+{
+    shaping res;
+    gr_font * font = gr_make_font(12, face);
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, line.data(), line.data() + line.size(), 0);
+    gr_segment * seg = font ? gr_make_seg(font, face, 0, 0, gr_utf8, line.data(), nchars, rtl) : 0;
+    if (seg)
+    {
+        res.push_back(gr_seg_advance_X(seg));
+        for (const gr_slot * s = gr_seg_first_slot(seg); s; s = gr_slot_next_in_segment(s))
+        {
+            res.push_back(gr_slot_gid(s));
+            res.push_back(gr_slot_origin_X(s));
+            res.push_back(gr_slot_origin_Y(s));
+        }
+        gr_seg_destroy(seg);
+    }
+    gr_font_destroy(font);
+    return res;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r]\n";
+        return 1;
+    }
+    const int rtl = argc > 3 && !strcmp(argv[3], "-r");
+
+    std::ifstream font_file(argv[1], std::ios::binary);
+    const std::vector<char> data((std::istreambuf_iterator<char>(font_file)), std::istreambuf_iterator<char>());
+
+    gr_face * file_face = gr_make_file_face(argv[1], gr_face_preloadAll);
+    gr_face * mem_face = gr_make_memory_face(data.data(), data.size(), gr_face_preloadAll);
+    if (!file_face || !mem_face)
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    int failures = 0, l = 0;
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+    {
+        ++l;
+        if (line.empty()) continue;
+        const shaping expected = shape(file_face, line, rtl);
+        if (expected.empty() || expected != shape(mem_face, line, rtl))
+        {
+            std::cerr << "memory face differs on line " << l << std::endl;
+            ++failures;
+        }
+    }
+    gr_face_destroy(mem_face);
+    gr_face_destroy(file_face);
+
+    if (gr_make_memory_face(0, data.size(), 0) || gr_make_memory_face(data.data(), 0, 0))
+    {
+        std::cerr << "made a face from no data" << std::endl;
+        ++failures;
+    }
+
+    // Cut the font short in a spread of places, each must either fail to load
+    // or load without reading past the end.
+    for (size_t len = 1; len < data.size(); len += 1 + len / 4)
+    {
+        const std::vector<char> part(data.begin(), data.begin() + len);
+        gr_face_destroy(gr_make_memory_face(part.data(), part.size(), gr_face_preloadAll));
+    }
+
+    return failures ? 3 : 0;
+}
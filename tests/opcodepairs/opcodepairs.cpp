@@ -0,0 +1,124 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Counts how often each pair of adjacent opcodes appears in the decoded
+// rule programs of the fonts given, which is what the decoder's choice of
+// superinstructions is based on.  Pairs are counted once per program they
+// appear in, not by how often they run.
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "inc/Code.h"
+#include "inc/Face.h"
+#include "inc/FileFace.h"
+#include "inc/Pass.h"
+#include "inc/Silf.h"
+
+using namespace graphite2;
+
+namespace
+{
+
+typedef std::pair<int, int>         opcode_pair;
+typedef std::map<opcode_pair, long> pair_counts;
+
+struct program_counts
+{
+    long    instructions,
+            programs,
+            verified,       // stack depth proven at load
+            constraints,
+            glyph_only;     // constraints reading only their own glyph
+};
+
+bool count_font(const char * path, pair_counts & pairs, program_counts & counts)
+{
+    FileFace file(path);
+    if (!file)  return false;
+    Face face(&file, FileFace::ops);
+    const Face::Table silf(face, TtfUtil::Tag::Silf, 0x00050000);
+    if (!silf || !face.readGlyphs(0) || !face.readFeatures() || !face.readGraphite(silf))
+        return false;
+
+    for (const Silf * s = face.chooseSilf(0); s; s = 0)
+        for (size_t p = 0; p != s->numPasses(); ++p)
+        {
+            const Pass * const pass = s->pass(p);
+            for (size_t c = 0; c != pass->numPrograms(); ++c)
+            {
+                const vm::Machine::Code & prog = pass->programs()[c];
+                if (!prog)  continue;
+                counts.instructions += prog.instructionCount();
+                ++counts.programs;
+                counts.verified += prog.verified();
+                counts.constraints += prog.constraint();
+                counts.glyph_only += prog.ownGlyphOnly();
+                for (size_t i = 1; i < prog.instructionCount(); ++i)
+                    ++pairs[opcode_pair(prog.opcodeOf(i-1), prog.opcodeOf(i))];
+            }
+        }
+    return true;
+}
+
+const char * name(int opc)
+{
+    return opc < 0 ? "?" : vm::Machine::getOpcodeTable()[opc].name;
+}
+
+bool by_count(const std::pair<opcode_pair, long> & a, const std::pair<opcode_pair, long> & b)
+{
+    return a.second > b.second;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << argv[0] << ": FONT..." << std::endl;
+        return 1;
+    }
+
+    pair_counts pairs;
+    program_counts counts = {0, 0, 0, 0, 0};
+    for (int i = 1; i != argc; ++i)
+        if (!count_font(argv[i], pairs, counts))
+        {
+            std::cerr << argv[0] << ": failed to load " << argv[i] << std::endl;
+            return 2;
+        }
+
+    std::vector<std::pair<opcode_pair, long> > sorted(pairs.begin(), pairs.end());
+    std::sort(sorted.begin(), sorted.end(), by_count);
+    std::cout << counts.instructions << " instructions" << std::endl
+              << counts.verified << " of " << counts.programs << " programs with proven stack depth" << std::endl
+              << counts.glyph_only << " of " << counts.constraints << " constraints reading only their own glyph" << std::endl;
+    for (size_t i = 0; i != sorted.size() && i != 100; ++i)
+        std::cout << std::setw(8) << sorted[i].second << "  "
+                  << name(sorted[i].first.first) << ", " << name(sorted[i].first.second) << std::endl;
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Check a face loaded with gr_face_parallelLoad decodes to exactly the same
+// rules as a serial load, and shapes a text corpus the same way.
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+namespace
+{
+
+typedef std::vector<float> shaping;
+typedef std::vector<unsigned char> image;
+
+shaping shape(gr_face * face, const std::string & line, int rtl)
+{
+    shaping res;
+    gr_font * font = gr_make_font(12, face);
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, line.data(), line.data() + line.size(), 0);
+    gr_segment * seg = font ? gr_make_seg(font, face, 0, 0, gr_utf8, line.data(), nchars, rtl) : 0;
+    if (seg)
+    {
+        res.push_back(gr_seg_advance_X(seg));
+        for (const gr_slot * s = gr_seg_first_slot(seg); s; s = gr_slot_next_in_segment(s))
+        {
+            res.push_back(gr_slot_gid(s));
+            res.push_back(gr_slot_origin_X(s));
+            res.push_back(gr_slot_origin_Y(s));
+        }
+        gr_seg_destroy(seg);
+    }
+    gr_font_destroy(font);
+    return res;
+}
+
+// The snapshot image holds every decoded pass, so equal images mean equal rules.
+image snapshot(const gr_face * face)
+{
+    image res(gr_face_snapshot(face, 0, 0));
+    if (!res.empty())
+        gr_face_snapshot(face, res.data(), res.size());
+    return res;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r]\n";
+        return 1;
+    }
+    const int rtl = argc > 3 && !strcmp(argv[3], "-r");
+
+    std::vector<std::string> lines;
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+        lines.push_back(line);
+
+    gr_face * serial = gr_make_file_face(argv[1], gr_face_preloadAll);
+    const image expected = serial ? snapshot(serial) : image();
+    if (expected.empty())
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    int failures = 0;
+    const unsigned int options[] = { gr_face_parallelLoad, gr_face_preloadAll | gr_face_parallelLoad };
+    for (int r = 0; r != 4; ++r)
+    {
+        const unsigned int opts = options[r % 2];
+        gr_face * face = gr_make_file_face(argv[1], opts);
+        if (!face)
+        {
+            std::cerr << "parallel load failed with options " << opts << std::endl;
+            return 2;
+        }
+        if (snapshot(face) != expected)
+        {
+            std::cerr << "parallel load decoded differently with options " << opts << std::endl;
+            ++failures;
+        }
+        for (size_t l = 0; l != lines.size(); ++l)
+        {
+            if (lines[l].empty()) continue;
+            if (shape(face, lines[l], rtl) != shape(serial, lines[l], rtl))
+            {
+                std::cerr << "parallel loaded face differs on line " << l + 1 << std::endl;
+                ++failures;
+            }
+        }
+        gr_face_destroy(face);
+    }
+    gr_face_destroy(serial);
+
+    return failures ? 3 : 0;
+}
@@ -0,0 +1,130 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Shape a text corpus with and without a segment cache and check the cached
+// face gives identical results, both when filling and when hitting the cache.
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+namespace
+{
+
+typedef std::vector<float> shaping;
+
+shaping shape(gr_font * font, gr_face * face, const std::string & line, int rtl)
+{
+    shaping res;
+    const void * err = 0;
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, line.data(), line.data() + line.size(), &err);
+    gr_segment * seg = gr_make_seg(font, face, 0, 0, gr_utf8, line.data(), nchars, rtl);
+    if (!seg) return res;
+
+    res.push_back(gr_seg_advance_X(seg));
+    res.push_back(gr_seg_advance_Y(seg));
+    for (const gr_slot * s = gr_seg_first_slot(seg); s; s = gr_slot_next_in_segment(s))
+    {
+        res.push_back(gr_slot_gid(s));
+        res.push_back(gr_slot_origin_X(s));
+        res.push_back(gr_slot_origin_Y(s));
+        res.push_back(gr_slot_advance_X(s, face, font));
+        res.push_back(gr_slot_before(s));
+        res.push_back(gr_slot_after(s));
+        res.push_back(gr_slot_index(s));
+        const gr_slot * p = gr_slot_attached_to(s);
+        res.push_back(p ? gr_slot_index(p) : -1.f);
+    }
+    for (unsigned int i = 0; i < gr_seg_n_cinfo(seg); ++i)
+    {
+        const gr_char_info * ci = gr_seg_cinfo(seg, i);
+        res.push_back(gr_cinfo_before(ci));
+        res.push_back(gr_cinfo_after(ci));
+    }
+    gr_seg_destroy(seg);
+    return res;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r] [-s cache size] [-h]\n";
+        return 1;
+    }
+
+    int rtl = 0;
+    unsigned int cache_size = 1000;
+    bool want_hits = false;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-r"))                     rtl = 1;
+        else if (!strcmp(argv[i], "-s") && i+1 < argc)  cache_size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-h"))                want_hits = true;
+    }
+
+    std::vector<std::string> lines;
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+        if (!line.empty()) lines.push_back(line);
+
+    gr_face * face = gr_make_file_face(argv[1], 0);
+    gr_face * cached_face = gr_make_file_face_with_seg_cache(argv[1], cache_size, 0);
+    gr_font * font = face ? gr_make_font(12, face) : 0;
+    gr_font * cached_font = cached_face ? gr_make_font(12, cached_face) : 0;
+    if (!font || !cached_font)
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    int failures = 0;
+    for (int pass = 0; pass != 2; ++pass)
+        for (size_t l = 0; l != lines.size(); ++l)
+            if (shape(font, face, lines[l], rtl) != shape(cached_font, cached_face, lines[l], rtl))
+            {
+                std::cerr << "cached shaping differs on line " << l + 1 << " in pass " << pass + 1 << std::endl;
+                ++failures;
+            }
+
+    size_t hits = 0, misses = 0, entries = 0;
+    if (!gr_face_seg_cache_stats(cached_face, &hits, &misses, &entries))
+    {
+        std::cerr << "face has no segment cache" << std::endl;
+        ++failures;
+    }
+    std::cout << "hits: " << hits << " misses: " << misses << " entries: " << entries << std::endl;
+    if (entries > cache_size || (want_hits && hits == 0))
+        ++failures;
+
+    gr_font_destroy(cached_font);
+    gr_font_destroy(font);
+    gr_face_destroy(cached_face);
+    gr_face_destroy(face);
+    return failures ? 3 : 0;
+}
@@ -0,0 +1,129 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Time shaping a text corpus, one segment per line or per word, or per few
+// lines run together into long words, and report the best of several runs. Used by the benchmark target to compare changes to the
+// engine.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r] [-w] [-j lines] [-n repeats] [-o face options]\n";
+        return 1;
+    }
+
+    int rtl = 0;
+    bool words = false;
+    unsigned int repeats = 10, options = 0, join = 1;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-r"))                     rtl = 1;
+        else if (!strcmp(argv[i], "-w"))                words = true;
+        else if (!strcmp(argv[i], "-j") && i+1 < argc)  join = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i+1 < argc)  repeats = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i+1 < argc)  options = atoi(argv[++i]);
+    }
+
+    std::vector<std::string> lines;
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+    {
+        if (line.empty()) continue;
+        if (!words)
+        {
+            lines.push_back(line);
+            continue;
+        }
+        std::istringstream ws(line);
+        for (std::string word; ws >> word;)
+            lines.push_back(word);
+    }
+
+    // Run every join lines together with their spaces dropped, making words
+    // long enough to give the long collision ranges of long Nastaliq words.
+    if (join > 1)
+    {
+        std::vector<std::string> runs;
+        for (size_t l = 0; l < lines.size(); l += join)
+        {
+            std::string run;
+            for (size_t k = l; k != lines.size() && k != l + join; ++k)
+                for (std::string::const_iterator c = lines[k].begin(); c != lines[k].end(); ++c)
+                    if (*c != ' ')  run += *c;
+            runs.push_back(run);
+        }
+        lines.swap(runs);
+    }
+
+    gr_face * face = gr_make_file_face(argv[1], options);
+    gr_font * font = face ? gr_make_font(12, face) : 0;
+    if (!font)
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    std::vector<size_t> nchars(lines.size());
+    for (size_t l = 0; l != lines.size(); ++l)
+        nchars[l] = gr_count_unicode_characters(gr_utf8, lines[l].data(), lines[l].data() + lines[l].size(), 0);
+
+    double best = 0;
+    size_t glyphs = 0;
+    for (unsigned int r = 0; r < repeats || r == 0; ++r)
+    {
+        glyphs = 0;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t l = 0; l != lines.size(); ++l)
+        {
+            gr_segment * seg = gr_make_seg(font, face, 0, 0, gr_utf8, lines[l].data(), nchars[l], rtl);
+            if (!seg)
+            {
+                std::cerr << "failed to shape line " << l + 1 << std::endl;
+                return 3;
+            }
+            glyphs += gr_seg_n_slots(seg);
+            gr_seg_destroy(seg);
+        }
+        const double t = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (r == 0 || t < best) best = t;
+    }
+
+    const char * const name = strrchr(argv[1], '/');
+    printf("%-28s %6zu lines %8zu glyphs %10.3f ms %8.0f glyphs/ms\n",
+           name ? name + 1 : argv[1], lines.size(), glyphs, best, best > 0 ? glyphs / best : 0.);
+
+    gr_font_destroy(font);
+    gr_face_destroy(face);
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Shape a text corpus with and without a shaping context, check both give the
+// same results and count the heap calls the library makes once the context is
+// warmed up. Heap calls are counted by interposing the glibc allocator.
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+extern "C"
+{
+    void * __libc_malloc(size_t);
+    void * __libc_calloc(size_t, size_t);
+    void * __libc_realloc(void *, size_t);
+}
+
+namespace
+{
+
+bool    counting = false;
+size_t  heap_calls = 0;
+
+typedef std::vector<float> shaping;
+typedef std::vector<std::string> corpus;
+typedef gr_segment * (*make_seg_fn)(gr_shape_context *, gr_font *, gr_face *, const std::string &, int);
+
+gr_segment * make_plain(gr_shape_context *, gr_font * font, gr_face * face, const std::string & line, int rtl)
+{
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, line.data(), line.data() + line.size(), 0);
+    return gr_make_seg(font, face, 0, 0, gr_utf8, line.data(), nchars, rtl);
+}
+
+gr_segment * make_ctx(gr_shape_context * ctx, gr_font * font, gr_face * face, const std::string & line, int rtl)
+{
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, line.data(), line.data() + line.size(), 0);
+    return gr_make_seg_ctx(ctx, font, face, 0, 0, gr_utf8, line.data(), nchars, rtl);
+}
+
+shaping record(gr_segment * seg, gr_font * font, gr_face * face)
+{
+    shaping res;
+    if (!seg) return res;
+    res.push_back(gr_seg_advance_X(seg));
+    res.push_back(gr_seg_advance_Y(seg));
+    for (const gr_slot * s = gr_seg_first_slot(seg); s; s = gr_slot_next_in_segment(s))
+    {
+        res.push_back(gr_slot_gid(s));
+        res.push_back(gr_slot_origin_X(s));
+        res.push_back(gr_slot_origin_Y(s));
+        res.push_back(gr_slot_advance_X(s, face, font));
+        res.push_back(gr_slot_before(s));
+        res.push_back(gr_slot_after(s));
+    }
+    for (unsigned int i = 0; i < gr_seg_n_cinfo(seg); ++i)
+    {
+        const gr_char_info * ci = gr_seg_cinfo(seg, i);
+        res.push_back(gr_cinfo_before(ci));
+        res.push_back(gr_cinfo_after(ci));
+    }
+    return res;
+}
+
+// Shape every line the given number of times, returning the time taken and
+// the number of heap calls made while doing so.
+double run(make_seg_fn make, gr_shape_context * ctx, gr_font * font, gr_face * face,
+           const corpus & text, int rtl, unsigned int repeats, size_t & calls)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    heap_calls = 0;
+    counting = true;
+    for (unsigned int r = 0; r != repeats; ++r)
+        for (corpus::const_iterator l = text.begin(); l != text.end(); ++l)
+            gr_seg_reset(ctx, make(ctx, font, face, *l, rtl));
+    counting = false;
+    calls = heap_calls;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+extern "C"
+{
+    void * malloc(size_t n)             { heap_calls += counting; return __libc_malloc(n); }
+    void * calloc(size_t n, size_t s)   { heap_calls += counting; return __libc_calloc(n, s); }
+    void * realloc(void * p, size_t n)  { heap_calls += counting; return __libc_realloc(p, n); }
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r] [-n repeats] [-z]\n";
+        return 1;
+    }
+
+    int rtl = 0;
+    unsigned int repeats = 10;
+    bool want_zero = false;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-r"))                     rtl = 1;
+        else if (!strcmp(argv[i], "-n") && i+1 < argc)  repeats = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-z"))                want_zero = true;
+    }
+
+    corpus text;
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+        if (!line.empty()) text.push_back(line);
+
+    gr_face * face = gr_make_file_face(argv[1], 0);
+    gr_font * font = face ? gr_make_font(12, face) : 0;
+    gr_shape_context * ctx = gr_make_shape_context();
+    if (!font || !ctx)
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    // Check a context gives the same results, which also warms up the glyph
+    // and advance caches and grows the context's buffers.
+    int failures = 0;
+    for (size_t l = 0; l != text.size(); ++l)
+    {
+        gr_segment * const plain = make_plain(0, font, face, text[l], rtl);
+        gr_segment * const reused = make_ctx(ctx, font, face, text[l], rtl);
+        if (record(plain, font, face) != record(reused, font, face))
+        {
+            std::cerr << "shaping with a context differs on line " << l + 1 << std::endl;
+            ++failures;
+        }
+        gr_seg_destroy(plain);
+        gr_seg_reset(ctx, reused);
+    }
+
+    size_t plain_calls = 0, ctx_calls = 0;
+    const double plain_time = run(make_plain, 0, font, face, text, rtl, repeats, plain_calls);
+    const double ctx_time = run(make_ctx, ctx, font, face, text, rtl, repeats, ctx_calls);
+    const size_t segs = text.size() * repeats;
+    std::cout << "gr_make_seg:     " << plain_time << "s, " << double(plain_calls) / segs << " heap calls per segment\n"
+              << "gr_make_seg_ctx: " << ctx_time << "s, " << double(ctx_calls) / segs << " heap calls per segment\n";
+    if (want_zero && ctx_calls)
+        ++failures;
+
+    gr_shape_context_destroy(ctx);
+    gr_font_destroy(font);
+    gr_face_destroy(face);
+    return failures ? 3 : 0;
+}
@@ -0,0 +1,154 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Check a face restored from a snapshot image shapes the same as one loaded
+// from the font, that the image round trips, and that damaged images are
+// refused.
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+namespace
+{
+
+typedef std::vector<float> shaping;
+typedef std::vector<unsigned char> image;
+
+shaping shape(gr_face * face, const std::string & line, int rtl)
+{
+    shaping res;
+    gr_font * font = gr_make_font(12, face);
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, line.data(), line.data() + line.size(), 0);
+    gr_segment * seg = font ? gr_make_seg(font, face, 0, 0, gr_utf8, line.data(), nchars, rtl) : 0;
+    if (seg)
+    {
+        res.push_back(gr_seg_advance_X(seg));
+        for (const gr_slot * s = gr_seg_first_slot(seg); s; s = gr_slot_next_in_segment(s))
+        {
+            res.push_back(gr_slot_gid(s));
+            res.push_back(gr_slot_origin_X(s));
+            res.push_back(gr_slot_origin_Y(s));
+        }
+        gr_seg_destroy(seg);
+    }
+    gr_font_destroy(font);
+    return res;
+}
+
+image snapshot(const gr_face * face)
+{
+    image res(gr_face_snapshot(face, 0, 0));
+    if (res.empty() || gr_face_snapshot(face, res.data(), res.size()) != res.size())
+        res.clear();
+    return res;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r]\n";
+        return 1;
+    }
+    const int rtl = argc > 3 && !strcmp(argv[3], "-r");
+
+    gr_face * file_face = gr_make_file_face(argv[1], 0);
+    const image img = file_face ? snapshot(file_face) : image();
+    if (img.empty())
+    {
+        std::cerr << "failed to snapshot font " << argv[1] << std::endl;
+        return 2;
+    }
+    gr_face * snap_face = gr_make_file_face_with_snapshot(argv[1], img.data(), img.size(), 0);
+    if (!snap_face)
+    {
+        std::cerr << "failed to load font from its snapshot" << std::endl;
+        return 2;
+    }
+
+    int failures = 0, l = 0;
+    if (snapshot(snap_face) != img)
+    {
+        std::cerr << "snapshot of a restored face differs" << std::endl;
+        ++failures;
+    }
+
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+    {
+        ++l;
+        if (line.empty()) continue;
+        const shaping expected = shape(file_face, line, rtl);
+        if (expected.empty() || expected != shape(snap_face, line, rtl))
+        {
+            std::cerr << "snapshot face differs on line " << l << std::endl;
+            ++failures;
+        }
+    }
+    gr_face_destroy(snap_face);
+    gr_face_destroy(file_face);
+
+    // Too small a buffer must be left alone.
+    image small(img.size() - 1, 0xAA);
+    gr_face * face = gr_make_file_face(argv[1], 0);
+    if (gr_face_snapshot(face, small.data(), small.size()) != img.size()
+        || small != image(img.size() - 1, 0xAA))
+    {
+        std::cerr << "wrote a snapshot into too small a buffer" << std::endl;
+        ++failures;
+    }
+    gr_face_destroy(face);
+
+    // Damage to the key, the body or the length must all be caught.
+    const size_t probes[] = { 0, 16, img.size() / 2, img.size() - 1 };
+    for (size_t i = 0; i != sizeof probes / sizeof *probes; ++i)
+    {
+        image bad(img);
+        bad[probes[i]] ^= 0x5A;
+        face = gr_make_file_face_with_snapshot(argv[1], bad.data(), bad.size(), 0);
+        if (face)
+        {
+            std::cerr << "loaded a snapshot damaged at byte " << probes[i] << std::endl;
+            gr_face_destroy(face);
+            ++failures;
+        }
+    }
+    for (size_t len = 0; len < img.size(); len += 1 + len / 2)
+    {
+        face = gr_make_file_face_with_snapshot(argv[1], img.data(), len, 0);
+        if (face)
+        {
+            std::cerr << "loaded a snapshot cut short at " << len << " bytes" << std::endl;
+            gr_face_destroy(face);
+            ++failures;
+        }
+    }
+
+    return failures ? 3 : 0;
+}
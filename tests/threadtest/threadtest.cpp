@@ -0,0 +1,163 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Shape a text corpus from several threads sharing one face and font and check
+// every thread gets exactly what a single threaded run on a private face gets.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+namespace
+{
+
+typedef std::vector<float> shaping;
+
+struct corpus
+{
+    std::vector<std::string> lines;
+    int rtl;
+};
+
+shaping shape(gr_font * font, gr_face * face, const std::string & line, int rtl)
+{
+    shaping res;
+    const void * err = 0;
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, line.data(), line.data() + line.size(), &err);
+    gr_segment * seg = gr_make_seg(font, face, 0, 0, gr_utf8, line.data(), nchars, rtl);
+    if (!seg) return res;
+
+    res.push_back(gr_seg_advance_X(seg));
+    res.push_back(gr_seg_advance_Y(seg));
+    for (const gr_slot * s = gr_seg_first_slot(seg); s; s = gr_slot_next_in_segment(s))
+    {
+        res.push_back(gr_slot_gid(s));
+        res.push_back(gr_slot_origin_X(s));
+        res.push_back(gr_slot_origin_Y(s));
+        res.push_back(gr_slot_advance_X(s, face, font));
+        res.push_back(gr_slot_before(s));
+        res.push_back(gr_slot_after(s));
+    }
+    for (unsigned int i = 0; i < gr_seg_n_cinfo(seg); ++i)
+    {
+        const gr_char_info * ci = gr_seg_cinfo(seg, i);
+        res.push_back(gr_cinfo_before(ci));
+        res.push_back(gr_cinfo_after(ci));
+    }
+    gr_seg_destroy(seg);
+    return res;
+}
+
+void shape_all(gr_font * font, gr_face * face, const corpus & text, size_t start, std::vector<shaping> & out)
+{
+    const size_t n = text.lines.size();
+    out.resize(n);
+    // Start each thread at a different line so they fault glyphs in a different order.
+    for (size_t i = 0; i != n; ++i)
+    {
+        const size_t l = (start + i) % n;
+        out[l] = shape(font, face, text.lines[l], text.rtl);
+    }
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r] [-t threads] [-n repeats] [-c cache size] [-o face options]\n";
+        return 1;
+    }
+
+    corpus text;
+    text.rtl = 0;
+    unsigned int nthreads = 8, repeats = 4, cache_size = 0, options = 0;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-r"))                     text.rtl = 1;
+        else if (!strcmp(argv[i], "-t") && i+1 < argc)  nthreads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i+1 < argc)  repeats = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-c") && i+1 < argc)  cache_size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i+1 < argc)  options = atoi(argv[++i]);
+    }
+
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+        if (!line.empty()) text.lines.push_back(line);
+    if (text.lines.empty())
+    {
+        std::cerr << "no text read from " << argv[2] << std::endl;
+        return 2;
+    }
+
+    // Reference run on a private face and font.
+    gr_face * ref_face = gr_make_file_face(argv[1], 0);
+    gr_font * ref_font = ref_face ? gr_make_font(12, ref_face) : 0;
+    if (!ref_font)
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 3;
+    }
+    std::vector<shaping> expected;
+    shape_all(ref_font, ref_face, text, 0, expected);
+    gr_font_destroy(ref_font);
+    gr_face_destroy(ref_face);
+
+    int failures = 0;
+    for (unsigned int r = 0; r != repeats; ++r)
+    {
+        // A fresh face and font each time so the lazy glyph and advance
+        // caches, and any lazily decoded passes, are filled in by racing threads.
+        gr_face * face = cache_size ? gr_make_file_face_with_seg_cache(argv[1], cache_size, options)
+                                    : gr_make_file_face(argv[1], options);
+        gr_font * font = face ? gr_make_font(12, face) : 0;
+        if (!font) return 3;
+
+        std::vector<std::vector<shaping> > results(nthreads);
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t != nthreads; ++t)
+            workers.push_back(std::thread(shape_all, font, face, std::cref(text),
+                                          t * text.lines.size() / nthreads, std::ref(results[t])));
+        for (auto & w : workers)
+            w.join();
+
+        for (unsigned int t = 0; t != nthreads; ++t)
+            for (size_t l = 0; l != text.lines.size(); ++l)
+                if (results[t][l] != expected[l])
+                {
+                    std::cerr << "thread " << t << " differs on line " << l + 1 << std::endl;
+                    ++failures;
+                }
+
+        gr_font_destroy(font);
+        gr_face_destroy(face);
+    }
+
+    return failures ? 4 : 0;
+}
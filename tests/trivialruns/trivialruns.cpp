@@ -0,0 +1,121 @@
+/*  GRAPHITE2 LICENSING
+
+    Copyright 2010, SIL International
+    All rights reserved.
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation; either version 2.1 of License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should also have received a copy of the GNU Lesser General Public
+    License along with this library in the file named "LICENSE".
+    If not, write to the Free Software Foundation, 51 Franklin Street,
+    Suite 500, Boston, MA 02110-1335, USA or visit their web page on the
+    internet at http://www.fsf.org/licenses/lgpl.html.
+*/
+// Check that text shaped without running the passes, because no rule in the
+// font can touch it, comes out exactly as it does from the passes. Faces
+// loaded with gr_face_lazyPasses always run them so serve as the reference.
+// Each line is shaped whole and word by word, words being far more often
+// made only of glyphs no rule matches.
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <graphite2/Font.h>
+#include <graphite2/Segment.h>
+
+namespace
+{
+
+typedef std::vector<float> shaping;
+
+shaping shape(gr_face * face, gr_font * font, const std::string & text, int rtl)
+{
+    shaping res;
+    const size_t nchars = gr_count_unicode_characters(gr_utf8, text.data(), text.data() + text.size(), 0);
+    gr_segment * seg = gr_make_seg(font, face, 0, 0, gr_utf8, text.data(), nchars, rtl);
+    if (!seg) return res;
+
+    res.push_back(gr_seg_advance_X(seg));
+    res.push_back(gr_seg_advance_Y(seg));
+    for (const gr_slot * s = gr_seg_first_slot(seg); s; s = gr_slot_next_in_segment(s))
+    {
+        res.push_back(gr_slot_gid(s));
+        res.push_back(gr_slot_origin_X(s));
+        res.push_back(gr_slot_origin_Y(s));
+        res.push_back(gr_slot_advance_X(s, face, font));
+        res.push_back(gr_slot_before(s));
+        res.push_back(gr_slot_after(s));
+        res.push_back(gr_slot_attached_to(s) != 0);
+        res.push_back(gr_slot_attr(s, seg, gr_slatColFlags, 0));
+        res.push_back(gr_slot_attr(s, seg, gr_slatColShiftx, 0));
+    }
+    for (unsigned int i = 0; i < gr_seg_n_cinfo(seg); ++i)
+    {
+        const gr_char_info * ci = gr_seg_cinfo(seg, i);
+        res.push_back(gr_cinfo_before(ci));
+        res.push_back(gr_cinfo_after(ci));
+        res.push_back(gr_cinfo_base(ci));
+        res.push_back(gr_cinfo_break_weight(ci));
+    }
+    gr_seg_destroy(seg);
+    return res;
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << argv[0] << ": <font file> <text file> [-r]\n";
+        return 1;
+    }
+    const int rtl = argc > 3 && !strcmp(argv[3], "-r");
+
+    std::vector<std::string> runs;
+    std::ifstream input(argv[2]);
+    for (std::string line; std::getline(input, line);)
+    {
+        if (line.empty()) continue;
+        runs.push_back(line);
+        std::istringstream words(line);
+        for (std::string word; words >> word;)
+            runs.push_back(word);
+    }
+
+    gr_face * face = gr_make_file_face(argv[1], 0),
+            * ref_face = gr_make_file_face(argv[1], gr_face_lazyPasses);
+    gr_font * font = face ? gr_make_font(12, face) : 0,
+            * ref_font = ref_face ? gr_make_font(12, ref_face) : 0;
+    if (!font || !ref_font)
+    {
+        std::cerr << "failed to load font " << argv[1] << std::endl;
+        return 2;
+    }
+
+    int failures = 0;
+    for (size_t r = 0; r != runs.size(); ++r)
+        if (shape(face, font, runs[r], rtl) != shape(ref_face, ref_font, runs[r], rtl))
+        {
+            std::cerr << "\"" << runs[r] << "\" shapes differently without the passes" << std::endl;
+            ++failures;
+        }
+
+    gr_font_destroy(ref_font);
+    gr_font_destroy(font);
+    gr_face_destroy(ref_face);
+    gr_face_destroy(face);
+    return failures ? 3 : 0;
+}
@@ -27,6 +27,28 @@ const byte simple_prog[] =
 //    POP_RET
 };
 
+// A constant folds to a push no bigger than the bytecode it came from, so
+// each of these one byte pushes must be left as it is.
+const byte version_prog[] =
+{
+    PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION,
+    PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION,
+    PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION,
+    PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION,
+    PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION,
+    PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION,
+    PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION,
+    PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION, PUSH_VERSION,
+    POP_RET
+};
+
+// Adding zero is only dropped with something beneath it to add to.
+const byte underfull_prog[] =
+{
+    PUSH_BYTE, 0, ADD,
+    POP_RET
+};
+
 #define _msg(m) #m
 
 const char * prog_error_msg[] = {
@@ -34,9 +56,13 @@ const char * prog_error_msg[] = {
     _msg(alloc_failed),
     _msg(invalid_opcode),
     _msg(unimplemented_opcode_used),
+    _msg(out_of_range_data),
     _msg(jump_past_end),
     _msg(arguments_exhausted),
-    _msg(missing_return)
+    _msg(missing_return),
+    _msg(nested_context_item),
+    _msg(underfull_stack),
+    _msg(overfull_stack)
 };
 
 const char * run_error_msg[] = {
@@ -87,6 +113,14 @@ int main(int argc, char *argv[])
         std::cerr << argv[0] << ": failed to load graphite tables for font: " << font_path << std::endl;
         exit(1);
     }
+
+    Code version(true, version_prog, version_prog + sizeof(version_prog), 0, 1, silf, *face, PASS_TYPE_UNKNOWN);
+    std::cout << "version program: " << prog_error_msg[version.status()]
+              << (version.dataSize() <= sizeof(version_prog) ? "" : " past its data")
+              << std::endl;
+    Code underfull(true, underfull_prog, underfull_prog + sizeof(underfull_prog), 0, 1, silf, *face, PASS_TYPE_UNKNOWN);
+    std::cout << "underfull program: " << prog_error_msg[underfull.status()] << std::endl;
+
     Code prog(false, &big_prog[0], &big_prog[0] + big_prog.size(), 0, 0, silf, *face, PASS_TYPE_UNKNOWN);
     if (!prog) {    // Find out why it did't work
         // For now just dump an error message.